@@ -0,0 +1,2169 @@
+/**
+ * @file auction.cpp
+ * @brief Auction simulation with multiple bidders
+ * Bidders strategies are: Agent-bidding, Ratchet-bidding, and Sniping
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include "auction.h"
+#include "bidbook.h"
+#include "currency.h"
+#include "latency.h"
+#include "learning.h"
+#include "pacer.h"
+#include "population.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "simlib.h"
+
+using namespace std;
+
+/**
+ * @struct ModelStatistics
+ * @brief SIMLIB statistics collected during a simulation run.
+ */
+struct ModelStatistics
+{
+    Facility biddingFacility{"Bidding process"}; // Facility for bidding
+    Facility runningAuction{"Item auction"};     // Facility for running the auction
+    Histogram winners{"Winners", -1, 1, 5};      // Histogram of winners
+    Store backend{"Bid backend", 1};             // Servers of the bid backend, used instead of the bidding facility
+    Stat backendWait{"Bid backend queue wait"};  // Queue wait of the bids served by the backend
+};
+
+namespace
+{
+
+AuctionSimulator *simulator = nullptr; // Simulator running the model
+AuctionConfig config;                  // Configuration of the running simulation
+ModelStatistics *stats = nullptr;      // Statistics of the running simulation
+int itemsStarted = 0;                  // Number of items put up for auction
+BidderPopulation population;           // Persistent bidders, empty if every item draws new bidders
+LearningPolicy policy;                 // Policy of the learning bidders, trained over the items of the run
+LatencyDistribution latencies[3];      // Submission latency of every latency class
+AliasTable connectionTables[4];        // Latency classes of the bidders of every strategy
+
+const int IRRATIONAL_PROXY_FACTOR = 10; // Proxy maximum of irrational bidders relative to their valuation
+const double DUTCH_OPENING_FACTOR = 2;  // Opening price of the Dutch clock relative to the real price
+const double DUTCH_TICK = 1;            // Time between two price drops of the Dutch clock
+const double INITIAL_RATING_MEAN = 30;  // Mean feedback rating of a persistent bidder before the run
+const int SAMPLE_TRIES = 8;             // Draws of a persistent bidder not yet in the item
+const double LEARNER_REACTION = 0.5;    // Mean time between two looks of a learning bidder at the item
+const double RATCHET_ENTRY = 0.9;       // Time a ratchet bidder takes to enter a bid, the fixed 1 s delay less the network
+const double SNIPE_SERVICE_LEAD = 1;    // Time before the end when a sniping service fires the bid
+
+// Shares of the broadband, mobile and datacenter connections of the agents, ratchet bidders, snipers and learners,
+// sniping services and bidding agents often run from a datacenter, humans bid from home or a phone
+const double CONNECTION_MIX[4][3] = {{0.5, 0.1, 0.4}, {0.6, 0.4, 0}, {0.35, 0.25, 0.4}, {0.5, 0.3, 0.2}};
+
+/**
+ * @struct ProxyBid
+ * @brief Maximum bid submitted to the proxy bidding system.
+ */
+struct ProxyBid
+{
+    Cents maximum;     // The maximum price the bidder is willing to pay
+    uint64_t sequence; // Order of submission, earlier bids win ties
+    int type;          // Strategy of the bidder
+    int32_t owner;     // Population identifier of the bidder, -1 without a population
+    int learner;       // Index of a learning bidder in the batch of the item, -1 for the fixed strategies
+    Cents value;       // Valuation of the bidder
+    int connection;    // LatencyClass of the bidder, -1 without the latency model
+};
+
+/**
+ * @class ProxyBook
+ * @brief Max-heap of the proxy bids of an item.
+ *
+ * @details
+ * Insertion is O(log n), the highest and the second highest maximum are available in O(1),
+ * which is all the proxy bidding system needs to resolve the price.
+ */
+class ProxyBook
+{
+private:
+    vector<ProxyBid> heap;
+
+    static bool lower(const ProxyBid &a, const ProxyBid &b)
+    {
+        return a.maximum < b.maximum || (a.maximum == b.maximum && a.sequence > b.sequence);
+    }
+
+public:
+    void insert(const ProxyBid &bid)
+    {
+        this->heap.push_back(bid);
+        push_heap(this->heap.begin(), this->heap.end(), lower);
+    }
+
+    size_t size() const { return this->heap.size(); }
+
+    const ProxyBid &highest() const { return this->heap.front(); }
+
+    const ProxyBid &second() const
+    {
+        if (this->heap.size() == 2 || !lower(this->heap[1], this->heap[2]))
+        {
+            return this->heap[1];
+        }
+        return this->heap[2];
+    }
+};
+
+/**
+ * @struct ItemState
+ * @brief State of a single auction item shared by all processes of the item.
+ *
+ * @details
+ * The state is reference counted by the processes of the item, it is released
+ * together with the last process referencing it.
+ */
+struct ItemState
+{
+    int itemNumber = 0;          // Unique identifier of the item
+    double startTime = 0;        // Start time of the item
+    double endTime = 0;          // End time of the item, shared by all processes of the item
+    unsigned endVersion = 0;     // Incremented whenever the end time is extended
+    Cents currentPrice = -1;     // Current price of the auction
+    double floatPrice = -1;      // Unrounded price of the floating point model, if AuctionConfig::floatPrices is set
+    bool firstBidPlaced = false; // Flag if the first bid was placed for the item
+    bool finished = false;       // Flag if the item was already sold or discarded
+    int backendSeconds = 0;      // Seconds of auction time the item is counted in the load of the bid backend
+    int lastBidder = NONE;       // Strategy of the leading bidder
+    int32_t leaderId = -1;       // Population identifier of the leading bidder, -1 without a population
+    int leaderLearner = -1;      // Index of the leading learning bidder in the batch, -1 for the fixed strategies
+    Cents leaderValue = 0;       // Valuation of the leading bidder
+    int leaderConnection = -1;   // LatencyClass of the leading bidder, -1 without the latency model
+    Cents buyItNowPrice = 0;     // Buy-It-Now price, available until the first bid, 0 if there is none
+    Cents reservePrice = 0;      // Hidden reserve price, the item is not sold below it
+    ItemResult result = {};      // Outcome reported at the end of the item
+    int references = 0;          // Number of processes referencing the item
+    vector<Entity *> members;    // Process group of the item, slots of ended processes are empty
+
+    Queue agentDecidedToBid{"Agent decided to bid"};     // Queue of agents that decided to bid
+    Queue ratchetDecidedToBid{"Ratchet decided to bid"}; // Queue of ratchet bidders that decided to bid
+    Queue sniperDecidedToBid{"Sniper decided to bid"};   // Queue of snipers that decided to bid
+    Queue learnerDecidedToBid{"Learner decided to bid"}; // Queue of learning bidders that decided to bid
+    Process *waitingForEnd = nullptr;                    // Process activated when the item is finished
+    ProxyBook proxyBids;                                 // Maximum bids of the proxy bidding system
+    BidBook book{(size_t)config.units};                  // Standing bids of a multi-unit item, acceptance prices in a Dutch auction
+    LearningBatch learners;                              // Learning bidders of the item, their actions and rewards
+    vector<const BookBid *> learnerBids;                 // Book slots of the learning bidders in the batch order
+
+    // Multi-unit items keep the standing bids in the bid book, the price is the lowest winning bid
+    static bool multiUnit() { return config.units > 1; }
+
+    // Current increment of the auction
+    Cents minimalIncrement() const
+    {
+        return config.proxyBidding ? tieredIncrement(this->currentPrice) : percentOf(this->currentPrice, 1);
+    }
+
+    Queue &decidedToBid(int type)
+    {
+        switch (type)
+        {
+        case AGENT:
+            return this->agentDecidedToBid;
+        case RATCHET:
+            return this->ratchetDecidedToBid;
+        case SNIPER:
+            return this->sniperDecidedToBid;
+        default:
+            return this->learnerDecidedToBid;
+        }
+    }
+
+    /**
+     * @brief Adds a process to the process group of the item.
+     * @param member The process.
+     * @return Slot of the process in the group
+     */
+    size_t join(Entity *member)
+    {
+        this->members.push_back(member);
+        return this->members.size() - 1;
+    }
+
+    void leave(size_t slot) { this->members[slot] = nullptr; }
+
+    /**
+     * @brief Finds the learning bidder of a book slot.
+     * @return Index of the bidder in the batch, -1 for a bidder with a fixed strategy
+     */
+    int learnerOf(const BookBid *bid) const
+    {
+        auto found = find(this->learnerBids.begin(), this->learnerBids.end(), bid);
+        return found == this->learnerBids.end() ? -1 : found - this->learnerBids.begin();
+    }
+
+    /**
+     * @brief Rewards a learning bidder who won a unit with its surplus relative to its valuation.
+     * @param learner Index of the bidder in the batch, -1 is ignored.
+     * @param paid Price paid for the unit.
+     */
+    void rewardLearner(int learner, Cents paid)
+    {
+        if (learner >= 0)
+        {
+            double valuation = this->learners.valuation[learner];
+            this->learners.reward[learner] = (valuation - toAmount(paid)) / valuation;
+        }
+    }
+
+    void retain() { this->references++; }
+    void release()
+    {
+        if (--this->references == 0)
+        {
+            delete this;
+        }
+    }
+};
+
+
+/**
+ * @brief Prints a progress message of the model if the simulation is verbose.
+ */
+__attribute__((format(printf, 1, 2))) void trace(const char *format, ...)
+{
+    if (config.verbose)
+    {
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+    }
+}
+
+/**
+ * @brief Draws the number of potential bidders of an item.
+ *
+ * @return Number of bidders
+ */
+int drawRoundBidders()
+{
+    return max(Normal(config.numberOfBidders, config.numberOfBidders / 10 / 3), 0.0);
+}
+
+/**
+ * @brief Draws the strategy of a bidder.
+ * The configured mix defaults to Agent-bidding: 40%, Ratchet-bidding: 25%, Sniping: 35% of the reference paper.
+ * The configured share of learning bidders is drawn first, the rest follows the mix.
+ *
+ * @return Strategy of the bidder
+ */
+BidderType drawStrategy()
+{
+    if (config.learners > 0 && Random() < config.learners)
+    {
+        return LEARNER;
+    }
+    const double *mix = config.mix;
+    double probability = Random() * (mix[AGENT] + mix[RATCHET] + mix[SNIPER]);
+    if (probability < mix[AGENT])
+    {
+        return AGENT;
+    }
+    return probability < mix[AGENT] + mix[RATCHET] ? RATCHET : SNIPER;
+}
+
+/**
+ * @brief Draws the latency class of a bidder from the alias table of its strategy.
+ *
+ * @param strategy Strategy of the bidder.
+ *
+ * @return LatencyClass of the bidder
+ */
+int drawConnection(int strategy)
+{
+    return connectionTables[strategy].pick(Random());
+}
+
+/**
+ * @brief Draws the valuation of a bidder.
+ * Snipers generally do not want to bid, when the price is high, and their price valuation is lower
+ *
+ * @param type Strategy of the bidder.
+ * @param realPrice The real price of the item.
+ *
+ * @return Valuation of the bidder
+ */
+double drawValuation(BidderType type, double realPrice)
+{
+    return realPrice * Normal(1.2, (type == SNIPER ? 0.3 : 0.5) / 2);
+}
+
+/**
+ * @brief Draws the real price of an item.
+ *
+ * @return Real price of the item
+ */
+double drawRealPrice()
+{
+    return Exponential(1000 * Normal(1.0, 0.2));
+}
+
+/**
+ * @brief Draws the starting price of an item.
+ *
+ * @param realPrice The real price of the item.
+ *
+ * @return Starting price of the item, not rounded to cents
+ */
+double drawStartPrice(double realPrice)
+{
+    return realPrice * Normal(0.8, 0.2);
+}
+
+/**
+ * @brief Samples a persistent bidder for an item, a bidder is drawn for an item at most once.
+ * The cost is O(1) per bidder, so an item costs O(its bidders) regardless of the population size.
+ *
+ * @param itemNumber Number of the item.
+ *
+ * @return Population identifier of the bidder, -1 if every draw hit a bidder already drawn for the item
+ */
+int32_t sampleBidder(int itemNumber)
+{
+    for (int tries = 0; tries < SAMPLE_TRIES; tries++)
+    {
+        int32_t id = min<size_t>(Random() * population.size(), population.size() - 1);
+        if (population.draw(id, itemNumber))
+        {
+            return id;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Enters a sampled persistent bidder into its item.
+ * Bidders are sampled up front, only the ones that reach the item before it ends count as entered.
+ *
+ * @param id Population identifier of the bidder.
+ * @param result Result of the item, counts the returning bidders.
+ *
+ * @return void
+ */
+void enterBidder(int32_t id, ItemResult &result)
+{
+    population.enter(id);
+    result.returning += population.itemsOf(id) > 1;
+}
+
+/**
+ * @brief Adds a learning bidder to the batch of an item, its actions are set by the next evaluation of the policy.
+ *
+ * @param batch The batch of the item.
+ * @param valuation Valuation of the bidder.
+ * @param startPrice Starting price of the item.
+ * @param roundBidders Number of bidders of the item.
+ *
+ * @return Index of the bidder in the batch
+ */
+int addLearner(LearningBatch &batch, double valuation, Cents startPrice, int roundBidders)
+{
+    double shadingNoise = Normal(0, 1);
+    double timingNoise = Normal(0, 1);
+    return batch.add(valuation, toAmount(startPrice), roundBidders / max(config.numberOfBidders, 1.0), shadingNoise, timingNoise);
+}
+
+/**
+ * @brief Records the surplus of a won unit, the payoff of the winner's strategy.
+ *
+ * @param type Strategy of the winner.
+ * @param value Valuation of the winner.
+ * @param paid Price paid for the unit.
+ */
+void recordSurplus(int type, Cents value, Cents paid)
+{
+    simulator->reportSurplus(type, toAmount(value - paid));
+}
+
+/**
+ * @brief Records a unit won over a latency class.
+ * @param connection LatencyClass of the winner, -1 without the latency model is ignored.
+ */
+void recordConnectionWin(int connection)
+{
+    if (connection >= 0)
+    {
+        simulator->latencyStats(connection).wins++;
+    }
+}
+
+/**
+ * @brief Records a won item (unit) of a persistent bidder.
+ */
+void recordWin(int32_t id)
+{
+    if (id >= 0)
+    {
+        population.win(id);
+    }
+}
+
+/**
+ * @brief Funcion gets the bidders from the queues of an item and activates them
+ *
+ * @param item The auction item.
+ *
+ * @return void
+ */
+void returnFromQueues(ItemState *item)
+{
+    for (int type = AGENT; type <= LEARNER; type++)
+    {
+        Queue &queue = item->decidedToBid(type);
+        while (!queue.Empty())
+        {
+            queue.GetFirst()->Activate();
+        }
+    }
+}
+
+/**
+ * @brief Counts the item in the load of the bid backend up to the current second of auction time, the item is open
+ * or still has bids in the backend in these seconds.
+ *
+ * @param item The auction item.
+ */
+void coverBackendSeconds(ItemState *item)
+{
+    for (; item->backendSeconds < Time - item->startTime; item->backendSeconds++)
+    {
+        simulator->backendSecond(item->backendSeconds).items++;
+    }
+}
+
+/**
+ * @brief Ends an auction item and reports its result.
+ *
+ * @details
+ * Marking the item finished stops every process of the item that wakes up later, the whole process group
+ * of the item (bidders, bids handlers, generator and timeout) is then cancelled in a single pass,
+ * so no bidder has to wake up to discover that the auction is over.
+ *
+ * @param item The auction item.
+ * @param winner Strategy of the winner, NONE if the item is not sold.
+ * @param ending The way the item ended.
+ * @param caller The process ending the item, it is not cancelled.
+ *
+ * @return void
+ */
+void finishItem(ItemState *item, int winner, ItemEnding ending, Entity *caller)
+{
+    if (item->finished)
+    {
+        return;
+    }
+    item->finished = true;
+
+    // Bidders waiting to bid are taken out of the queues, they are cancelled with the group
+    for (int type = AGENT; type <= LEARNER; type++)
+    {
+        Queue &queue = item->decidedToBid(type);
+        while (!queue.Empty())
+        {
+            queue.GetFirst();
+        }
+    }
+    for (Entity *&member : item->members)
+    {
+        if (member && member != caller)
+        {
+            Entity *cancelled = member;
+            member = nullptr;
+            cancelled->Cancel();
+            item->result.cancelled++;
+        }
+    }
+
+    stats->winners(winner);
+    if (config.servers > 0)
+    {
+        coverBackendSeconds(item);
+    }
+    ItemResult &result = item->result;
+    result.itemNumber = item->itemNumber;
+    result.winner = winner;
+    result.ending = ending;
+    result.finalPrice = config.floatPrices ? item->floatPrice : toAmount(item->currentPrice);
+    result.endTime = Time;
+
+    // Multi-unit and Dutch items allocate their units before they finish, a single unit goes to the winner
+    result.units = config.units;
+    result.winnerId = winner != NONE ? item->leaderId : -1;
+    if (result.unitsSold == 0 && winner != NONE)
+    {
+        result.unitsSold = 1;
+        result.unitsWon[winner + 1] = 1;
+        result.revenue = result.finalPrice;
+        recordWin(item->leaderId);
+        recordSurplus(winner, item->leaderValue, item->currentPrice);
+        recordConnectionWin(item->leaderConnection);
+        item->rewardLearner(item->leaderLearner, item->currentPrice);
+    }
+    result.unitsWon[0] = result.units - result.unitsSold;
+
+    // The policy learns from the outcome of the item, the timing matters only in the open ascending auction
+    policy.learn(item->learners, config.format == ENGLISH);
+    simulator->reportItem(result);
+
+    if (item->waitingForEnd)
+    {
+        item->waitingForEnd->Activate();
+        item->waitingForEnd = nullptr;
+    }
+}
+
+/**
+ * @brief Allocates the units of a multi-unit item to the winning bids of its bid book.
+ * Winning bids below the reserve price are rejected. With uniform pricing every winner pays the lowest
+ * accepted bid, with discriminatory pricing every winner pays the own bid.
+ *
+ * @param item The auction item.
+ *
+ * @return Strategy of the highest bidder, NONE if no unit is sold
+ */
+int allocateUnits(ItemState *item)
+{
+    ItemResult &result = item->result;
+    Cents lowest = 0;
+    Cents total = 0;
+    item->book.forEachWinning([&](const BookBid &bid)
+                              {
+        if (bid.amount < item->reservePrice)
+        {
+            return;
+        }
+        if (result.unitsSold == 0)
+        {
+            lowest = bid.amount;
+        }
+        result.unitsSold++;
+        result.unitsWon[bid.type + 1]++;
+        total += bid.amount;
+        recordWin(bid.owner);
+        recordSurplus(bid.type, bid.value, config.pricing == UNIFORM ? lowest : bid.amount);
+        recordConnectionWin(bid.connection);
+        item->rewardLearner(item->learnerOf(&bid), config.pricing == UNIFORM ? lowest : bid.amount); });
+
+    if (result.unitsSold == 0)
+    {
+        return NONE;
+    }
+    item->currentPrice = lowest;
+    item->leaderId = item->book.best()->owner;
+    result.revenue = toAmount(config.pricing == UNIFORM ? lowest * result.unitsSold : total);
+    return item->book.best()->type;
+}
+
+/**
+ * @class ItemProcess
+ * @brief Process belonging to a single auction item, keeps the item state alive.
+ */
+class ItemProcess : public Process
+{
+protected:
+    ItemState *item;
+    size_t slot; // Slot in the process group of the item
+
+public:
+    ItemProcess(ItemState *item) : item(item)
+    {
+        item->retain();
+        this->slot = item->join(this);
+    }
+
+    ~ItemProcess()
+    {
+        this->item->leave(this->slot);
+        this->item->release();
+    }
+};
+
+/**
+ * @class Bidder
+ * @brief Common base of the bidders of an auction item.
+ */
+class Bidder : public ItemProcess
+{
+protected:
+    Cents valuation = 0;         // The maximum price the bidder is willing to pay for the item
+    Cents value = 0;             // Drawn valuation, a won item yields value - price even if the bidder bids past it
+    double floatValuation;       // Unrounded valuation of the floating point model, if AuctionConfig::floatPrices is set
+    BookBid *standing = nullptr; // Slot of the bidder in the bid book of a multi-unit item
+    int32_t bidderId;            // Population identifier, -1 without a population
+    int learner = -1;            // Index in the learning batch of the item, -1 for the fixed strategies
+    int type;                    // Strategy of the bidder
+    int connection = -1;         // LatencyClass of the bidder, -1 without the latency model
+    bool inFlight = false;       // Flag if a bid of the bidder is on the way to the item
+
+    /**
+     * @brief Draws the latency of a bid submission from the latency class of the bidder.
+     * @return Latency in seconds
+     */
+    double networkDelay()
+    {
+        double bin = Random();
+        double offset = Random();
+        double delay = latencies[this->connection].sample(bin, offset);
+        LatencyStats &stats = simulator->latencyStats(this->connection);
+        stats.submitted++;
+        stats.delay += delay;
+        this->inFlight = true;
+        return delay;
+    }
+
+    /**
+     * @brief Checks if a sent bid still reaches the item, a late bid is counted for the latency class.
+     * @return true if the item ended before the bid arrived
+     */
+    bool arrivedLate()
+    {
+        bool late = Time >= item->endTime || item->finished;
+        if (late && this->inFlight)
+        {
+            simulator->latencyStats(this->connection).late++;
+        }
+        this->inFlight = false;
+        return late;
+    }
+
+public:
+    Bidder(ItemState *item, int type, double val, int32_t bidderId)
+        : ItemProcess(item), valuation(toCents(val)), value(toCents(val)), floatValuation(val), bidderId(bidderId), type(type)
+    {
+        // A persistent bidder keeps its connection, a new bidder draws it
+        if (config.latency)
+        {
+            this->connection = bidderId >= 0 ? population.connection(bidderId) : drawConnection(type);
+            simulator->latencyStats(this->connection).bidders++;
+        }
+        if (ItemState::multiUnit())
+        {
+            this->standing = item->book.add(type, bidderId);
+            this->standing->value = this->value;
+            this->standing->connection = this->connection;
+        }
+    }
+
+    // The item ended and cancelled the bidder while its bid was on the way
+    ~Bidder()
+    {
+        if (this->inFlight)
+        {
+            simulator->latencyStats(this->connection).late++;
+        }
+    }
+
+    Cents getValuation() const { return this->valuation; }
+    Cents getValue() const { return this->value; }
+    int32_t getBidderId() const { return this->bidderId; }
+    int getLearner() const { return this->learner; }
+    int getConnection() const { return this->connection; }
+    int getType() const { return this->type; }
+    BookBid *getStanding() { return this->standing; }
+
+    /**
+     * @brief Submits a bid and waits until it is processed, to the bids handler of the strategy or to the bid backend.
+     */
+    void submit();
+
+    /**
+     * @brief Checks if the bidder holds one of the winning bids of a multi-unit item, such a bidder does not raise.
+     */
+    bool isWinning() const { return this->standing && this->standing->active && this->standing->winning; }
+
+    /**
+     * @brief Checks if the current price is below the valuation of the bidder.
+     */
+    bool priceBelowValuation() const
+    {
+        return config.floatPrices ? item->floatPrice < this->floatValuation : item->currentPrice < this->valuation;
+    }
+
+    /**
+     * @brief Checks if the price raised by the minimal increment stays within the valuation of the bidder.
+     * @param inclusive Flag if a raised price equal to the valuation fits.
+     */
+    bool raiseFits(bool inclusive) const
+    {
+        if (config.floatPrices)
+        {
+            double raised = item->floatPrice + item->floatPrice * 0.01;
+            return inclusive ? raised <= this->floatValuation : raised < this->floatValuation;
+        }
+        Cents raised = item->currentPrice + item->minimalIncrement();
+        return inclusive ? raised <= this->valuation : raised < this->valuation;
+    }
+};
+
+/**
+ * @class AgentBidder
+ * @brief Represents an agent bidder strategy in an auction.
+ *
+ * @details
+ * Agents bid higher than the current price by the minimum increment if the current price is lower than the agent's item valuation.
+ * The bidding behavior is influenced by patience, which decreases over time.
+ *
+ * @note The agent does not engage in bidding during the early stages of the auction.
+ *
+ * @param valuation The maximum price the agent is willing to pay for the item.
+ */
+class AgentBidder : public Bidder
+{
+private:
+    // Behaviour helpers
+    double lastUpdateTime = 0;
+    const double UPDATE_INTERVAL = config.singleItemDuration / 100;
+
+    double patience = 1.0;
+
+public:
+    /**
+     * @brief Constructs an AgentBidder with a specified valuation.
+     * @param item The auction item.
+     * @param val The maximum price the agent is willing to pay for the item.
+     * @param bidderId Population identifier of the bidder.
+     */
+    AgentBidder(ItemState *item, double val, int32_t bidderId) : Bidder(item, AGENT, val, bidderId) {}
+
+    /**
+     * @brief The behavior of the agent bidder.
+     */
+    void Behavior()
+    {
+        while (priceBelowValuation() && (this->patience > Exponential(0.1)) && (Time < item->endTime) && !item->finished)
+        {
+            // Check if enough time has passed since the last update
+            if ((Time - lastUpdateTime) >= UPDATE_INTERVAL)
+            {
+                updatePatience();
+                lastUpdateTime = Time; // Update the timestamp
+            }
+
+            Wait(max(this->patience, 0.2));
+
+            // Agents do not engage in bidding in the early stages of the auction
+            if (Time > (item->endTime - (Exponential((config.singleItemDuration / 4) * 3))))
+            {
+                if ((Random() > this->patience) && raiseFits(false) && !isWinning())
+                {
+                    Wait(config.latency ? networkDelay() : 0.1);
+                    if (arrivedLate())
+                    {
+                        Terminate();
+                    }
+                    submit();
+                }
+            }
+        }
+        // Stop if patience is exhausted
+        if (this->patience <= 0)
+        {
+            trace("[AGENT] bidder ran out of patience and stopped bidding.\n");
+        }
+        Terminate();
+    }
+
+    /**
+     * @brief Updates the patience of the agent bidder based on the time remaining in the auction of an item.
+     */
+    void updatePatience()
+    {
+        double normalizedTime = (config.singleItemDuration - (item->endTime - Time)) / config.singleItemDuration;
+
+        if (normalizedTime < 0.75)
+        {
+            this->patience = 1.0 - (Exponential(0.01));
+        }
+        else
+        {
+            double remainingTime = (normalizedTime - 0.75) / (1.0 - 0.75);
+            this->patience = 0.99 - 0.1 * pow(remainingTime, 5);
+        }
+    }
+};
+
+/**
+ * @class RatchetBidder
+ * @brief Represents a ratchet bidder strategy in an auction.
+ *
+ * @details
+ * Ratchet bidders bid higher than the current price by the minimum increment if the current price is lower than the agent's item valuation.
+ * The bidding behavior is influenced by patience, which decreases over time.
+ *
+ * @note Ratchet bidders are humans, sometimes they are irrational and bid with a unrealistic price valuation.
+ *
+ * @param valuation The maximum price the ratchet bidder is willing to pay for the item.
+ */
+class RatchetBidder : public Bidder
+{
+private:
+    // Behaviour helpers
+    const double UPDATE_INTERVAL = config.singleItemDuration / 100;
+    double lastUpdateTime = 0;
+
+    double patience = 1.0; // Initial patience
+
+public:
+    /**
+     * @brief Constructs a RatchetBidder with a specified valuation.
+     * @param item The auction item.
+     * @param val The maximum price the agent is willing to pay for the item.
+     * @param bidderId Population identifier of the bidder.
+     */
+    RatchetBidder(ItemState *item, double val, int32_t bidderId) : Bidder(item, RATCHET, val, bidderId)
+    {
+        // 5% chance of being irrational
+        // The proxy bidding system needs a finite maximum, irrational bidders enter a multiple of their valuation
+        if (Random() < 0.05)
+        {
+            this->valuation = config.proxyBidding ? this->valuation * IRRATIONAL_PROXY_FACTOR : INFINITE_CENTS;
+            this->floatValuation = INFINITY;
+        }
+    }
+
+    /**
+     * @brief The behavior of the ratchet bidder.
+     */
+    void Behavior()
+    {
+        while (priceBelowValuation() && (this->patience > Exponential(0.1)) && (Time < item->endTime) && !item->finished)
+        {
+            if ((Time - lastUpdateTime) >= UPDATE_INTERVAL)
+            {
+                updatePatience();
+                lastUpdateTime = Time;
+            }
+
+            Wait(max(this->patience, 0.2));
+
+            // Check if the bidder should bid
+            if ((Random() > this->patience) && raiseFits(true) && !isWinning())
+            {
+                Wait(config.latency ? RATCHET_ENTRY + networkDelay() : 1);
+                if (arrivedLate())
+                {
+                    Terminate();
+                }
+                submit();
+            }
+        }
+        if (this->patience <= 0)
+        {
+            trace("[RATCHET] ran out of patience and stopped bidding.\n");
+        }
+        Terminate();
+    }
+
+    /**
+     * @brief Updates the patience of the ratchet bidder based on the time remaining in the auction of an item.
+     */
+    void updatePatience()
+    {
+        double normalizedTime = (config.singleItemDuration - (item->endTime - Time)) / config.singleItemDuration;
+        if (normalizedTime < 0.75)
+        {
+            this->patience = 1.0 - (Exponential(0.01));
+        }
+        else
+        {
+            double remainingTime = (normalizedTime - 0.75) / (1.0 - 0.75);
+            this->patience = 0.99 - 0.1 * pow(remainingTime, 5);
+        }
+    }
+};
+
+/**
+ * @class SnipingBidder
+ * @brief Represents a sniping bidder strategy in an auction.
+ *
+ * @details
+ * Sniping bidders bid higher than the current price by the minimum increment if the current price is lower than their item valuation.
+ * The bidding behavior is influenced by human reaction time and network latency. With the latency model the latency
+ * follows the latency class of the bidder, a sniping service in a datacenter has no reaction time.
+ *
+ * @note Sniping bidders generally do not want to bid when the price is high and their price valuation is lower.
+ *
+ * @param valuation The maximum price a sniper is willing to pay for the item.
+ */
+class SnipingBidder : public Bidder
+{
+private:
+    // A sniping service fires at a fixed lead before the end, a human aims at the end
+    double snipeDelay = this->connection == DATACENTER ? SNIPE_SERVICE_LEAD : Normal(0, 0.1 / 3);
+
+public:
+    /**
+     * @brief Constructs a SnipingBidder with a specified valuation.
+     * @param item The auction item.
+     * @param val The maximum price the sniper is willing to pay for the item.
+     * @param bidderId Population identifier of the bidder.
+     */
+    SnipingBidder(ItemState *item, double val, int32_t bidderId) : Bidder(item, SNIPER, val, bidderId) {}
+
+    /**
+     * @brief The behavior of the sniping bidder.
+     */
+    void Behavior()
+    {
+        // The snipe is planned against the current end time, if the end is extended in the meantime,
+        // the snipe is rescheduled when the bidder wakes up
+        unsigned endVersion;
+        do
+        {
+            endVersion = item->endVersion;
+            double snipeTime = item->endTime - this->snipeDelay;
+            if (Time < snipeTime)
+            {
+                Wait(snipeTime - Time);
+            }
+            if (endVersion != item->endVersion)
+            {
+                item->result.reschedules++;
+            }
+        } while (endVersion != item->endVersion && !item->finished);
+
+        // A sniping service fires the bid itself, without the reaction time of a human
+        if (this->connection != DATACENTER)
+        {
+            Wait(Exponential(0.2)); // Reaction time
+        }
+        Wait(config.latency ? networkDelay() : Exponential(0.1)); // Network latency
+
+        if (arrivedLate())
+        {
+            Terminate();
+        }
+
+        if (raiseFits(true) && !isWinning())
+        {
+            trace("[SNIPER No. %lu] bidder decided to bid at time: %.2f\n", id(), Time);
+            submit();
+        }
+        Terminate();
+    }
+};
+
+/**
+ * @class LearningBidder
+ * @brief Represents a learning bidder in an auction.
+ *
+ * @details
+ * The policy picks the shading of the valuation (the bid limit) and the entry time of the bidder before the end of
+ * the auction. After entering, the bidder raises the price by the minimal increment whenever it does not lead and
+ * the next price stays within its limit.
+ *
+ * @param valuation The bid limit, the shaded valuation of the bidder.
+ */
+class LearningBidder : public Bidder
+{
+private:
+    double entry; // Time before the end of the auction when the bidder starts bidding
+
+public:
+    /**
+     * @brief Constructs a LearningBidder with the actions of the policy.
+     * @param item The auction item.
+     * @param limit The bid limit, the shaded valuation.
+     * @param bidderId Population identifier of the bidder.
+     * @param learner Index of the bidder in the learning batch of the item.
+     * @param entry Time before the end of the auction when the bidder starts bidding.
+     */
+    LearningBidder(ItemState *item, double limit, int32_t bidderId, int learner, double entry)
+        : Bidder(item, LEARNER, limit, bidderId), entry(entry)
+    {
+        this->learner = learner;
+        this->value = toCents(item->learners.valuation[learner]);
+        if (this->standing)
+        {
+            this->standing->value = this->value;
+            item->learnerBids[learner] = this->standing;
+        }
+    }
+
+    bool isLeading() const { return ItemState::multiUnit() ? isWinning() : item->leaderLearner == this->learner; }
+
+    /**
+     * @brief The behavior of the learning bidder.
+     */
+    void Behavior()
+    {
+        // The entry is planned against the current end time, soft close may move the end later
+        while (!item->finished && Time < item->endTime - this->entry)
+        {
+            Wait(item->endTime - this->entry - Time);
+        }
+        while (Time < item->endTime && !item->finished && raiseFits(true))
+        {
+            if (!isLeading())
+            {
+                if (config.latency)
+                {
+                    Wait(networkDelay());
+                    if (arrivedLate())
+                    {
+                        break;
+                    }
+                }
+                submit();
+            }
+            Wait(Exponential(LEARNER_REACTION));
+        }
+        Terminate();
+    }
+};
+
+/**
+ * @class Bids
+ * @brief Represents the bidding process of bidders of a single strategy in an auction.
+ */
+class Bids : public ItemProcess
+{
+private:
+    int type; // Strategy of the handled bidders
+
+    static constexpr const char *LABELS[4] = {"AGENT", "RATCHET", "SNIPER", "LEARNER"};
+
+public:
+    /**
+     * @brief Constructs the bids handler of a strategy.
+     * @param item The auction item.
+     * @param type The strategy of the handled bidders.
+     */
+    Bids(ItemState *item, int type) : ItemProcess(item), type(type) {}
+
+    /**
+     * @brief Places a bid of a bidder on the item.
+     * The bid raises the price by the minimal increment, in proxy bidding the bidder's maximum is submitted
+     * and the price is resolved to the second highest maximum plus its increment. On a multi-unit item the bid
+     * enters the bid book and the price follows the lowest of the winning bids.
+     *
+     * @param item The auction item.
+     * @param bidder The bidding bidder.
+     * @param type Strategy of the bidder.
+     *
+     * @return true if the bidder bought the item for the Buy-It-Now price
+     */
+    static bool placeBid(ItemState *item, Bidder *bidder, int type)
+    {
+        // Buy-It-Now is available until the first bid
+        bool buyItNow = item->buyItNowPrice > 0 && !item->firstBidPlaced && bidder->getValuation() >= item->buyItNowPrice;
+
+        item->firstBidPlaced = true;
+        item->result.bids++;
+        if (bidder->getConnection() >= 0)
+        {
+            simulator->latencyStats(bidder->getConnection()).bids++;
+        }
+        if (bidder->getBidderId() >= 0)
+        {
+            population.bid(bidder->getBidderId());
+        }
+        if (buyItNow)
+        {
+            item->currentPrice = item->buyItNowPrice;
+            item->lastBidder = type;
+            item->leaderId = bidder->getBidderId();
+            item->leaderLearner = bidder->getLearner();
+            item->leaderValue = bidder->getValue();
+            item->leaderConnection = bidder->getConnection();
+            return true;
+        }
+
+        // Soft close, a bid in the final window extends the end of the auction
+        if (config.softClose > 0 && item->endTime - Time < config.softClose)
+        {
+            item->endTime = Time + config.softClose;
+            item->endVersion++;
+            item->result.extensions++;
+        }
+
+        if (ItemState::multiUnit())
+        {
+            BidBook &book = item->book;
+            book.place(bidder->getStanding(), item->currentPrice + item->minimalIncrement());
+            if (book.full())
+            {
+                item->currentPrice = book.kth()->amount;
+            }
+            item->lastBidder = book.best()->type;
+            item->leaderId = book.best()->owner;
+            return false;
+        }
+
+        if (!config.proxyBidding)
+        {
+            item->currentPrice += item->minimalIncrement();
+            item->floatPrice += item->floatPrice * 0.01;
+            item->lastBidder = type;
+            item->leaderId = bidder->getBidderId();
+            item->leaderLearner = bidder->getLearner();
+            item->leaderValue = bidder->getValue();
+            item->leaderConnection = bidder->getConnection();
+            return false;
+        }
+
+        ProxyBook &book = item->proxyBids;
+        book.insert({bidder->getValuation(), (uint64_t)item->result.bids, type, bidder->getBidderId(), bidder->getLearner(),
+                      bidder->getValue(), bidder->getConnection()});
+        if (book.size() > 1)
+        {
+            const ProxyBid &second = book.second();
+            Cents price = min(book.highest().maximum, second.maximum + tieredIncrement(second.maximum));
+            item->currentPrice = max(item->currentPrice, price);
+        }
+        item->lastBidder = book.highest().type;
+        item->leaderId = book.highest().owner;
+        item->leaderLearner = book.highest().learner;
+        item->leaderValue = book.highest().value;
+        item->leaderConnection = book.highest().connection;
+        return false;
+    }
+
+    /**
+     * @brief Places a bid of a bidder on the item and reports it.
+     *
+     * @param item The auction item.
+     * @param bidder The bidding bidder.
+     * @param type Strategy of the bidder.
+     *
+     * @return true if the bidder bought the item for the Buy-It-Now price
+     */
+    static bool commitBid(ItemState *item, Bidder *bidder, int type)
+    {
+        bool boughtNow = placeBid(item, bidder, type);
+        if (type == SNIPER)
+        {
+            trace("[SNIPER No. %lu] bidder placed a bid at time: %.2f. New price: %.2f\n", bidder->id(), Time, toAmount(item->currentPrice));
+        }
+        else
+        {
+            trace("[%s] bidder placed a bid at time: %.2f. New price: %.2f\n", LABELS[type], Time, toAmount(item->currentPrice));
+        }
+
+        BidEvent bid;
+        bid.itemNumber = item->itemNumber;
+        bid.bidder = type;
+        bid.bidderId = bidder->getBidderId() >= 0 ? (uint64_t)bidder->getBidderId() : bidder->id();
+        bid.time = Time;
+        bid.itemTime = Time - item->startTime;
+        bid.amount = ItemState::multiUnit() ? toAmount(bidder->getStanding()->amount) : config.floatPrices ? item->floatPrice : toAmount(item->currentPrice);
+        simulator->reportBid(bid);
+        return boughtNow;
+    }
+
+    void Behavior()
+    {
+        Queue &decidedToBid = item->decidedToBid(this->type);
+        while (Time < item->endTime)
+        {
+            Wait(0.1); // Time to process the bid
+
+            if (Time >= item->endTime)
+            {
+                Passivate();
+            }
+            if (!decidedToBid.Empty())
+            {
+                if (!stats->biddingFacility.Busy())
+                {
+                    Seize(stats->biddingFacility);
+
+                    // The first bidder in the queue places the bid
+                    Bidder *bidder = (Bidder *)decidedToBid.GetFirst();
+                    bool boughtNow = commitBid(item, bidder, this->type);
+
+                    // Buying the item ends the auction, the whole item is cancelled
+                    if (boughtNow)
+                    {
+                        trace("Item bought for the Buy-It-Now price %.2f\n", toAmount(item->currentPrice));
+                        Release(stats->biddingFacility);
+                        finishItem(item, this->type, BOUGHT_NOW, this);
+                        Terminate();
+                    }
+
+                    // The proxy bidding system keeps bidding for the bidder, the bidder is done
+                    if (config.proxyBidding)
+                    {
+                        bidder->Cancel();
+                    }
+                    else
+                    {
+                        bidder->Activate();
+                    }
+
+                    returnFromQueues(item);
+                    Release(stats->biddingFacility);
+                }
+            }
+        }
+        Passivate();
+    }
+};
+
+/**
+ * @brief Draws the service time of a bid in the bid backend.
+ *
+ * @return Service time in seconds
+ */
+double drawServiceTime()
+{
+    switch (config.service)
+    {
+    case DETERMINISTIC_SERVICE:
+        return config.serviceTime;
+    case LOGNORMAL_SERVICE:
+    {
+        // Coefficient of variation 2: sigma^2 = ln(1 + 2^2), the mean is exp(mu + sigma^2 / 2)
+        double sigma = sqrt(log(5.0));
+        return exp(Normal(log(config.serviceTime) - sigma * sigma / 2, sigma));
+    }
+    default:
+        return Exponential(config.serviceTime);
+    }
+}
+
+/**
+ * @class BidRequest
+ * @brief A bid travelling through the bid backend, a multi-server queue with a finite waiting room.
+ *
+ * @details
+ * The request holds the item but does not join its process group, so it outlives the end of the item and a bid
+ * served after the end is counted as expired. A bid arriving at a full queue is rejected and the bidder goes on
+ * as if it had been outbid. The load is recorded per second of auction time.
+ */
+class BidRequest : public Process
+{
+private:
+    ItemState *item;
+    Bidder *bidder;
+
+    BackendSecond &second(double time) const { return simulator->backendSecond(time - item->startTime); }
+
+    /**
+     * @brief Spreads the service of a bid over the seconds of auction time it covers.
+     */
+    void recordBusy(double from, double to) const
+    {
+        from -= item->startTime;
+        to -= item->startTime;
+        while (from < to)
+        {
+            double end = min(to, floor(from) + 1);
+            simulator->backendSecond(from).busy += end - from;
+            from = end;
+        }
+    }
+
+public:
+    BidRequest(ItemState *item, Bidder *bidder) : item(item), bidder(bidder) { item->retain(); }
+
+    ~BidRequest() { this->item->release(); }
+
+    void Behavior()
+    {
+        Store &backend = stats->backend;
+        double arrival = Time;
+        BackendSecond &arrived = second(arrival);
+        arrived.arrivals++;
+        arrived.maxQueue = max<int32_t>(arrived.maxQueue, backend.QueueLen());
+        if (backend.Full() && (int)backend.QueueLen() >= config.queueCapacity)
+        {
+            arrived.rejected++;
+            if (!item->finished)
+            {
+                bidder->Activate();
+            }
+            Terminate();
+        }
+
+        Enter(backend, 1);
+        double wait = Time - arrival;
+        stats->backendWait(wait);
+        double start = Time;
+        Wait(drawServiceTime());
+        Leave(backend, 1);
+        recordBusy(start, Time);
+        coverBackendSeconds(item);
+
+        // Seconds are resolved again, the vector may have grown in the meantime
+        BackendSecond &served = second(arrival);
+        served.served++;
+        served.wait += wait;
+        served.maxWait = max(served.maxWait, wait);
+        if (item->finished || Time >= item->endTime)
+        {
+            served.expired++;
+            Terminate();
+        }
+
+        // The price may have moved past the bidder while the bid waited, the bidder reconsiders
+        int type = bidder->getType();
+        if (!config.proxyBidding && !ItemState::multiUnit() && !bidder->raiseFits(true))
+        {
+            bidder->Activate();
+            Terminate();
+        }
+
+        if (Bids::commitBid(item, bidder, type))
+        {
+            trace("Item bought for the Buy-It-Now price %.2f\n", toAmount(item->currentPrice));
+            finishItem(item, type, BOUGHT_NOW, this);
+        }
+        else if (config.proxyBidding)
+        {
+            bidder->Cancel();
+        }
+        else
+        {
+            bidder->Activate();
+        }
+        Terminate();
+    }
+};
+
+void Bidder::submit()
+{
+    if (config.servers > 0)
+    {
+        (new BidRequest(this->item, this))->Activate();
+    }
+    else
+    {
+        this->item->decidedToBid(this->type).Insert(this);
+    }
+    Passivate();
+}
+
+/**
+ * @class BidderGenerator
+ * @brief Generates bidders for an auction item.
+ *
+ * @details
+ * The bidder generator creates a specified number of bidders for an auction item.
+ *
+ * @note The bidder generator generates agents, ratchet bidders, and snipers based on the probabilities of each strategy.
+ * The probabilities are set according to the reference paper, learning bidders take the configured share. With
+ * a persistent population the bidders are sampled from it and keep their strategy, only the valuation is drawn for
+ * the item.
+ *
+ * @param realPrice The real price of the item.
+ *
+ */
+class BidderGenerator : public ItemProcess
+{
+private:
+    double RealPrice = 0;
+
+public:
+    /**
+     * @brief Constructs a BidderGenerator with a specified real price.
+     * @param item The auction item.
+     * @param realPrice The real price of the item.
+     */
+    BidderGenerator(ItemState *item, double realPrice) : ItemProcess(item)
+    {
+        this->RealPrice = realPrice;
+    }
+
+    /**
+     * @brief Acceptance price of a Dutch auction bidder.
+     * Agents and snipers shade their valuation to (n - 1) / n of it like in a first-price auction, which the Dutch
+     * auction is strategically equivalent to, ratchet bidders are impatient and stop the clock at their valuation.
+     *
+     * @param type Strategy of the bidder.
+     * @param valuation Valuation of the bidder.
+     * @param bidders Number of bidders of the item.
+     *
+     * @return The highest clock price the bidder accepts
+     */
+    static Cents acceptancePrice(int type, Cents valuation, int bidders)
+    {
+        return type == RATCHET ? valuation : valuation * (bidders - 1) / bidders;
+    }
+
+    /**
+     * @brief Creates a bidder of the item, a Dutch auction bidder only enters its acceptance price into the bid book.
+     *
+     * @param strategy Strategy of the bidder.
+     * @param valuation Valuation of the bidder.
+     * @param bidderId Population identifier of the bidder.
+     * @param learner Index of a learning bidder in the batch of the item.
+     * @param roundBidders Number of bidders of the item.
+     */
+    void addBidder(BidderType strategy, double valuation, int32_t bidderId, int learner, int roundBidders)
+    {
+        item->result.agents += strategy == AGENT;
+        item->result.ratchets += strategy == RATCHET;
+        item->result.snipers += strategy == SNIPER;
+        item->result.learners += strategy == LEARNER;
+        const LearningBatch &batch = item->learners;
+
+        // Bidders of a Dutch auction only wait for the clock, their acceptance prices enter the bid book
+        if (config.format == DUTCH)
+        {
+            BookBid *bid = item->book.add(strategy, bidderId);
+            bid->value = toCents(valuation);
+            if (learner >= 0)
+            {
+                item->book.place(bid, toCents(valuation * batch.shading[learner]));
+                item->learnerBids[learner] = bid;
+            }
+            else
+            {
+                item->book.place(bid, acceptancePrice(strategy, toCents(valuation), roundBidders));
+            }
+            return;
+        }
+
+        // Generate bidder with the given strategy
+        Process *bidder;
+        switch (strategy)
+        {
+        case AGENT:
+            bidder = new AgentBidder(item, valuation, bidderId);
+            break;
+        case RATCHET:
+            bidder = new RatchetBidder(item, valuation, bidderId);
+            break;
+        case SNIPER:
+            bidder = new SnipingBidder(item, valuation, bidderId);
+            break;
+        default:
+            bidder = new LearningBidder(item, valuation * batch.shading[learner], bidderId, learner,
+                                        batch.timing[learner] * config.singleItemDuration);
+            break;
+        }
+        bidder->Activate();
+    }
+
+    /**
+     * @brief The behavior of the bidder generator.
+     */
+    void Behavior()
+    {
+        // Every bidder of the item is drawn up front, so the policy is evaluated once for all its learning bidders
+        int roundBidders = drawRoundBidders();
+        vector<int32_t> bidderIds(roundBidders, -1);
+        vector<BidderType> strategies(roundBidders, AGENT);
+        vector<double> valuations(roundBidders, 0);
+        vector<int> learners(roundBidders, -1);
+        for (int i = 0; i < roundBidders; i++)
+        {
+            // Strategy of the bidder follows the reference paper, a persistent bidder keeps its strategy
+            bidderIds[i] = population.size() > 0 ? sampleBidder(item->itemNumber) : -1;
+            if (population.size() > 0 && bidderIds[i] < 0)
+            {
+                continue; // The population is exhausted, every draw hit a bidder of the item
+            }
+            strategies[i] = bidderIds[i] >= 0 ? (BidderType)population.type(bidderIds[i]) : drawStrategy();
+            valuations[i] = drawValuation(strategies[i], RealPrice);
+            if (strategies[i] == LEARNER)
+            {
+                learners[i] = addLearner(item->learners, valuations[i], item->currentPrice, roundBidders);
+            }
+        }
+        policy.act(item->learners);
+        item->learnerBids.assign(item->learners.size(), nullptr);
+
+        for (int i = 0; i < roundBidders; i++)
+        {
+            // Wait between the potential bidders to simulate real auction
+            Wait(Exponential((config.singleItemDuration / 2) / config.numberOfBidders));
+
+            // No more bidders are needed for a discarded item
+            if (item->finished)
+            {
+                break;
+            }
+            if (population.size() > 0 && bidderIds[i] < 0)
+            {
+                continue;
+            }
+            if (bidderIds[i] >= 0)
+            {
+                enterBidder(bidderIds[i], item->result);
+            }
+            addBidder(strategies[i], valuations[i], bidderIds[i], learners[i], roundBidders);
+        }
+        trace("Generated %d agents, %d ratchets, %d snipers, %d learners\n", item->result.agents, item->result.ratchets,
+              item->result.snipers, item->result.learners);
+        Terminate();
+    }
+};
+
+/**
+ * @class FirstBidTimeout
+ * @brief Represents a timeout for the first bid in an auction.
+ *
+ * @details
+ * The first bid timeout checks if a bid was placed in the first 30 seconds of an auction item.
+ * If no bid was placed, the item is discarded.
+ *
+ * @param p The process of the auction item.
+ * @param item The auction item.
+ * @param dt The time after which the timeout occurs.
+ */
+class FirstBidTimeout : public Event
+{
+    ItemState *item;
+    size_t slot;
+
+public:
+    FirstBidTimeout(ItemState *item, double dt) : item(item)
+    {
+        item->retain();
+        this->slot = item->join(this);
+        Activate(Time + dt);
+    }
+
+    ~FirstBidTimeout()
+    {
+        detach();
+    }
+
+    /**
+     * @brief Leaves the process group and releases the item, the event is done with it.
+     */
+    void detach()
+    {
+        if (this->item)
+        {
+            this->item->leave(this->slot);
+            this->item->release();
+            this->item = nullptr;
+        }
+    }
+
+    void Behavior()
+    {
+        if (!item->firstBidPlaced && !item->finished)
+        {
+            trace("No bids were placed in the first %.0f seconds, the item is discarded\n", config.auctionItemTimeout);
+            finishItem(item, NONE, NO_BIDS, this);
+        }
+        detach();
+    }
+};
+
+/**
+ * @class AuctionItem
+ * @brief Represents an auction item.
+ *
+ * @details
+ * The auction item generates bidders for the item and handles the auction process.
+ *
+ * @note The auction item is discarded if no bid is placed in the first 30 seconds.
+ */
+class AuctionItem : public ItemProcess
+{
+public:
+    AuctionItem() : ItemProcess(new ItemState) {}
+
+    ItemState *getState() { return this->item; }
+
+    /**
+     * @brief Runs the descending clock of a Dutch auction.
+     * The price drops linearly from the opening price to the starting price (or the reserve price) over the duration
+     * of the item. At every tick the bidders whose acceptance price reached the clock take the remaining units,
+     * the highest acceptance price first, each pays the clock price. With uniform pricing every winner pays the
+     * last accepted clock price instead.
+     *
+     * @param realPrice The real price of the item.
+     */
+    void runClock(double realPrice)
+    {
+        ItemResult &result = item->result;
+        BidBook &book = item->book;
+        Cents opening = max(toCents(realPrice * DUTCH_OPENING_FACTOR), item->currentPrice);
+        Cents floor = max(item->currentPrice, item->reservePrice);
+        int ticks = max((int)(config.singleItemDuration / DUTCH_TICK), 1);
+
+        int winner = NONE;
+        Cents lastAccepted = 0;
+        Cents total = 0;
+        vector<pair<const BookBid *, Cents>> acceptedBids; // Bids that took a unit and their clock prices
+        for (int tick = 0; tick <= ticks && result.unitsSold < config.units; tick++)
+        {
+            if (tick > 0)
+            {
+                Wait(DUTCH_TICK);
+            }
+            Cents price = opening - (opening - floor) * tick / ticks;
+            while (result.unitsSold < config.units && book.best() && book.best()->amount >= price)
+            {
+                BookBid *accepted = book.popBest();
+                if (winner == NONE)
+                {
+                    winner = accepted->type;
+                    item->leaderId = accepted->owner;
+                }
+                if (accepted->owner >= 0)
+                {
+                    population.bid(accepted->owner);
+                }
+                recordWin(accepted->owner);
+                acceptedBids.push_back({accepted, price});
+                lastAccepted = price;
+                total += price;
+                result.unitsSold++;
+                result.unitsWon[accepted->type + 1]++;
+                result.bids++;
+                trace("[DUTCH] unit %d accepted at time: %.2f for %.2f\n", result.unitsSold, Time, toAmount(price));
+                uint64_t bidderId = accepted->owner >= 0 ? (uint64_t)accepted->owner : accepted->sequence;
+                simulator->reportBid({item->itemNumber, accepted->type, bidderId, Time, Time - item->startTime, toAmount(price)});
+            }
+        }
+
+        if (winner == NONE)
+        {
+            trace("Item not sold (nobody accepted the clock price)\n");
+            finishItem(item, NONE, NO_BIDS, this);
+            return;
+        }
+        item->firstBidPlaced = true;
+        item->currentPrice = lastAccepted;
+        result.revenue = toAmount(config.pricing == UNIFORM ? lastAccepted * result.unitsSold : total);
+        for (const pair<const BookBid *, Cents> &accepted : acceptedBids)
+        {
+            Cents paid = config.pricing == UNIFORM ? lastAccepted : accepted.second;
+            recordSurplus(accepted.first->type, accepted.first->value, paid);
+            item->rewardLearner(item->learnerOf(accepted.first), paid);
+        }
+        trace("Sold %d of %d units, last at price %.2f\n", result.unitsSold, config.units, toAmount(lastAccepted));
+        finishItem(item, winner, SOLD, this);
+    }
+
+    void Behavior()
+    {
+        Priority = 10;
+
+        // Set the end time of the item
+        item->startTime = Time;
+        item->endTime = Time + config.singleItemDuration;
+        item->itemNumber = ++itemsStarted;
+
+        // Generate the value of the item
+        double RealPrice = drawRealPrice();
+        trace("Created item with value %.2f\n", RealPrice);
+
+        // Starting price of the item
+        item->floatPrice = drawStartPrice(RealPrice);
+        item->currentPrice = toCents(item->floatPrice);
+        item->result.realPrice = RealPrice;
+        item->result.startPrice = config.floatPrices ? item->floatPrice : toAmount(item->currentPrice);
+
+        trace("Auction started for item valued at %.2f\n", toAmount(item->currentPrice));
+
+        // Buy-It-Now and reserve prices are set relative to the real price
+        if (config.buyItNow > 0)
+        {
+            item->buyItNowPrice = toCents(RealPrice * config.buyItNow);
+        }
+        item->reservePrice = toCents(RealPrice * config.reservePrice);
+
+        if (config.format == DUTCH)
+        {
+            (new BidderGenerator(item, RealPrice))->Activate();
+            runClock(RealPrice);
+            Terminate();
+        }
+
+        // Learning bidders have their own bids handler, only when there are any, the bid backend replaces the handlers
+        int lastType = config.learners > 0 ? LEARNER : SNIPER;
+        for (int type = AGENT; type <= lastType && config.servers == 0; type++)
+        {
+            (new Bids(item, type))->Activate();
+        }
+
+        // Create bidders
+        (new BidderGenerator(item, RealPrice))->Activate();
+
+        // If there are no bidders in the first 30 seconds, the item is discarded
+        new FirstBidTimeout(item, config.auctionItemTimeout);
+
+        trace("This auction will end at %.2f\n", item->endTime);
+        trace("Current time is %.2f\n", Time);
+
+        // Wait until the end of the auction, soft close may extend it while waiting
+        Wait(config.singleItemDuration);
+        while (Time < item->endTime)
+        {
+            item->result.reschedules++;
+            Wait(item->endTime - Time);
+        }
+        trace("Auction ended\n");
+
+        // If a bid was placed, the item is sold, units of a multi-unit item go to the winning bids
+        int winner = NONE;
+        if (ItemState::multiUnit())
+        {
+            winner = allocateUnits(item);
+        }
+        else if (item->currentPrice >= item->reservePrice)
+        {
+            winner = item->lastBidder;
+        }
+
+        if (item->firstBidPlaced && winner != NONE)
+        {
+            trace("Item sold at price %.2f\n", toAmount(item->currentPrice));
+            trace("Winner: %d\n", winner);
+            finishItem(item, winner, SOLD, this);
+        }
+        else if (item->firstBidPlaced)
+        {
+            trace("Item not sold (reserve price %.2f not met)\n", toAmount(item->reservePrice));
+            finishItem(item, NONE, RESERVE_NOT_MET, this);
+        }
+        else
+        {
+            // Should not happen, it is caught by the timeout
+            trace("Item not sold (no bids)\n");
+            finishItem(item, NONE, NO_BIDS, this);
+        }
+        Terminate();
+    }
+};
+
+/**
+ * @class Auction
+ * @brief Represents an auction process for a set of auction items.
+ */
+class Auction : public Process
+{
+public:
+    /**
+     * @brief The behavior of the auction process.
+     */
+    void Behavior()
+    {
+        while (itemsStarted < config.numberOfItems)
+        {
+            // Indicates the end of the auction for a single item
+            Seize(stats->runningAuction);
+            trace("AUCTION STARTED\n");
+
+            // Create and activate a new auction item
+            AuctionItem *auctionItem = new AuctionItem();
+            ItemState *item = auctionItem->getState();
+            item->retain();
+            auctionItem->Activate();
+
+            // Wait until the item ends, soft close may extend it
+            Wait(config.singleItemDuration);
+            if (!item->finished)
+            {
+                item->waitingForEnd = this;
+                Passivate();
+            }
+            item->release();
+
+            // Pause between items
+            Wait(30);
+
+            Release(stats->runningAuction);
+        }
+        trace("All items auctioned!\n");
+    }
+};
+
+/**
+ * @class PacingClock
+ * @brief Couples the simulation time to the wall clock in a paced run.
+ *
+ * @details
+ * Every tick of the wall clock (scaled to simulated time by the pacing ratio) the clock waits until the wall clock
+ * catches up with the simulated time, the events between two ticks run as fast as possible. Ticks stop with the
+ * last item.
+ */
+class PacingClock : public Process
+{
+public:
+    void Behavior()
+    {
+        PacingStats &pacing = simulator->pacingStats();
+        Pacer pacer(config.pacingSpin * 1e9);
+        int64_t start = Pacer::now();
+        double nanoseconds = 1e9 / config.pacing;
+        while ((int)simulator->getResults().items.size() < config.numberOfItems)
+        {
+            Wait(config.pacingTick * config.pacing);
+            int64_t deadline = start + (int64_t)(Time * nanoseconds);
+            int64_t error = pacer.sleepUntil(deadline);
+            pacing.ticks++;
+            if (error < 0)
+            {
+                pacing.late++;
+                pacing.lag.record(-error);
+            }
+            else
+            {
+                pacing.jitter.record(error);
+            }
+        }
+        pacing.seconds = (Pacer::now() - start) / 1e9;
+    }
+};
+
+const Cents NO_BID = INT64_MIN; // Marks a sealed bid below the starting price, below any bid including negative ones
+const int BID_LANES = 8;        // Bids compared at once by highestBids, a vector register of 64-bit bids with AVX-512
+
+typedef Cents BidLanes __attribute__((vector_size(BID_LANES * sizeof(Cents)))); // BID_LANES bids in one vector
+
+/**
+ * @brief Finds the highest and the second highest bid and the earliest bidder of the highest one in a single pass.
+ * Every lane keeps its own highest bid, second bid and its index over the bids i with the same i % BID_LANES. The lanes
+ * are a GCC vector, so the pass compares BID_LANES bids per instruction without relying on the auto-vectorizer, which
+ * cannot split the dependency between the highest and the second bid into lanes. The lanes are reduced at the end.
+ *
+ * @param bids The bids, NO_BID for missing bids.
+ * @param count Number of the bids.
+ * @param highest The highest bid, NO_BID if there is none.
+ * @param second The second highest bid, NO_BID if there is none.
+ *
+ * @return Index of the earliest highest bid, -1 if there is none
+ */
+int highestBids(const Cents *bids, int count, Cents &highest, Cents &second)
+{
+    BidLanes first = BidLanes{} + NO_BID;
+    BidLanes next = first;
+    BidLanes index = BidLanes{} - 1;
+    BidLanes position;
+    for (int lane = 0; lane < BID_LANES; lane++)
+    {
+        position[lane] = lane;
+    }
+
+    // A lane takes a new index only for a strictly higher bid, so it keeps its earliest highest bid
+    for (int i = 0; i < count; i += BID_LANES)
+    {
+        BidLanes bid = BidLanes{} + NO_BID;
+        memcpy(&bid, bids + i, min(BID_LANES, count - i) * sizeof(Cents));
+        BidLanes lower = bid < first ? bid : first;
+        next = next > lower ? next : lower;
+        index = bid > first ? position : index;
+        first = bid > first ? bid : first;
+        position += BID_LANES;
+    }
+
+    // The earliest of the lanes holding the highest bid wins, the highest bids of the other lanes compete for the second
+    int winnerLane = 0;
+    for (int lane = 1; lane < BID_LANES; lane++)
+    {
+        if (first[lane] > first[winnerLane] || (first[lane] == first[winnerLane] && index[lane] < index[winnerLane]))
+        {
+            winnerLane = lane;
+        }
+    }
+    highest = first[winnerLane];
+    second = next[winnerLane];
+    for (int lane = 0; lane < BID_LANES; lane++)
+    {
+        if (lane != winnerLane)
+        {
+            second = max(second, first[lane]);
+        }
+    }
+    return index[winnerLane];
+}
+
+/**
+ * @brief Runs all items as sealed-bid auctions.
+ *
+ * @details
+ * Every item gets the same population of bidders as in the open auction, each bidder submits a single bid.
+ * In a first-price auction bidders shade their valuation to (n - 1) / n of it (the equilibrium for n bidders),
+ * the winner pays the own bid. In a second-price (Vickrey) auction bidding the valuation is dominant,
+ * the winner pays the second highest bid. Bids below the starting price are not accepted. Learning bidders bid
+ * their shaded valuation, the policy is evaluated once per item for all of them.
+ *
+ * @return void
+ */
+void runSealedItems()
+{
+    // Bid arrays are reused between the items
+    vector<Cents> bids;
+    vector<Cents> valuations;
+    vector<int8_t> strategies;
+    vector<int32_t> bidderIds;
+    vector<int> learners;
+    LearningBatch batch;
+
+    for (int itemNumber = 1; itemNumber <= config.numberOfItems; itemNumber++)
+    {
+        ItemResult result = {};
+        result.itemNumber = itemNumber;
+        result.winnerId = -1;
+        result.realPrice = drawRealPrice();
+        Cents startPrice = toCents(drawStartPrice(result.realPrice));
+        result.startPrice = toAmount(startPrice);
+        result.endTime = itemNumber * (config.singleItemDuration + 30) - 30;
+
+        // Draw the bidders and their bids
+        int roundBidders = drawRoundBidders();
+        bids.resize(roundBidders);
+        valuations.resize(roundBidders);
+        strategies.resize(roundBidders);
+        bidderIds.resize(roundBidders);
+        learners.assign(roundBidders, -1);
+        batch.clear();
+        for (int i = 0; i < roundBidders; i++)
+        {
+            int32_t bidderId = population.size() > 0 ? sampleBidder(itemNumber) : -1;
+            bidderIds[i] = bidderId;
+            if (population.size() > 0 && bidderId < 0)
+            {
+                strategies[i] = NONE;
+                continue;
+            }
+            if (bidderId >= 0)
+            {
+                enterBidder(bidderId, result); // Every bidder of a sealed-bid item submits its bid
+            }
+            BidderType strategy = bidderId >= 0 ? (BidderType)population.type(bidderId) : drawStrategy();
+            double valuation = drawValuation(strategy, result.realPrice);
+            strategies[i] = strategy;
+            valuations[i] = toCents(valuation);
+            if (strategy == LEARNER)
+            {
+                learners[i] = addLearner(batch, valuation, startPrice, roundBidders);
+            }
+        }
+        policy.act(batch);
+
+        for (int i = 0; i < roundBidders; i++)
+        {
+            int strategy = strategies[i];
+            if (strategy == NONE)
+            {
+                bids[i] = NO_BID;
+                continue;
+            }
+            Cents bid = valuations[i];
+            if (learners[i] >= 0)
+            {
+                bid = toCents(toAmount(valuations[i]) * batch.shading[learners[i]]);
+            }
+            else if (config.format == FIRST_PRICE)
+            {
+                bid = valuations[i] * (roundBidders - 1) / roundBidders;
+            }
+            if (bidderIds[i] >= 0 && bid >= startPrice)
+            {
+                population.bid(bidderIds[i]);
+            }
+
+            bids[i] = bid >= startPrice ? bid : NO_BID;
+            result.bids += bid >= startPrice;
+            result.agents += strategy == AGENT;
+            result.ratchets += strategy == RATCHET;
+            result.snipers += strategy == SNIPER;
+            result.learners += strategy == LEARNER;
+        }
+
+        // Resolve the winner and the price
+        Cents highest;
+        Cents second;
+        int winner = highestBids(bids.data(), roundBidders, highest, second);
+        Cents reservePrice = toCents(result.realPrice * config.reservePrice);
+        Cents price = config.format == FIRST_PRICE ? highest : max(second, startPrice);
+        if (highest == NO_BID)
+        {
+            result.winner = NONE;
+            result.ending = NO_BIDS;
+            result.finalPrice = result.startPrice;
+        }
+        else if (price < reservePrice)
+        {
+            result.winner = NONE;
+            result.ending = RESERVE_NOT_MET;
+            result.finalPrice = toAmount(price);
+        }
+        else
+        {
+            result.winner = strategies[winner];
+            result.winnerId = bidderIds[winner];
+            result.ending = SOLD;
+            result.finalPrice = toAmount(price);
+            recordWin(bidderIds[winner]);
+            recordSurplus(strategies[winner], valuations[winner], price);
+            if (learners[winner] >= 0)
+            {
+                batch.reward[learners[winner]] = (batch.valuation[learners[winner]] - result.finalPrice) / batch.valuation[learners[winner]];
+            }
+        }
+        policy.learn(batch, false);
+
+        result.units = 1;
+        result.unitsSold = result.winner != NONE;
+        result.unitsWon[result.winner + 1] = 1;
+        result.revenue = result.winner != NONE ? result.finalPrice : 0;
+
+        if (config.recordBids)
+        {
+            for (int i = 0; i < roundBidders; i++)
+            {
+                if (bids[i] != NO_BID)
+                {
+                    uint64_t bidderId = bidderIds[i] >= 0 ? (uint64_t)bidderIds[i] : (uint64_t)i;
+                    simulator->reportBid({itemNumber, strategies[i], bidderId, result.endTime, (double)config.singleItemDuration, toAmount(bids[i])});
+                }
+            }
+        }
+
+        stats->winners(result.winner);
+        simulator->reportItem(result);
+    }
+}
+
+} // namespace
+
+AuctionSimulator::AuctionSimulator(const AuctionConfig &config) : config(config) {}
+
+const AuctionResults &AuctionSimulator::run()
+{
+    this->results = AuctionResults();
+    this->statistics = make_shared<ModelStatistics>();
+
+    simulator = this;
+    ::config = this->config;
+    stats = this->statistics.get();
+    itemsStarted = 0;
+
+    RandomSeed(this->config.seed);
+
+    // Every run trains the policy of the learning bidders from scratch
+    policy = LearningPolicy();
+
+    // Latency distributions of the classes and the classes of the strategies
+    if (this->config.latency)
+    {
+        for (int connection = BROADBAND; connection <= DATACENTER; connection++)
+        {
+            latencies[connection] = LatencyDistribution(LATENCY_BINS[connection]);
+        }
+        for (int strategy = AGENT; strategy <= LEARNER; strategy++)
+        {
+            connectionTables[strategy] = AliasTable(vector<double>(CONNECTION_MIX[strategy], CONNECTION_MIX[strategy] + 3));
+        }
+    }
+
+    if (this->config.servers > 0)
+    {
+        this->statistics->backend.SetCapacity(this->config.servers);
+    }
+
+    // Persistent bidders keep their strategy and connection for the whole run, the mix follows the reference paper
+    population.reset(max(this->config.population, 0));
+    for (int i = 0; i < this->config.population; i++)
+    {
+        int32_t id = population.add(drawStrategy(), (int32_t)Exponential(INITIAL_RATING_MEAN));
+        if (this->config.latency)
+        {
+            population.connect(id, drawConnection(population.type(id)));
+        }
+    }
+
+    // Buy-It-Now and proxy bidding apply to single-unit items, sealed-bid items always sell a single unit
+    ::config.units = max(::config.units, 1);
+    if (::config.units > 1)
+    {
+        ::config.buyItNow = 0;
+        ::config.proxyBidding = false;
+    }
+    if (this->config.format == FIRST_PRICE || this->config.format == SECOND_PRICE)
+    {
+        ::config.units = 1;
+    }
+
+    // Sealed-bid items are resolved directly, without the simulation processes
+    if (this->config.format == FIRST_PRICE || this->config.format == SECOND_PRICE)
+    {
+        runSealedItems();
+    }
+    else
+    {
+        // The simulation time
+        if (this->config.softClose > 0)
+        {
+            Init(0, SIMLIB_MAXTIME); // Extensions make the duration of the items unknown
+        }
+        else
+        {
+            Init(0, (this->config.singleItemDuration + 30) * this->config.numberOfItems); // Single item duration + 30 seconds between items
+        }
+
+        // Run the simulation
+        (new Auction)->Activate();
+        if (this->config.pacing > 0)
+        {
+            (new PacingClock)->Activate();
+        }
+        Run();
+    }
+
+    if (this->config.learners > 0)
+    {
+        this->results.policy = policy.parameters();
+    }
+    this->results.bidders.reserve(population.size());
+    for (size_t id = 0; id < population.size(); id++)
+    {
+        this->results.bidders.push_back(population.record(id));
+    }
+
+    simulator = nullptr;
+    stats = nullptr;
+    return this->results;
+}
+
+void AuctionSimulator::writeStats(const char *fileName) const
+{
+    if (!this->statistics)
+    {
+        return;
+    }
+    SetOutput(fileName);
+    this->statistics->biddingFacility.Output();
+    this->statistics->winners.Output();
+    this->statistics->runningAuction.Output();
+    if (this->config.servers > 0)
+    {
+        this->statistics->backend.Output();
+        this->statistics->backendWait.Output();
+    }
+}
+
+void AuctionSimulator::reportItem(const ItemResult &item)
+{
+    this->results.items.push_back(item);
+    this->results.winnerStats[item.winner + 1]++;
+    if (this->itemCallback)
+    {
+        this->itemCallback(item);
+    }
+}
+
+void AuctionSimulator::reportBid(const BidEvent &bid)
+{
+    if (this->config.recordBids)
+    {
+        this->results.bids.push_back(bid);
+    }
+    if (this->bidCallback)
+    {
+        this->bidCallback(bid);
+    }
+}
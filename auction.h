@@ -0,0 +1,317 @@
+/**
+ * @file auction.h
+ * @brief Public interface of the auction simulation library (libauction)
+ * The simulator runs the auction model for a configured number of items and returns structured results.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef AUCTION_H
+#define AUCTION_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "histogram.h"
+
+/**
+ * @brief Bidding strategy of a bidder, NONE marks an item without a winner.
+ */
+enum BidderType
+{
+    AGENT,
+    RATCHET,
+    SNIPER,
+    LEARNER, // Adaptive bidder, its shading and entry time follow a policy trained over the items
+    NONE = -1
+};
+
+/**
+ * @brief Network connection of a bidder, the latency of its bid submissions follows the class.
+ */
+enum LatencyClass
+{
+    BROADBAND,  // Residential broadband
+    MOBILE,     // Mobile network
+    DATACENTER, // Sniping service placing the bids from a datacenter
+};
+
+/**
+ * @brief Distribution of the service time of a bid in the bid backend.
+ */
+enum ServiceDistribution
+{
+    EXPONENTIAL_SERVICE,   // Exponential, coefficient of variation 1
+    DETERMINISTIC_SERVICE, // Constant
+    LOGNORMAL_SERVICE,     // Lognormal with coefficient of variation 2, occasional long stalls
+};
+
+/**
+ * @brief Format of the auction.
+ */
+enum AuctionFormat
+{
+    ENGLISH,      // Open ascending auction with the simulated bidder processes
+    FIRST_PRICE,  // Sealed-bid auction, the winner pays the own bid
+    SECOND_PRICE, // Sealed-bid (Vickrey) auction, the winner pays the second highest bid
+    DUTCH,        // Descending clock auction, the first bidders accepting the clock price win
+};
+
+/**
+ * @brief Price paid by the winners of a multi-unit item.
+ */
+enum PricingRule
+{
+    UNIFORM,        // Every winner pays the lowest accepted bid
+    DISCRIMINATORY, // Every winner pays the own bid
+};
+
+/**
+ * @brief The way an auction item ended.
+ */
+enum ItemEnding
+{
+    SOLD,            // Sold to the highest bidder at the end of the auction
+    NO_BIDS,         // Discarded, no bid was placed
+    RESERVE_NOT_MET, // Not sold, the price did not reach the reserve price
+    BOUGHT_NOW,      // Sold early for the Buy-It-Now price
+};
+
+/**
+ * @struct AuctionConfig
+ * @brief Parameters of a simulation run, defaults follow the reference paper.
+ */
+struct AuctionConfig
+{
+    int numberOfItems = 3460;                          // Number of auction items
+    double numberOfBidders = 70;                       // Number of potential bidders for each item
+    int singleItemDuration = 60;                       // Duration of a single auction item
+    double auctionItemTimeout = 30;                    // Timeout for the first bid
+    long seed = 1;                                     // Seed of the random number generator
+    bool verbose = false;                              // Print the progress of the auction to stdout
+    bool recordBids = true;                            // Store every bid in AuctionResults::bids
+    bool proxyBidding = false;                         // Bidders submit maximums resolved by the eBay increment table
+    bool floatPrices = false;                          // Open single-unit auctions without proxy bids, Buy-It-Now or reserve keep the unrounded prices the cents replaced
+    double softClose = 0;                              // A bid in the last softClose seconds extends the end by softClose seconds, 0 disables
+    AuctionFormat format = ENGLISH;                    // Format of the auction
+    double buyItNow = 0;                               // Buy-It-Now price relative to the real price of the item, 0 disables
+    double reservePrice = 0;                           // Reserve price relative to the real price of the item, 0 disables
+    int units = 1;                                     // Identical units of every item, more than one makes the open auction multi-unit
+    PricingRule pricing = UNIFORM;                     // Price paid by the winners of a multi-unit or Dutch item
+    int population = 0;                                // Persistent bidders sampled for every item, 0 draws new bidders for every item
+    double learners = 0;                               // Share of learning bidders, the rest follows the strategy mix
+    double mix[3] = {0.4, 0.25, 0.35};                 // Shares of the agent, ratchet and sniper strategies, the reference paper's mix
+    bool latency = false;                              // Bids travel over the sampled latency of the bidder's class instead of fixed delays
+    int servers = 0;                                   // Servers of the bid backend, 0 keeps the polled single bidding facility
+    double serviceTime = 0.02;                         // Mean service time of a bid in the bid backend
+    ServiceDistribution service = EXPONENTIAL_SERVICE; // Distribution of the service time
+    int queueCapacity = 100;                           // Bids waiting in the bid backend, a bid arriving at a full queue is rejected
+    double pacing = 0;                                 // Simulated seconds per second of the wall clock, 0 runs as fast as possible, sealed-bid formats are never paced
+    double pacingTick = 0.001;                         // Wall-clock seconds between two pacing points of a paced run
+    double pacingSpin = 0.0001;                        // Busy-waited end of every pacing sleep in seconds, absorbs the timer wake-up
+};
+
+/**
+ * @struct ItemResult
+ * @brief Outcome of a single auction item.
+ */
+struct ItemResult
+{
+    int32_t itemNumber;  // Unique identifier of the item
+    int32_t winner;      // BidderType of the winner, NONE if the item was not sold
+    int32_t bids;        // Number of placed bids
+    int32_t agents;      // Number of generated agent bidders
+    int32_t ratchets;    // Number of generated ratchet bidders
+    int32_t snipers;     // Number of generated sniping bidders
+    int32_t learners;    // Number of generated learning bidders
+    int32_t extensions;  // Number of soft close extensions of the end time
+    int32_t reschedules; // Number of end-relative waits repeated because of an extension
+    int32_t ending;      // ItemEnding, the way the item ended
+    int32_t cancelled;   // Number of processes of the item cancelled when it ended
+    int32_t units;       // Number of offered units
+    int32_t unitsSold;   // Number of sold units
+    int32_t unitsWon[5]; // Units won by each strategy (None counts the unsold units, Agent, Ratchet, Sniper, Learner)
+    int32_t winnerId;    // Population identifier of the (highest) winner, the marketplace bidder index in a marketplace, -1 if not sold or without persistent bidders
+    int32_t returning;   // Bidders of the item who entered an earlier item
+    double realPrice;    // Real value of the item (of a single unit)
+    double startPrice;   // Starting price of the auction
+    double finalPrice;   // Price of the last bid (starting price if there was no bid), the lowest winning bid of a multi-unit item
+    double endTime;      // Simulation time at which the item ended
+    double revenue;      // Total price paid for the sold units
+};
+
+/**
+ * @struct BidEvent
+ * @brief A single bid placed in the auction.
+ */
+struct BidEvent
+{
+    int32_t itemNumber; // Item the bid was placed on
+    int32_t bidder;     // BidderType of the bidder
+    uint64_t bidderId;  // Population identifier of the bidder, without a population the identifier of the bidder
+                        // process (index of the bidder in sealed-bid formats)
+    double time;        // Simulation time of the bid
+    double itemTime;    // Time since the start of the auction for the item
+    double amount;      // New price of the item, the placed bid in multi-unit and Dutch auctions
+};
+
+/**
+ * @struct BidderRecord
+ * @brief History of a persistent bidder over the whole run.
+ */
+struct BidderRecord
+{
+    int32_t id;         // Population identifier
+    int32_t type;       // BidderType
+    int32_t items;      // Items the bidder entered, the lost ones are items - wins
+    int32_t wins;       // Items (units) the bidder won
+    int32_t bids;       // Placed bids
+    int32_t rating;     // Feedback rating (eBay bidderrate), every won item adds a point
+    int32_t connection; // LatencyClass of the bidder, -1 without the latency model
+};
+
+/**
+ * @struct LatencyStats
+ * @brief Bids of the bidders of a latency class.
+ */
+struct LatencyStats
+{
+    int64_t bidders = 0;   // Bidders of the class
+    int64_t submitted = 0; // Bids sent over the network
+    int64_t bids = 0;      // Bids placed on the item
+    int64_t late = 0;      // Sent bids that reached the item after its end
+    int64_t wins = 0;      // Won units
+    double delay = 0;      // Total latency of the sent bids
+};
+
+/**
+ * @struct PacingStats
+ * @brief Coupling of the simulation time to the wall clock in a paced run.
+ *
+ * @details
+ * The pacing clock stops the simulation at every tick until the wall clock reaches the simulated time of the tick.
+ * A tick reached after its wall-clock time is late, the simulation lags behind by the difference; otherwise the
+ * pacing clock sleeps and its wake-up error is the jitter.
+ */
+struct PacingStats
+{
+    int64_t ticks = 0;       // Pacing points reached
+    int64_t late = 0;        // Pacing points reached after their wall-clock time
+    double seconds = 0;      // Wall-clock time of the run
+    LatencyHistogram lag;    // Delay of the late pacing points behind the wall clock, in nanoseconds
+    LatencyHistogram jitter; // Wake-up error of the pacing points the clock slept for, in nanoseconds
+};
+
+/**
+ * @struct BackendSecond
+ * @brief Load of the bid backend in one second of auction time (time since the start of the item), over all items.
+ */
+struct BackendSecond
+{
+    int64_t arrivals = 0; // Bids arriving at the backend
+    int64_t rejected = 0; // Bids rejected by the full queue
+    int64_t served = 0;   // Bids served
+    int64_t expired = 0;  // Served bids the item no longer accepted, it ended while they were in the backend
+    double wait = 0;      // Total queue wait of the served bids
+    double maxWait = 0;   // Longest queue wait
+    double busy = 0;      // Server-seconds spent serving bids
+    int32_t maxQueue = 0; // Longest queue met by an arriving bid
+    int32_t items = 0;    // Items running in the second
+};
+
+/**
+ * @struct AuctionResults
+ * @brief Results of a simulation run.
+ */
+struct AuctionResults
+{
+    std::vector<ItemResult> items;      // Outcome of every item, in auction order
+    std::vector<BidEvent> bids;         // Every bid, if AuctionConfig::recordBids is set
+    std::vector<BidderRecord> bidders;  // Persistent bidders in identifier order, if AuctionConfig::population is set
+    std::vector<double> policy;         // Policy of the learning bidders after the run (shading and timing weights, baseline)
+    int winnerStats[5] = {0};           // Items won by None (unsold or discarded), Agent, Ratchet, Sniper, Learner
+    double surplus[5] = {0};            // Surplus (valuation - price) of the won units of each strategy, None unused
+    LatencyStats latency[3];            // Bids of each LatencyClass, if AuctionConfig::latency is set
+    std::vector<BackendSecond> backend; // Load of the bid backend per second of auction time, if AuctionConfig::servers is set
+    PacingStats pacing;                 // Lag and jitter of a paced run, if AuctionConfig::pacing is set
+};
+
+typedef std::function<void(const ItemResult &)> ItemCallback;
+typedef std::function<void(const BidEvent &)> BidCallback;
+
+struct ModelStatistics;
+
+/**
+ * @class AuctionSimulator
+ * @brief Runs the auction model with a given configuration.
+ *
+ * @note SIMLIB keeps a single process-wide calendar, only one simulator can run at a time.
+ */
+class AuctionSimulator
+{
+private:
+    AuctionConfig config;
+    AuctionResults results;
+    ItemCallback itemCallback;
+    BidCallback bidCallback;
+    std::shared_ptr<ModelStatistics> statistics; // SIMLIB statistics of the last run
+
+public:
+    /**
+     * @brief Constructs a simulator for the given configuration.
+     * @param config Parameters of the simulation.
+     */
+    explicit AuctionSimulator(const AuctionConfig &config);
+
+    /**
+     * @brief Sets a callback invoked after every finished (sold or discarded) item.
+     * @param callback Function receiving the item result.
+     */
+    void onItem(ItemCallback callback) { this->itemCallback = std::move(callback); }
+
+    /**
+     * @brief Sets a callback invoked after every placed bid.
+     * @param callback Function receiving the bid.
+     */
+    void onBid(BidCallback callback) { this->bidCallback = std::move(callback); }
+
+    /**
+     * @brief Runs the simulation, results of a previous run are discarded.
+     * @return Results of the simulation.
+     */
+    const AuctionResults &run();
+
+    /**
+     * @brief Writes the SIMLIB statistics of the last run (facilities and winners histogram).
+     * @param fileName Name of the output file.
+     */
+    void writeStats(const char *fileName) const;
+
+    const AuctionConfig &getConfig() const { return this->config; }
+    const AuctionResults &getResults() const { return this->results; }
+
+    /**
+     * @brief Moves the results of the last run out of the simulator.
+     * @return Results of the simulation.
+     */
+    AuctionResults releaseResults() { return std::move(this->results); }
+
+    // Used by the model processes to report progress
+    void reportItem(const ItemResult &item);
+    void reportBid(const BidEvent &bid);
+    void reportSurplus(int type, double surplus) { this->results.surplus[type + 1] += surplus; }
+    LatencyStats &latencyStats(int connection) { return this->results.latency[connection]; }
+    PacingStats &pacingStats() { return this->results.pacing; }
+    BackendSecond &backendSecond(double itemTime)
+    {
+        size_t second = itemTime;
+        if (second >= this->results.backend.size())
+        {
+            this->results.backend.resize(second + 1);
+        }
+        return this->results.backend[second];
+    }
+};
+
+#endif // AUCTION_H
@@ -0,0 +1,113 @@
+/**
+ * @file bidbook.cpp
+ * @brief Benchmark of the bid book of multi-unit items
+ * Checks the k-th highest bid against a sorted copy of the bids and measures the cost of placing a bid
+ * (a replacement of the standing bid of the bidder) in books of growing size.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+#include "../bidbook.h"
+
+using namespace std;
+
+const int CHECK_BIDS = 20000; // Bids of the consistency check
+const int UNITS = 10;         // Units of the benchmarked item
+const int PLACED = 1 << 20;   // Bids placed in every measured book
+
+/**
+ * @brief Places random bids and compares the k-th highest and the highest bid with a sorted copy.
+ *
+ * @return true if the book matches the sorted bids after every placement
+ */
+bool checkBook(mt19937_64 &generator)
+{
+    const int bidders = 500;
+    uniform_int_distribution<Cents> amount(100, 100000);
+    uniform_int_distribution<int> pick(0, bidders - 1);
+
+    BidBook book(UNITS);
+    vector<BookBid *> slots;
+    vector<Cents> standing(bidders, -1);
+    for (int i = 0; i < bidders; i++)
+    {
+        slots.push_back(book.add(i % 3));
+    }
+
+    for (int i = 0; i < CHECK_BIDS; i++)
+    {
+        int bidder = pick(generator);
+        if (i % 7 == 0)
+        {
+            book.remove(slots[bidder]);
+            standing[bidder] = -1;
+        }
+        else
+        {
+            standing[bidder] = amount(generator);
+            book.place(slots[bidder], standing[bidder]);
+        }
+
+        vector<Cents> sorted;
+        for (Cents bid : standing)
+        {
+            if (bid >= 0)
+            {
+                sorted.push_back(bid);
+            }
+        }
+        sort(sorted.begin(), sorted.end(), greater<Cents>());
+
+        size_t units = min<size_t>(UNITS, sorted.size());
+        if (book.size() != sorted.size() || book.full() != (sorted.size() >= (size_t)UNITS) ||
+            (units > 0 && (book.kth()->amount != sorted[units - 1] || book.best()->amount != sorted[0])))
+        {
+            printf("Bid book mismatch after %d bids\n", i + 1);
+            return false;
+        }
+    }
+    printf("Bid book matches the sorted bids after %d bids\n", CHECK_BIDS);
+    return true;
+}
+
+int main()
+{
+    mt19937_64 generator(1);
+    bool matches = checkBook(generator);
+
+    for (int bidders = 1000; bidders <= 1000000; bidders *= 10)
+    {
+        BidBook book(UNITS);
+        vector<BookBid *> slots;
+        for (int i = 0; i < bidders; i++)
+        {
+            slots.push_back(book.add(i % 3));
+        }
+
+        // Ascending bids of random bidders, like in an open auction
+        uniform_int_distribution<int> pick(0, bidders - 1);
+        vector<int> order(PLACED);
+        for (int &bidder : order)
+        {
+            bidder = pick(generator);
+        }
+
+        Cents price = 0;
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < PLACED; i++)
+        {
+            book.place(slots[order[i]], i);
+            price += book.kth()->amount;
+        }
+        chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+        printf("%7d bidders: %.1f ns per placed bid (checksum %lld)\n", bidders, elapsed.count() / PLACED, (long long)(price % 1000));
+    }
+    return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file currency.cpp
+ * @brief Benchmark of the fixed-point currency arithmetic
+ * Checks that cent prices follow the floating point model within rounding and compares the speed
+ * of the comparison-heavy bidding paths (batch comparison of prices against valuations).
+ * The model is run item by item on the same seeds with the cent prices and with the unrounded floating point prices
+ * they replaced (AuctionConfig::floatPrices). A whole run is not compared at once: the first bid decision that falls
+ * on the other side of a cent in the two models changes the random numbers drawn after it, so every later item would
+ * differ.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../auction.h"
+#include "../currency.h"
+
+using namespace std;
+
+const int ITEMS = 10000;             // Items of the rounding check
+const int BIDS_PER_ITEM = 200;       // Ratchet steps of every item
+const int VALUATIONS = 1 << 20;      // Size of the valuation array
+const int REPEATS = 200;             // Passes over the valuation array
+const int RUNS = 2000;               // Seeded single-item runs of the model in both representations
+const double DIVERGED_SHARE = 0.1;   // Share of the runs allowed to take another decision at a cent boundary
+
+/**
+ * @brief Runs the increment sequence of every item in both representations.
+ * A single step must agree within one cent (rounding or the one cent minimum increment), the whole
+ * sequence within the rounding accumulated over all steps.
+ *
+ * @return true if the representations match within rounding
+ */
+bool checkRounding(mt19937_64 &generator)
+{
+    exponential_distribution<double> realPrice(1.0 / 1000);
+    double maxStepError = 0;
+    double maxErrorToBound = 0;
+    for (int item = 0; item < ITEMS; item++)
+    {
+        double price = round(realPrice(generator) * 100) / 100;
+        Cents cents = toCents(price);
+        double bound = 0; // Rounding accumulated so far, grows with the price
+        for (int bid = 0; bid < BIDS_PER_ITEM; bid++)
+        {
+            double expected = toAmount(cents) + toAmount(cents) * 0.01;
+            price += price * 0.01;
+            cents += percentOf(cents, 1);
+            bound = bound * 1.01 + 0.01;
+            maxStepError = max(maxStepError, fabs(expected - toAmount(cents)));
+        }
+        maxErrorToBound = max(maxErrorToBound, fabs(price - toAmount(cents)) / bound);
+    }
+    printf("Rounding: max single step error %.4f, max error after %d bids %.1f%% of the rounding bound\n", maxStepError, BIDS_PER_ITEM, maxErrorToBound * 100);
+    return maxStepError <= 0.01 + 1e-9 && maxErrorToBound <= 1.0;
+}
+
+/**
+ * @brief Runs single items of the open auction on the same seeds with cent and with floating point prices.
+ * An item whose bids came at the same times from the same strategies in both runs took the same decisions, so its
+ * winner must match and every price must agree within the rounding accumulated over the bids before it (half a cent
+ * of the starting price, then at most a cent per bid on top of the 1 % growth). A bidder whose valuation lies within
+ * that rounding of the next price may decide the other way, the item then diverges and is only counted.
+ *
+ * @return true if every item with the same bids matches within rounding and few items diverged
+ */
+bool checkRuns()
+{
+    AuctionConfig config;
+    config.numberOfItems = 1;
+    int diverged = 0;
+    int mismatched = 0;
+    double maxErrorToBound = 0;
+    for (int run = 0; run < RUNS; run++)
+    {
+        config.seed = run + 1;
+        config.floatPrices = false;
+        AuctionResults cents = AuctionSimulator(config).run();
+        config.floatPrices = true;
+        AuctionResults floats = AuctionSimulator(config).run();
+
+        bool same = cents.bids.size() == floats.bids.size();
+        for (size_t bid = 0; same && bid < cents.bids.size(); bid++)
+        {
+            same = cents.bids[bid].time == floats.bids[bid].time && cents.bids[bid].bidder == floats.bids[bid].bidder;
+        }
+        if (!same)
+        {
+            diverged++;
+            continue;
+        }
+
+        double bound = 0.005;
+        double error = fabs(cents.items[0].startPrice - floats.items[0].startPrice) / bound;
+        for (size_t bid = 0; bid < cents.bids.size(); bid++)
+        {
+            bound = bound * 1.01 + 0.01;
+            error = max(error, fabs(cents.bids[bid].amount - floats.bids[bid].amount) / bound);
+        }
+        error = max(error, fabs(cents.items[0].finalPrice - floats.items[0].finalPrice) / bound);
+        maxErrorToBound = max(maxErrorToBound, error);
+        mismatched += cents.items[0].winner != floats.items[0].winner || error > 1.0;
+    }
+    printf("Model runs: %d items, %d diverged at a cent boundary, %d of the others outside the rounding bound (max %.1f%% of it)\n",
+           RUNS, diverged, mismatched, maxErrorToBound * 100);
+    return mismatched == 0 && diverged <= RUNS * DIVERGED_SHARE;
+}
+
+/**
+ * @brief Measures the time of a function in nanoseconds per compared valuation.
+ */
+template <typename F>
+double measure(F function, long &result)
+{
+    auto start = chrono::steady_clock::now();
+    for (int repeat = 0; repeat < REPEATS; repeat++)
+    {
+        result += function(repeat);
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / ((double)REPEATS * VALUATIONS);
+}
+
+int main()
+{
+    mt19937_64 generator(1);
+    bool matches = checkRounding(generator);
+    matches &= checkRuns();
+
+    // Valuations of the bidders and the prices they are compared against
+    normal_distribution<double> valuation(1200, 300);
+    vector<double> doubleValuations(VALUATIONS);
+    vector<Cents> centValuations(VALUATIONS);
+    for (int i = 0; i < VALUATIONS; i++)
+    {
+        doubleValuations[i] = round(valuation(generator) * 100) / 100;
+        centValuations[i] = toCents(doubleValuations[i]);
+    }
+
+    long doubleCount = 0;
+    long centCount = 0;
+    double doubleTime = measure([&](int repeat)
+                                {
+        double price = 1000 + repeat;
+        double increment = price * 0.01;
+        long count = 0;
+        for (double v : doubleValuations)
+        {
+            count += (price + increment) <= v;
+        }
+        return count; },
+                                doubleCount);
+    double centTime = measure([&](int repeat)
+                              {
+        Cents price = toCents(1000 + repeat);
+        Cents increment = percentOf(price, 1);
+        long count = 0;
+        for (Cents v : centValuations)
+        {
+            count += (price + increment) <= v;
+        }
+        return count; },
+                              centCount);
+
+    printf("Comparisons: double %.3f ns, cents %.3f ns per valuation (%.2fx)\n", doubleTime, centTime, doubleTime / centTime);
+    printf("Bidders willing to bid: double %ld, cents %ld\n", doubleCount, centCount);
+    return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+}
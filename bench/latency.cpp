@@ -0,0 +1,133 @@
+/**
+ * @file latency.cpp
+ * @brief Benchmark of the latency sampling of the bidders
+ * Checks the frequencies drawn from the alias tables against their weights and compares the cost of a sample with
+ * a binary search in the cumulative distribution, for the latency classes and for histograms with many bins.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <vector>
+#include "../latency.h"
+
+using namespace std;
+
+const int CHECK_SAMPLES = 1 << 22; // Samples of the frequency check
+const int SAMPLES = 1 << 24;       // Samples of every measurement
+
+/**
+ * @brief Draws from an alias table and compares the frequencies with the weights.
+ *
+ * @return true if no frequency differs from its probability by more than five standard deviations
+ */
+bool checkTable(const vector<double> &weights, mt19937_64 &generator)
+{
+    uniform_real_distribution<double> uniform(0, 1);
+    AliasTable table(weights);
+    vector<int> counts(weights.size(), 0);
+    for (int i = 0; i < CHECK_SAMPLES; i++)
+    {
+        counts[table.pick(uniform(generator))]++;
+    }
+
+    double total = 0;
+    for (double weight : weights)
+    {
+        total += weight;
+    }
+    for (size_t i = 0; i < weights.size(); i++)
+    {
+        double probability = weights[i] / total;
+        double deviation = sqrt(CHECK_SAMPLES * probability * (1 - probability));
+        if (fabs(counts[i] - CHECK_SAMPLES * probability) > 5 * deviation + 1)
+        {
+            printf("Alias table mismatch: outcome %zu drawn %d times, expected %.0f\n", i, counts[i], CHECK_SAMPLES * probability);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Measures the nanoseconds per sample of the alias table and of the binary search in the cumulative weights.
+ */
+void measure(const vector<double> &weights, const char *label, mt19937_64 &generator)
+{
+    uniform_real_distribution<double> uniform(0, 1);
+    vector<double> draws(SAMPLES);
+    for (double &draw : draws)
+    {
+        draw = uniform(generator);
+    }
+
+    AliasTable table(weights);
+    vector<double> cumulative(weights.size());
+    partial_sum(weights.begin(), weights.end(), cumulative.begin());
+    for (double &value : cumulative)
+    {
+        value /= cumulative.back();
+    }
+
+    long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (double draw : draws)
+    {
+        checksum += table.pick(draw);
+    }
+    chrono::duration<double, nano> alias = chrono::steady_clock::now() - start;
+
+    start = chrono::steady_clock::now();
+    for (double draw : draws)
+    {
+        checksum += min<size_t>(upper_bound(cumulative.begin(), cumulative.end(), draw) - cumulative.begin(), weights.size() - 1);
+    }
+    chrono::duration<double, nano> search = chrono::steady_clock::now() - start;
+    printf("%-22s: alias table %.2f ns, binary search %.2f ns per sample (checksum %ld)\n", label,
+           alias.count() / SAMPLES, search.count() / SAMPLES, checksum % 1000);
+}
+
+int main()
+{
+    mt19937_64 generator(1);
+    bool matches = true;
+    const char *names[3] = {"broadband", "mobile", "datacenter"};
+    for (int connection = 0; connection < 3; connection++)
+    {
+        vector<double> weights;
+        for (const LatencyBin &bin : LATENCY_BINS[connection])
+        {
+            weights.push_back(bin.weight);
+        }
+        matches = checkTable(weights, generator) && matches;
+        LatencyDistribution distribution(LATENCY_BINS[connection]);
+        printf("Latency %-10s: mean %.1f ms\n", names[connection], 1000 * distribution.mean());
+        measure(weights, names[connection], generator);
+    }
+
+    // Fine histograms, e.g. measured latencies in 1 ms bins, are where the alias table pays off
+    for (int bins = 64; bins <= 65536; bins *= 32)
+    {
+        vector<double> weights(bins);
+        lognormal_distribution<double> shape(0, 1);
+        for (double &weight : weights)
+        {
+            weight = shape(generator);
+        }
+        matches = checkTable(weights, generator) && matches;
+        char label[32];
+        snprintf(label, sizeof(label), "%d bins", bins);
+        measure(weights, label, generator);
+    }
+    if (matches)
+    {
+        printf("Alias tables match their weights\n");
+    }
+    return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+}
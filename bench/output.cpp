@@ -0,0 +1,201 @@
+/**
+ * @file output.cpp
+ * @brief Benchmark of the output backends
+ * Writes the bid log of a million bids, as logSingleBid() formats it, through stdio opening the file for every bid
+ * (the path of model.cpp before the output backend), through one stdio stream, and through an OutputFile by pwrite
+ * and by io_uring, then commits write-ahead log records in groups with a sync after each group by pwrite and
+ * fdatasync and by io_uring. Reports the throughput and the system calls per million bids, counted by tracing the
+ * run in a child process with ptrace, and checks that every backend wrote the same bytes.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../output.h"
+
+using namespace std;
+
+const int BIDS = 1000000;         // Bids of the bid log
+const int OPENED_BIDS = 100000;   // Bids of the stdio path opening the file for every bid, scaled to a million
+const int RECORDS = 100000;       // Records of the write-ahead log, scaled to a million
+const int GROUP = 64;             // Records of a group commit
+const size_t RECORD_SIZE = 48;    // Bytes of a record of the write-ahead log
+
+/**
+ * @brief Counts the system calls of a piece of work by running it in a traced child process.
+ * @return System calls of the work, -1 if the child could not be traced
+ */
+long countSyscalls(const function<void()> &work)
+{
+    pid_t child = fork();
+    if (child == 0)
+    {
+        ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+        raise(SIGSTOP);
+        work();
+        _exit(EXIT_SUCCESS);
+    }
+    int status;
+    waitpid(child, &status, 0);
+    if (!WIFSTOPPED(status) || ptrace(PTRACE_SETOPTIONS, child, nullptr, (void *)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL)) != 0)
+    {
+        kill(child, SIGKILL);
+        waitpid(child, &status, 0);
+        return -1;
+    }
+    // Every system call stops the child on its entry and on its exit, _exit itself only enters
+    long stops = 0;
+    while (ptrace(PTRACE_SYSCALL, child, nullptr, nullptr) == 0 && waitpid(child, &status, 0) == child && !WIFEXITED(status))
+    {
+        stops += WIFSTOPPED(status) && WSTOPSIG(status) == (SIGTRAP | 0x80);
+    }
+    return (stops + 1) / 2 - 1;
+}
+
+/**
+ * @brief Runs a piece of work and measures it.
+ * @param name Name of the path.
+ * @param count Bids or records of the work.
+ * @param work The work.
+ */
+void measure(const char *name, int count, const function<void()> &work)
+{
+    auto start = chrono::steady_clock::now();
+    work();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    long syscalls = countSyscalls(work);
+    double scale = 1e6 / count;
+    printf("%-24s %12.0f %12.1f %14.0f\n", name, count / elapsed.count(), elapsed.count() * scale,
+           syscalls < 0 ? -1.0 : syscalls * scale);
+}
+
+/**
+ * @brief Reads a whole file.
+ */
+string readFile(const char *path)
+{
+    ifstream file(path, ios::binary);
+    stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+/**
+ * @brief Item, simulated time and amount of a bid, the fields of the bid log.
+ */
+void bidFields(int i, int &item, double &time, double &amount)
+{
+    item = i / 100;
+    time = (i % 100) * 12.5;
+    amount = 10 + (i % 1000) * 0.37;
+}
+
+int main()
+{
+    const char *stdioPath = "output-bench-stdio.csv";
+    const char *openedPath = "output-bench-opened.csv";
+    const char *pwritePath = "output-bench-pwrite.csv";
+    const char *uringPath = "output-bench-uring.csv";
+    const char *walPath = "output-bench.wal";
+
+    OutputFile probe;
+    bool uring = probe.open(uringPath, false, OUTPUT_URING);
+    probe.close();
+    printf("%d bids in the bid log, %d records of the write-ahead log in groups of %d, io_uring %s\n", BIDS, RECORDS, GROUP,
+           uring ? "available" : "unavailable");
+    printf("%-24s %12s %12s %14s\n", "", "per second", "s per M", "syscalls per M");
+
+    measure("stdio, open per bid", OPENED_BIDS, [&]
+            {
+                unlink(openedPath);
+                for (int i = 0; i < OPENED_BIDS; i++)
+                {
+                    int item;
+                    double time, amount;
+                    bidFields(i, item, time, amount);
+                    FILE *file = fopen(openedPath, "a");
+                    fprintf(file, "%d,%.1f,%.2f\n", item, time, amount);
+                    fclose(file);
+                }
+            });
+    measure("stdio stream", BIDS, [&]
+            {
+                FILE *file = fopen(stdioPath, "w");
+                for (int i = 0; i < BIDS; i++)
+                {
+                    int item;
+                    double time, amount;
+                    bidFields(i, item, time, amount);
+                    fprintf(file, "%d,%.1f,%.2f\n", item, time, amount);
+                }
+                fclose(file);
+            });
+    const char *paths[] = {pwritePath, uringPath};
+    const OutputBackend backends[] = {OUTPUT_PWRITE, OUTPUT_URING};
+    const char *names[] = {"OutputFile, pwrite", "OutputFile, io_uring"};
+    for (int backend = 0; backend < (uring ? 2 : 1); backend++)
+    {
+        measure(names[backend], BIDS, [&]
+                {
+                    OutputFile file;
+                    file.open(paths[backend], false, backends[backend]);
+                    for (int i = 0; i < BIDS; i++)
+                    {
+                        int item;
+                        double time, amount;
+                        bidFields(i, item, time, amount);
+                        file.print("%d,%.1f,%.2f\n", item, time, amount);
+                    }
+                    file.close();
+                });
+    }
+
+    // A group of records is written and synced before the next one, as the write-ahead log commits a group
+    char record[RECORD_SIZE];
+    memset(record, 'r', sizeof(record));
+    const char *walNames[] = {"group commit, pwrite", "group commit, io_uring"};
+    for (int backend = 0; backend < (uring ? 2 : 1); backend++)
+    {
+        measure(walNames[backend], RECORDS, [&]
+                {
+                    OutputFile file;
+                    file.open(walPath, false, backends[backend]);
+                    for (int i = 0; i < RECORDS; i++)
+                    {
+                        file.write(record, sizeof(record));
+                        if ((i + 1) % GROUP == 0)
+                        {
+                            file.sync();
+                        }
+                    }
+                    file.close();
+                });
+    }
+
+    // The bids of the opening path are the first bids of the others
+    string expected = readFile(stdioPath);
+    string opened = readFile(openedPath);
+    bool valid = readFile(pwritePath) == expected && (!uring || readFile(uringPath) == expected) &&
+                 expected.compare(0, opened.size(), opened) == 0 && readFile(walPath).size() == RECORDS * RECORD_SIZE;
+    for (const char *path : {stdioPath, openedPath, pwritePath, uringPath, walPath})
+    {
+        unlink(path);
+    }
+    if (!valid)
+    {
+        fprintf(stderr, "The backends wrote different bytes\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
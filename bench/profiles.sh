@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Builds the model in every build profile and reports the wall time and speedup
+# of each profile against the unoptimized debug build
+#
+# Usage: bench/profiles.sh [runs per scenario]
+# Extra make variables (e.g. CPPFLAGS, LDFLAGS) are taken from the environment
+
+RUNS=${1:-3}
+SCENARIOS=("-i 3460 -b 70" "-i 100 -b 1000")
+PROFILES=(debug release lto pgo)
+
+cd "$(dirname "$0")/.." || exit 1
+
+make -s all release lto pgo > /dev/null || exit 1
+
+binary()
+{
+    if [ "$1" = "debug" ]; then echo ./model; else echo "./model-$1"; fi
+}
+
+for scenario in "${SCENARIOS[@]}"
+do
+    echo "Scenario: $scenario ($RUNS runs)"
+    printf "%-10s %12s %10s\n" "Profile" "Time [s]" "Speedup"
+    base=""
+    for profile in "${PROFILES[@]}"
+    do
+        start=$(date +%s.%N)
+        for ((run = 0; run < RUNS; run++))
+        do
+            $(binary "$profile") $scenario > /dev/null || exit 1
+        done
+        end=$(date +%s.%N)
+        elapsed=$(awk "BEGIN { print ($end - $start) / $RUNS }")
+        if [ -z "$base" ]; then base=$elapsed; fi
+        printf "%-10s %12.3f %9.2fx\n" "$profile" "$elapsed" "$(awk "BEGIN { print $base / $elapsed }")"
+    done
+    echo
+done
@@ -0,0 +1,287 @@
+/**
+ * @file ring.cpp
+ * @brief Benchmark of the shared-memory ring against the socket of the live engine
+ * Forks the engine serving a UNIX socket and a ring, then forks client processes submitting bids through either
+ * path, one at a time and in windows of pipelined bids. Reports the bids per second of all clients and the
+ * percentiles of the round trip from the submission of a window to the answer of each of its bids.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "../engine.h"
+#include "../pacer.h"
+
+using namespace std;
+
+const char *SOCKET = "unix:/tmp/ring-bench.sock"; // Endpoint of the socket path
+const char *RING = "/ring-bench";                 // Shared memory object of the ring
+const int AUCTIONS = 10000;                       // Live auctions
+const int BIDS = 400000;                          // Bids of a run, split among its clients
+
+/**
+ * @struct ClientResult
+ * @brief Measurement of a client process, written to shared memory.
+ */
+struct ClientResult
+{
+    LatencyHistogram latency; // Round trips in nanoseconds
+    double seconds = 0;       // Wall-clock time of the bids
+    bool failed = false;      // Flag if the client could not reach the engine
+};
+
+/**
+ * @class Bidder
+ * @brief Bids of a client, each raises a random auction above its last known price.
+ */
+class Bidder
+{
+private:
+    mt19937_64 generator;
+    vector<Cents> prices = vector<Cents>(AUCTIONS, 0);
+
+public:
+    explicit Bidder(int seed) : generator(seed) {}
+
+    RingRequest next(uint64_t bidder)
+    {
+        RingRequest request;
+        request.auction = this->generator() % AUCTIONS;
+        request.bidder = bidder;
+        Cents price = this->prices[request.auction];
+        request.amount = price > 0 ? price + percentOf(price, 1) : 1000;
+        return request;
+    }
+
+    void answered(uint32_t auction, Cents price) { this->prices[auction] = price; }
+};
+
+/**
+ * @brief Parses an answer line "ACK sequence price" or "REJ sequence reason price" for its price.
+ */
+Cents answerPrice(const string &line)
+{
+    size_t space = line.rfind(' ');
+    return space == string::npos ? 0 : toCents(strtod(line.c_str() + space + 1, nullptr));
+}
+
+/**
+ * @brief Sends bids over the socket in windows, a window is written by one send.
+ */
+void socketClient(int index, int bids, int window, ClientResult &result)
+{
+    Endpoint endpoint;
+    Endpoint::parse(SOCKET, endpoint);
+    int connection = endpoint.connect();
+    if (connection < 0)
+    {
+        result.failed = true;
+        return;
+    }
+    Bidder bidder(index + 1);
+    string requests;
+    string input;
+    vector<uint32_t> auctions(window);
+    char line[128];
+    char data[16384];
+    int64_t start = Pacer::now();
+    for (int sent = 0; sent < bids && !result.failed; sent += window)
+    {
+        int count = min(window, bids - sent);
+        requests.clear();
+        for (int i = 0; i < count; i++)
+        {
+            RingRequest request = bidder.next(index * 1000000 + i + 1);
+            auctions[i] = request.auction;
+            int length = snprintf(line, sizeof(line), "BID %u %llu %lld.%02lld %d\n", request.auction,
+                                  (unsigned long long)request.bidder, (long long)(request.amount / 100),
+                                  (long long)(request.amount % 100), sent + i);
+            requests.append(line, length);
+        }
+        int64_t submitted = Pacer::now();
+        if (send(connection, requests.data(), requests.size(), MSG_NOSIGNAL) != (ssize_t)requests.size())
+        {
+            result.failed = true;
+            break;
+        }
+        for (int answered = 0; answered < count;)
+        {
+            size_t end = input.find('\n');
+            if (end == string::npos)
+            {
+                ssize_t received = recv(connection, data, sizeof(data), 0);
+                if (received <= 0)
+                {
+                    result.failed = true;
+                    break;
+                }
+                input.append(data, received);
+                continue;
+            }
+            bidder.answered(auctions[answered], answerPrice(input.substr(0, end)));
+            input.erase(0, end + 1);
+            result.latency.record(Pacer::now() - submitted);
+            answered++;
+        }
+    }
+    result.seconds = (Pacer::now() - start) / 1e9;
+    close(connection);
+}
+
+/**
+ * @brief Submits bids through the ring in windows, the answers are awaited in order.
+ */
+void ringClient(int index, int bids, int window, ClientResult &result)
+{
+    BidRing ring;
+    int client = ring.open(RING) ? ring.join() : -1;
+    if (client < 0)
+    {
+        result.failed = true;
+        return;
+    }
+    Bidder bidder(index + 1);
+    vector<uint32_t> auctions(window);
+    uint64_t sequence = 0;
+    int64_t start = Pacer::now();
+    for (int sent = 0; sent < bids; sent += window)
+    {
+        int count = min(window, bids - sent);
+        int64_t submitted = Pacer::now();
+        for (int i = 0; i < count; i++)
+        {
+            RingRequest request = bidder.next(index * 1000000 + i + 1);
+            request.client = client;
+            request.sequence = sequence + i;
+            auctions[i] = request.auction;
+            ring.submit(request);
+        }
+        for (int i = 0; i < count; i++)
+        {
+            RingResponse response = ring.await(client, sequence + i);
+            bidder.answered(auctions[i], response.price);
+            result.latency.record(Pacer::now() - submitted);
+        }
+        sequence += count;
+    }
+    result.seconds = (Pacer::now() - start) / 1e9;
+}
+
+/**
+ * @brief Runs client processes on a path and prints a row of the results.
+ * @return false if a client could not reach the engine
+ */
+bool measure(bool useRing, int clients, int window)
+{
+    ClientResult *results = (ClientResult *)mmap(nullptr, clients * sizeof(ClientResult), PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    vector<pid_t> processes;
+    for (int i = 0; i < clients; i++)
+    {
+        new (&results[i]) ClientResult();
+        pid_t process = fork();
+        if (process == 0)
+        {
+            useRing ? ringClient(i, BIDS / clients, window, results[i]) : socketClient(i, BIDS / clients, window, results[i]);
+            _exit(EXIT_SUCCESS);
+        }
+        processes.push_back(process);
+    }
+    for (pid_t process : processes)
+    {
+        waitpid(process, nullptr, 0);
+    }
+
+    LatencyHistogram latency;
+    double seconds = 0;
+    bool failed = false;
+    for (int i = 0; i < clients; i++)
+    {
+        latency.merge(results[i].latency);
+        seconds = max(seconds, results[i].seconds);
+        failed |= results[i].failed;
+    }
+    munmap(results, clients * sizeof(ClientResult));
+    printf("%-8s %8d %8d %12.0f %10.1f %10.1f %10.1f %10.1f\n", useRing ? "ring" : "socket", clients, window,
+           latency.count() / seconds, latency.percentile(50) / 1000.0, latency.percentile(99) / 1000.0,
+           latency.percentile(99.9) / 1000.0, latency.max() / 1000.0);
+    return !failed;
+}
+
+EngineServer *server = nullptr; // Engine of the server process, stopped by SIGTERM
+
+int main()
+{
+    pid_t engine = fork();
+    if (engine == 0)
+    {
+        Endpoint endpoint;
+        Endpoint::parse(SOCKET, endpoint);
+        EngineServer live(endpoint, false);
+        if (!live.open() || !live.openRing(RING))
+        {
+            perror("Engine");
+            return EXIT_FAILURE;
+        }
+        server = &live;
+        signal(SIGTERM, [](int) { server->stop(); });
+        live.serve();
+        return EXIT_SUCCESS; // The socket and the ring are removed with the engine
+    }
+
+    // Opens the auctions through the ring once the engine has created it
+    BidRing ring;
+    for (int attempt = 0; attempt < 1000 && !ring.open(RING); attempt++)
+    {
+        usleep(1000);
+    }
+    int client = ring.isOpen() ? ring.join() : -1;
+    if (client < 0)
+    {
+        fprintf(stderr, "The engine did not create the ring\n");
+        kill(engine, SIGTERM);
+        return EXIT_FAILURE;
+    }
+    for (int auction = 0; auction < AUCTIONS; auction++)
+    {
+        RingRequest request;
+        request.operation = RING_OPEN;
+        request.auction = auction;
+        request.client = client;
+        request.amount = 1000;
+        request.duration = 3600000000000LL;
+        request.sequence = auction;
+        ring.submit(request);
+        ring.await(client, auction);
+    }
+
+    printf("%d bids per run\n", BIDS);
+    printf("%-8s %8s %8s %12s %10s %10s %10s %10s\n", "Path", "clients", "window", "bids/s", "p50 us", "p99 us",
+           "p99.9 us", "max us");
+    bool reached = true;
+    const int runs[][2] = {{1, 1}, {1, 64}, {4, 1}, {4, 64}};
+    for (const auto &run : runs)
+    {
+        reached &= measure(false, run[0], run[1]);
+        reached &= measure(true, run[0], run[1]);
+    }
+    kill(engine, SIGTERM);
+    waitpid(engine, nullptr, 0);
+    if (!reached)
+    {
+        fprintf(stderr, "A client could not reach the engine\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
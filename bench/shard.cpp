@@ -0,0 +1,268 @@
+/**
+ * @file shard.cpp
+ * @brief Benchmark of the sharded live engine under skewed load
+ * A few hot auctions, all owned by the first shard and closing within the run, draw most of the bids, the rest are
+ * spread over thousands of cold auctions. Client processes pipeline their bids over a UNIX socket for a fixed time,
+ * once without and once with rebalancing. Reports the bids per second and the round-trip percentiles of the clients
+ * and the utilization, executed requests and cross-core messages of every shard.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../pacer.h"
+#include "../shard.h"
+
+using namespace std;
+
+const char *SOCKET = "unix:/tmp/shard-bench.sock"; // Endpoint of the engine
+const int SHARDS = 4;                              // Shards of the engine
+const int CLIENTS = 4;                             // Client processes, one connection each
+const int AUCTIONS = 20000;                        // Live auctions
+const int HOT = 8;                                 // Hot auctions, owned by the first shard
+const double HOT_SHARE = 0.75;                     // Share of the bids on the hot auctions
+const int WINDOW = 32;                             // Pipelined bids of a client
+const double SECONDS = 3;                          // Duration of a run
+
+/**
+ * @struct Shared
+ * @brief Start signal and measurements of the clients, in shared memory.
+ */
+struct Shared
+{
+    std::atomic<int> go{0};            // Set once the auctions are open
+    LatencyHistogram latency[CLIENTS]; // Round trips of every client in nanoseconds
+    int64_t bids[CLIENTS] = {0};       // Answered bids of every client
+    int64_t misordered[CLIENTS] = {0}; // Answers not in the order of the bids
+    bool failed[CLIENTS] = {false};    // Flag if the client could not reach the engine
+};
+
+/**
+ * @brief Connects to the engine, retrying while it starts.
+ */
+int connectEngine()
+{
+    Endpoint endpoint;
+    Endpoint::parse(SOCKET, endpoint);
+    for (int attempt = 0; attempt < 5000; attempt++)
+    {
+        int connection = endpoint.connect();
+        if (connection >= 0)
+        {
+            return connection;
+        }
+        usleep(1000);
+    }
+    return -1;
+}
+
+/**
+ * @brief Reads answer lines until a count of them arrived.
+ * @return false if the connection was closed
+ */
+bool readAnswers(int connection, string &input, int count, vector<string> &answers)
+{
+    char data[16384];
+    answers.clear();
+    while ((int)answers.size() < count)
+    {
+        size_t end = input.find('\n');
+        if (end != string::npos)
+        {
+            answers.push_back(input.substr(0, end));
+            input.erase(0, end + 1);
+            continue;
+        }
+        ssize_t received = recv(connection, data, sizeof(data), 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        input.append(data, received);
+    }
+    return true;
+}
+
+/**
+ * @brief Bids in windows until the run ends, most bids go to the hot auctions.
+ */
+void client(int index, const vector<uint32_t> &hot, Shared &shared)
+{
+    // Connecting after the auctions are open, the clients are spread over the shards in turn
+    while (shared.go.load() == 0)
+    {
+        usleep(100);
+    }
+    int connection = connectEngine();
+    if (connection < 0)
+    {
+        shared.failed[index] = true;
+        return;
+    }
+    mt19937_64 generator(index + 1);
+    uniform_real_distribution<double> share(0, 1);
+    vector<Cents> prices(AUCTIONS, 1000);
+    vector<uint32_t> auctions(WINDOW);
+    vector<string> answers;
+    string input;
+    string requests;
+    char line[128];
+    uint64_t sequence = 0;
+    int64_t end = Pacer::now() + (int64_t)(SECONDS * 1e9);
+    while (Pacer::now() < end)
+    {
+        requests.clear();
+        for (int i = 0; i < WINDOW; i++)
+        {
+            uint32_t auction = share(generator) < HOT_SHARE ? hot[generator() % HOT] : generator() % AUCTIONS;
+            Cents amount = prices[auction] + percentOf(prices[auction], 1);
+            auctions[i] = auction;
+            int length = snprintf(line, sizeof(line), "BID %u %d %lld.%02lld %llu\n", auction, index * WINDOW + i + 1,
+                                  (long long)(amount / 100), (long long)(amount % 100), (unsigned long long)(sequence + i));
+            requests.append(line, length);
+        }
+        int64_t submitted = Pacer::now();
+        if (send(connection, requests.data(), requests.size(), MSG_NOSIGNAL) != (ssize_t)requests.size() ||
+            !readAnswers(connection, input, WINDOW, answers))
+        {
+            shared.failed[index] = true;
+            break;
+        }
+        int64_t answered = Pacer::now();
+        for (int i = 0; i < WINDOW; i++)
+        {
+            const char *answer = answers[i].c_str();
+            shared.misordered[index] += strtoull(answer + 4, nullptr, 10) != sequence + i;
+            size_t space = answers[i].rfind(' ');
+            prices[auctions[i]] = max(prices[auctions[i]], toCents(strtod(answer + space + 1, nullptr)));
+            shared.latency[index].record(answered - submitted);
+        }
+        shared.bids[index] += WINDOW;
+        sequence += WINDOW;
+    }
+    close(connection);
+}
+
+/**
+ * @brief Runs the engine and the clients once and prints the results.
+ * @return false if a client failed
+ */
+bool measure(bool rebalance)
+{
+    vector<uint32_t> hot;
+    for (uint32_t auction = 0; (int)hot.size() < HOT; auction++)
+    {
+        if (ShardedServer::home(auction, SHARDS) == 0)
+        {
+            hot.push_back(auction);
+        }
+    }
+
+    // The clients are forked before the engine starts its threads
+    Shared *shared = (Shared *)mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    new (shared) Shared();
+    vector<pid_t> clients;
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        pid_t process = fork();
+        if (process == 0)
+        {
+            client(i, hot, *shared);
+            _exit(EXIT_SUCCESS);
+        }
+        clients.push_back(process);
+    }
+
+    Endpoint endpoint;
+    Endpoint::parse(SOCKET, endpoint);
+    ShardConfig config;
+    config.shards = SHARDS;
+    config.rebalance = rebalance;
+    ShardedServer server(endpoint, config);
+    if (!server.open())
+    {
+        perror("Engine");
+        return false;
+    }
+    thread engine(&ShardedServer::serve, &server);
+
+    // Hot auctions close within the run, the cold ones stay open, the openings are sent in batches
+    int connection = connectEngine();
+    string requests;
+    string input;
+    vector<string> answers;
+    char line[128];
+    bool opened = connection >= 0;
+    for (int auction = 0; opened && auction < AUCTIONS; auction++)
+    {
+        bool isHot = find(hot.begin(), hot.end(), (uint32_t)auction) != hot.end();
+        snprintf(line, sizeof(line), "OPEN %d 10 %g\n", auction, isHot ? SECONDS + 1 : 3600);
+        requests += line;
+        if ((auction + 1) % 1000 == 0 || auction + 1 == AUCTIONS)
+        {
+            opened = send(connection, requests.data(), requests.size(), MSG_NOSIGNAL) == (ssize_t)requests.size() &&
+                     readAnswers(connection, input, (auction % 1000) + 1, answers);
+            requests.clear();
+        }
+    }
+    close(connection);
+    shared->go = 1;
+    for (pid_t process : clients)
+    {
+        waitpid(process, nullptr, 0);
+    }
+    server.stop();
+    engine.join();
+
+    LatencyHistogram latency;
+    int64_t bids = 0;
+    int64_t misordered = 0;
+    bool failed = !opened;
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        latency.merge(shared->latency[i]);
+        bids += shared->bids[i];
+        misordered += shared->misordered[i];
+        failed |= shared->failed[i];
+    }
+    printf("\nRebalancing %s: %.0f bids/s, round trip of a window of %d: p50 %.1f us, p99 %.1f us, p99.9 %.1f us, %lld answers out of order\n",
+           rebalance ? "on" : "off", bids / SECONDS, WINDOW, latency.percentile(50) / 1000.0,
+           latency.percentile(99) / 1000.0, latency.percentile(99.9) / 1000.0, (long long)misordered);
+    printf("%-6s %8s %10s %10s %10s %10s %8s %8s\n", "Shard", "busy %", "read", "executed", "sent/s", "recv/s",
+           "moved in", "out");
+    for (int shard = 0; shard < SHARDS; shard++)
+    {
+        const ShardStats &stats = server.getStats(shard);
+        double seconds = stats.wall / 1e9;
+        printf("%-6d %8.1f %10lld %10lld %10.0f %10.0f %8lld %8lld\n", shard, 100.0 * (stats.wall - stats.idle) / stats.wall,
+               (long long)stats.read, (long long)stats.requests, stats.sent / seconds, stats.received / seconds,
+               (long long)stats.movedIn, (long long)stats.movedOut);
+    }
+    munmap(shared, sizeof(Shared));
+    return !failed && misordered == 0;
+}
+
+int main()
+{
+    printf("%d shards, %d clients, %d auctions, %.0f %% of the bids on %d hot auctions of shard 0, %u CPUs\n", SHARDS, CLIENTS,
+           AUCTIONS, HOT_SHARE * 100, HOT, thread::hardware_concurrency());
+    bool valid = measure(false) && measure(true);
+    if (!valid)
+    {
+        fprintf(stderr, "A client failed or received its answers out of order\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
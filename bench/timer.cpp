@@ -0,0 +1,187 @@
+/**
+ * @file timer.cpp
+ * @brief Benchmark of the timer wheel with 10 M pending timers
+ * Schedules 10 M auction ends over an hour, moves every timer once (a first bid or a soft-close extension), cancels
+ * a tenth of them and advances the clock through the hour in steps of a millisecond, as the live engine would.
+ * Reports the cost of every operation and how late the timers expired, next to a binary heap with lazy deletion
+ * doing the same work.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <vector>
+#include "../histogram.h"
+#include "../timer.h"
+
+using namespace std;
+
+const uint32_t TIMERS = 10000000;      // Pending timers
+const int64_t HOUR = 3600000000000LL;  // Span of the deadlines in nanoseconds
+const int64_t STEP = 1000000;          // Nanoseconds between two advances of the clock
+const int64_t TICK = 1000000;          // Nanoseconds of a tick of the wheel
+const int64_t START = 1000000000000LL; // Clock at the start, the monotonic clock is far from zero
+
+/**
+ * @brief Seconds since a start.
+ */
+double since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @struct Plan
+ * @brief The operations of the benchmark, the same for both structures.
+ */
+struct Plan
+{
+    vector<int64_t> deadlines;  // First deadline of every timer
+    vector<int64_t> moved;      // Deadline of every timer after it is moved
+    vector<uint32_t> cancelled; // Timers cancelled after the moves
+};
+
+/**
+ * @brief Prints a row of the results.
+ */
+void report(const char *name, double schedule, double move, double cancel, double expire, size_t expired,
+            const LatencyHistogram &lateness)
+{
+    printf("%-6s %10.1f %10.1f %10.1f %10.1f %10zu %10.3f %10.3f\n", name, schedule * 1e9 / TIMERS, move * 1e9 / TIMERS,
+           cancel * 1e9 / (TIMERS / 10), expire * 1e9 / max<size_t>(expired, 1), expired, lateness.percentile(99) / 1e6,
+           lateness.max() / 1e6);
+}
+
+/**
+ * @brief Runs the plan on the timer wheel.
+ * @return Expired timers
+ */
+size_t runWheel(const Plan &plan)
+{
+    TimerWheel wheel(TICK, START);
+    wheel.reserve(TIMERS);
+    auto start = chrono::steady_clock::now();
+    for (uint32_t id = 0; id < TIMERS; id++)
+    {
+        wheel.schedule(id, plan.deadlines[id]);
+    }
+    double schedule = since(start);
+
+    start = chrono::steady_clock::now();
+    for (uint32_t id = 0; id < TIMERS; id++)
+    {
+        wheel.schedule(id, plan.moved[id]);
+    }
+    double move = since(start);
+
+    start = chrono::steady_clock::now();
+    for (uint32_t id : plan.cancelled)
+    {
+        wheel.cancel(id);
+    }
+    double cancel = since(start);
+
+    LatencyHistogram lateness;
+    size_t expired = 0;
+    start = chrono::steady_clock::now();
+    for (int64_t now = START + STEP; wheel.size() > 0; now += STEP)
+    {
+        expired += wheel.advance(now, [&](uint32_t id) { lateness.record(now - plan.moved[id]); });
+    }
+    report("wheel", schedule, move, cancel, since(start), expired, lateness);
+    return expired;
+}
+
+/**
+ * @brief Runs the plan on a binary heap, moved and cancelled timers leave stale entries skipped by their version.
+ * @return Expired timers
+ */
+size_t runHeap(const Plan &plan)
+{
+    struct Entry
+    {
+        int64_t deadline;
+        uint32_t id;
+        uint32_t version;
+        bool operator>(const Entry &other) const { return this->deadline > other.deadline; }
+    };
+    vector<Entry> entries;
+    entries.reserve(2 * TIMERS);
+    priority_queue<Entry, vector<Entry>, greater<Entry>> heap(greater<Entry>(), std::move(entries));
+    vector<uint32_t> versions(TIMERS, 0);
+    auto start = chrono::steady_clock::now();
+    for (uint32_t id = 0; id < TIMERS; id++)
+    {
+        heap.push({plan.deadlines[id], id, 0});
+    }
+    double schedule = since(start);
+
+    start = chrono::steady_clock::now();
+    for (uint32_t id = 0; id < TIMERS; id++)
+    {
+        heap.push({plan.moved[id], id, ++versions[id]});
+    }
+    double move = since(start);
+
+    start = chrono::steady_clock::now();
+    for (uint32_t id : plan.cancelled)
+    {
+        versions[id]++;
+    }
+    double cancel = since(start);
+
+    LatencyHistogram lateness;
+    size_t expired = 0;
+    start = chrono::steady_clock::now();
+    for (int64_t now = START + STEP; !heap.empty(); now += STEP)
+    {
+        while (!heap.empty() && heap.top().deadline <= now)
+        {
+            Entry entry = heap.top();
+            heap.pop();
+            if (entry.version == versions[entry.id])
+            {
+                lateness.record(now - entry.deadline);
+                expired++;
+            }
+        }
+    }
+    report("heap", schedule, move, cancel, since(start), expired, lateness);
+    return expired;
+}
+
+int main()
+{
+    // Auctions end within the hour, every one is moved by up to a minute and every tenth one is cancelled
+    Plan plan;
+    mt19937_64 generator(1);
+    plan.deadlines.resize(TIMERS);
+    plan.moved.resize(TIMERS);
+    for (uint32_t id = 0; id < TIMERS; id++)
+    {
+        plan.deadlines[id] = START + generator() % HOUR;
+        plan.moved[id] = plan.deadlines[id] + generator() % 60000000000LL;
+    }
+    for (uint32_t id = 0; id < TIMERS; id += 10)
+    {
+        plan.cancelled.push_back(id);
+    }
+
+    printf("%u timers over an hour, the clock advances by %.0f ms, a tick of the wheel is %.0f ms\n", TIMERS, STEP / 1e6,
+           TICK / 1e6);
+    printf("%-6s %10s %10s %10s %10s %10s %10s %10s\n", "", "insert ns", "move ns", "cancel ns", "expire ns", "expired",
+           "p99 ms", "late ms");
+    size_t wheel = runWheel(plan);
+    size_t heap = runHeap(plan);
+    if (wheel != TIMERS - plan.cancelled.size() || heap != wheel)
+    {
+        printf("Expired %zu timers in the wheel and %zu in the heap, expected %zu\n", wheel, heap,
+               TIMERS - plan.cancelled.size());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,283 @@
+/**
+ * @file wal.cpp
+ * @brief Benchmark of the write-ahead log of the live engine
+ * Client threads pipeline bids over a UNIX socket to the live engine for a fixed time, once without the log and
+ * once for every durability of the log, and every bid raises its auction, so every bid is accepted and logged.
+ * The syncing durabilities run once more by pwrite instead of io_uring. Reports the accepted bids per second, the
+ * round trips of the clients and the writes and syncs of the log, then recovers the log into a new engine and checks
+ * the recovered prices against the last acknowledged ones.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "../engine.h"
+#include "../pacer.h"
+#include "../wal.h"
+
+using namespace std;
+
+const char *SOCKET = "unix:/tmp/wal-bench.sock"; // Endpoint of the engine
+const int AUCTIONS = 10000;                      // Live auctions, each bid on by a single client
+const int CLIENTS = 4;                           // Client threads, one connection each
+const int WINDOW = 16;                           // Pipelined bids of a client
+const double SECONDS = 2;                        // Duration of a run
+
+/**
+ * @struct Client
+ * @brief Measurements of a client.
+ */
+struct Client
+{
+    LatencyHistogram latency; // Round trips of the windows in nanoseconds
+    int64_t accepted = 0;     // Acknowledged bids
+    vector<Cents> prices;     // Last acknowledged price of every auction
+    bool failed = false;      // Flag if the client could not reach the engine
+};
+
+/**
+ * @brief Connects to the engine, retrying while it starts.
+ */
+int connectEngine()
+{
+    Endpoint endpoint;
+    Endpoint::parse(SOCKET, endpoint);
+    for (int attempt = 0; attempt < 5000; attempt++)
+    {
+        int connection = endpoint.connect();
+        if (connection >= 0)
+        {
+            return connection;
+        }
+        usleep(1000);
+    }
+    return -1;
+}
+
+/**
+ * @brief Reads answer lines until a count of them arrived.
+ * @return false if the connection was closed
+ */
+bool readAnswers(int connection, string &input, int count, vector<string> &answers)
+{
+    char data[16384];
+    answers.clear();
+    while ((int)answers.size() < count)
+    {
+        size_t end = input.find('\n');
+        if (end != string::npos)
+        {
+            answers.push_back(input.substr(0, end));
+            input.erase(0, end + 1);
+            continue;
+        }
+        ssize_t received = recv(connection, data, sizeof(data), 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        input.append(data, received);
+    }
+    return true;
+}
+
+/**
+ * @brief Raises the auctions of a client in windows until the run ends, every bid by a new bidder.
+ */
+void bid(int index, Client &client)
+{
+    int connection = connectEngine();
+    if (connection < 0)
+    {
+        client.failed = true;
+        return;
+    }
+    client.prices.assign(AUCTIONS, 1000);
+    vector<int> auctions(WINDOW);
+    vector<string> answers;
+    string input;
+    string requests;
+    char line[128];
+    uint64_t sequence = 0;
+    int next = index;
+    int64_t end = Pacer::now() + (int64_t)(SECONDS * 1e9);
+    while (Pacer::now() < end)
+    {
+        requests.clear();
+        for (int i = 0; i < WINDOW; i++)
+        {
+            auctions[i] = next;
+            Cents amount = client.prices[next] + percentOf(client.prices[next], 1);
+            int length = snprintf(line, sizeof(line), "BID %d %llu %lld.%02lld %llu\n", next,
+                                  (unsigned long long)(sequence + i) * CLIENTS + index + 1, (long long)(amount / 100),
+                                  (long long)(amount % 100), (unsigned long long)(sequence + i));
+            requests.append(line, length);
+            client.prices[next] = amount;
+            next = (next + CLIENTS) % AUCTIONS;
+        }
+        int64_t submitted = Pacer::now();
+        if (send(connection, requests.data(), requests.size(), MSG_NOSIGNAL) != (ssize_t)requests.size() ||
+            !readAnswers(connection, input, WINDOW, answers))
+        {
+            client.failed = true;
+            break;
+        }
+        client.latency.record(Pacer::now() - submitted);
+        for (int i = 0; i < WINDOW; i++)
+        {
+            client.accepted += answers[i][0] == 'A';
+            client.failed |= answers[i][0] != 'A';
+        }
+        sequence += WINDOW;
+    }
+    close(connection);
+}
+
+/**
+ * @brief Runs the engine and the clients once and prints the results, then checks the recovery of the log.
+ * @param name Name of the durability.
+ * @param config The log, an empty path runs the engine without it.
+ * @return false if a client failed or the recovered auctions differ
+ */
+bool measure(const char *name, const WalConfig &config)
+{
+    Endpoint endpoint;
+    Endpoint::parse(SOCKET, endpoint);
+    unlink(config.path.c_str());
+    vector<Client> clients(CLIENTS);
+    WalStats stats;
+    {
+        EngineServer server(endpoint, false);
+        if ((!config.path.empty() && !server.openLog(config)) || !server.open())
+        {
+            perror("Engine");
+            return false;
+        }
+        thread engine(&EngineServer::serve, &server);
+
+        // The auctions are opened by one connection in batches
+        int connection = connectEngine();
+        string requests;
+        string input;
+        vector<string> answers;
+        char line[64];
+        bool opened = connection >= 0;
+        for (int auction = 0; opened && auction < AUCTIONS; auction++)
+        {
+            snprintf(line, sizeof(line), "OPEN %d 10 3600\n", auction);
+            requests += line;
+            if ((auction + 1) % 1000 == 0)
+            {
+                opened = send(connection, requests.data(), requests.size(), MSG_NOSIGNAL) == (ssize_t)requests.size() &&
+                         readAnswers(connection, input, 1000, answers);
+                requests.clear();
+            }
+        }
+        close(connection);
+
+        vector<thread> threads;
+        for (int i = 0; opened && i < CLIENTS; i++)
+        {
+            threads.emplace_back(bid, i, ref(clients[i]));
+        }
+        for (thread &client : threads)
+        {
+            client.join();
+        }
+        server.stop();
+        engine.join();
+        if (!opened)
+        {
+            fprintf(stderr, "The auctions could not be opened\n");
+            return false;
+        }
+        if (server.getLogStats())
+        {
+            stats = *server.getLogStats();
+        }
+    }
+
+    LatencyHistogram latency;
+    int64_t accepted = 0;
+    bool failed = false;
+    for (const Client &client : clients)
+    {
+        latency.merge(client.latency);
+        accepted += client.accepted;
+        failed |= client.failed;
+    }
+    printf("%-9s %10.0f %10.1f %10.1f %10lld %10lld %10.1f %10.1f", name, accepted / SECONDS, latency.percentile(50) / 1000.0,
+           latency.percentile(99) / 1000.0, (long long)stats.writes, (long long)stats.syncs,
+           stats.syncs > 0 ? (double)stats.records / stats.syncs : 0.0, stats.syncs > 0 ? stats.syncTime / 1000.0 / stats.syncs : 0.0);
+    if (config.path.empty())
+    {
+        printf("\n");
+        return !failed;
+    }
+
+    // The recovered price of every auction is the last acknowledged one
+    int64_t start = Pacer::now();
+    EngineServer recovered(endpoint, false);
+    if (!recovered.openLog(config))
+    {
+        perror("\nRecovery");
+        return false;
+    }
+    double seconds = (Pacer::now() - start) / 1e9;
+    int mismatched = 0;
+    string answer;
+    char request[32];
+    for (int auction = 0; auction < AUCTIONS; auction++)
+    {
+        snprintf(request, sizeof(request), "GET %d", auction);
+        answer.clear();
+        recovered.handle(request, answer);
+        Cents price = toCents(strtod(answer.c_str() + answer.find(' ', 6), nullptr));
+        mismatched += price != clients[auction % CLIENTS].prices[auction] || answer.find("open") == string::npos;
+    }
+    printf(" %10lld %10.1f %10d\n", (long long)recovered.getLogStats()->recovered, seconds * 1000, mismatched);
+    unlink(config.path.c_str());
+    return !failed && mismatched == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // The log lives in the working directory unless given, /tmp may be a memory file system
+    string path = argc > 1 ? argv[1] : "wal-bench.log";
+    printf("%d clients pipelining %d bids each over %d auctions for %.0f s, log %s\n", CLIENTS, WINDOW, AUCTIONS, SECONDS,
+           path.c_str());
+    printf("%-9s %10s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "", "bids/s", "p50 us", "p99 us", "writes", "syncs",
+           "per sync", "sync us", "recovered", "replay ms", "mismatch");
+    bool valid = measure("none", WalConfig());
+    const char *names[] = {"write", "periodic", "group", "sync"};
+    for (int durability = WAL_WRITE; durability <= WAL_SYNC; durability++)
+    {
+        WalConfig config;
+        config.path = path;
+        config.durability = (WalDurability)durability;
+        valid &= measure(names[durability], config);
+    }
+
+    // The syncing durabilities again by pwrite and fdatasync instead of io_uring
+    const char *pwriteNames[] = {"group pw", "sync pw"};
+    for (int durability = WAL_GROUP; durability <= WAL_SYNC; durability++)
+    {
+        WalConfig config;
+        config.path = path;
+        config.durability = (WalDurability)durability;
+        config.backend = OUTPUT_PWRITE;
+        valid &= measure(pwriteNames[durability - WAL_GROUP], config);
+    }
+    if (!valid)
+    {
+        fprintf(stderr, "A client failed or a recovered auction differs from its last acknowledged bid\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
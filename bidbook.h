@@ -0,0 +1,190 @@
+/**
+ * @file bidbook.h
+ * @brief Sorted bid book of a multi-unit auction item
+ * The book keeps the k highest bids (k = number of units) apart from the rest, a bid is inserted
+ * in O(log n) and the k-th highest bid (the lowest winning bid) is available in O(1).
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef BIDBOOK_H
+#define BIDBOOK_H
+
+#include <cstdint>
+#include <deque>
+#include <set>
+#include "currency.h"
+
+struct BookBid;
+
+/**
+ * @brief Orders bids from the lowest to the highest, an earlier bid is higher than a later bid of the same amount.
+ */
+struct BookOrder
+{
+    bool operator()(const BookBid *a, const BookBid *b) const;
+};
+
+/**
+ * @struct BookBid
+ * @brief Standing bid of a single bidder, owned by the book.
+ */
+struct BookBid
+{
+    Cents amount = 0;                                  // Amount of the bid
+    uint64_t sequence = 0;                             // Order of placement, earlier bids win ties
+    int type = 0;                                      // Strategy of the bidder
+    int32_t owner = -1;                                // Population identifier of the bidder, -1 without a population
+    Cents value = 0;                                   // Valuation of the bidder, a won unit yields value - price
+    int connection = -1;                               // LatencyClass of the bidder, -1 without the latency model
+    bool active = false;                               // Flag if the bid is in the book
+    bool winning = false;                              // Flag if the bid is one of the k highest
+    std::multiset<BookBid *, BookOrder>::iterator position; // Position in the winning or losing bids
+};
+
+inline bool BookOrder::operator()(const BookBid *a, const BookBid *b) const
+{
+    return a->amount < b->amount || (a->amount == b->amount && a->sequence > b->sequence);
+}
+
+/**
+ * @class BidBook
+ * @brief Bid book with O(log n) insertion and O(1) access to the k-th highest bid.
+ */
+class BidBook
+{
+private:
+    typedef std::multiset<BookBid *, BookOrder> Bids;
+
+    size_t units = 1;         // Number of units sold, k
+    Bids winning;             // The k highest bids
+    Bids losing;              // The remaining bids
+    std::deque<BookBid> bids; // Storage of the bids, addresses are stable
+    uint64_t sequence = 0;    // Order of the placed bids
+
+    void insert(BookBid *bid, Bids &into)
+    {
+        bid->winning = &into == &this->winning;
+        bid->position = into.insert(bid);
+    }
+
+    // Moves bids between the sets, so that the winning set holds exactly the k highest bids
+    void rebalance()
+    {
+        while (this->winning.size() > this->units)
+        {
+            BookBid *lowest = *this->winning.begin();
+            this->winning.erase(this->winning.begin());
+            insert(lowest, this->losing);
+        }
+        while (this->winning.size() < this->units && !this->losing.empty())
+        {
+            BookBid *highest = *this->losing.rbegin();
+            this->losing.erase(highest->position);
+            insert(highest, this->winning);
+        }
+    }
+
+public:
+    explicit BidBook(size_t units = 1) : units(units) {}
+
+    void setUnits(size_t units)
+    {
+        this->units = units;
+        rebalance();
+    }
+
+    size_t getUnits() const { return this->units; }
+
+    /**
+     * @brief Creates a bid slot of a bidder, the slot is not in the book until a bid is placed.
+     * @param type Strategy of the bidder.
+     * @param owner Population identifier of the bidder.
+     * @return The bid slot, valid for the lifetime of the book
+     */
+    BookBid *add(int type, int32_t owner = -1)
+    {
+        this->bids.emplace_back();
+        this->bids.back().type = type;
+        this->bids.back().owner = owner;
+        return &this->bids.back();
+    }
+
+    /**
+     * @brief Places a bid, a standing bid of the same bidder is replaced.
+     * @param bid The bid slot of the bidder.
+     * @param amount Amount of the bid.
+     */
+    void place(BookBid *bid, Cents amount)
+    {
+        remove(bid);
+        bid->amount = amount;
+        bid->sequence = ++this->sequence;
+        bid->active = true;
+        insert(bid, this->winning);
+        rebalance();
+    }
+
+    /**
+     * @brief Removes a bid from the book.
+     * @param bid The bid slot of the bidder.
+     */
+    void remove(BookBid *bid)
+    {
+        if (!bid->active)
+        {
+            return;
+        }
+        (bid->winning ? this->winning : this->losing).erase(bid->position);
+        bid->active = false;
+        rebalance();
+    }
+
+    size_t size() const { return this->winning.size() + this->losing.size(); }
+
+    /**
+     * @brief Checks if all units have a winning bid.
+     */
+    bool full() const { return this->winning.size() == this->units; }
+
+    /**
+     * @brief The k-th highest bid, the lowest winning bid.
+     * @return The bid, nullptr if the book is empty
+     */
+    const BookBid *kth() const { return this->winning.empty() ? nullptr : *this->winning.begin(); }
+
+    /**
+     * @brief The highest bid.
+     * @return The bid, nullptr if the book is empty
+     */
+    const BookBid *best() const { return this->winning.empty() ? nullptr : *this->winning.rbegin(); }
+
+    /**
+     * @brief Removes the highest bid from the book.
+     * @return The removed bid, nullptr if the book is empty
+     */
+    BookBid *popBest()
+    {
+        if (this->winning.empty())
+        {
+            return nullptr;
+        }
+        BookBid *highest = *this->winning.rbegin();
+        remove(highest);
+        return highest;
+    }
+
+    /**
+     * @brief Calls a function for every winning bid, from the lowest to the highest.
+     */
+    template <typename F>
+    void forEachWinning(F function) const
+    {
+        for (const BookBid *bid : this->winning)
+        {
+            function(*bid);
+        }
+    }
+};
+
+#endif // BIDBOOK_H
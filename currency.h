@@ -0,0 +1,77 @@
+/**
+ * @file currency.h
+ * @brief Fixed-point currency arithmetic
+ * Prices are kept as integer cents, so increments and comparisons are exact.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef CURRENCY_H
+#define CURRENCY_H
+
+#include <cmath>
+#include <cstdint>
+
+typedef int64_t Cents; // Amount of money in cents
+
+const Cents INFINITE_CENTS = INT64_MAX / 2; // Valuation of irrational bidders, leaves room for adding increments
+
+/**
+ * @brief Converts an amount of money to cents, rounding to the nearest cent.
+ * @param amount The amount of money.
+ * @return The amount in cents, INFINITE_CENTS for an infinite amount.
+ */
+inline Cents toCents(double amount)
+{
+    if (std::isinf(amount))
+    {
+        return amount > 0 ? INFINITE_CENTS : -INFINITE_CENTS;
+    }
+    return std::llround(amount * 100);
+}
+
+/**
+ * @brief Converts cents to an amount of money.
+ * @param cents The amount in cents.
+ * @return The amount of money.
+ */
+inline double toAmount(Cents cents)
+{
+    return cents / 100.0;
+}
+
+/**
+ * @brief Percentage of a price rounded half up to whole cents, at least one cent.
+ * @param price The price in cents.
+ * @param percent The percentage.
+ * @return The rounded share of the price in cents.
+ */
+inline Cents percentOf(Cents price, int percent)
+{
+    Cents share = (price * percent + 50) / 100;
+    return share > 0 ? share : 1;
+}
+
+/**
+ * @brief Bid increment of the eBay increment table for a price.
+ * @param price The current price in cents.
+ * @return The increment in cents.
+ */
+inline Cents tieredIncrement(Cents price)
+{
+    // Upper bounds of the price tiers and their increments
+    static const Cents TIERS[][2] = {
+        {100, 5}, {500, 25}, {2500, 50}, {10000, 100}, {25000, 250},
+        {50000, 500}, {100000, 1000}, {250000, 2500}, {500000, 5000}};
+
+    for (const Cents *tier : TIERS)
+    {
+        if (price < tier[0])
+        {
+            return tier[1];
+        }
+    }
+    return 10000;
+}
+
+#endif // CURRENCY_H
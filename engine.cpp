@@ -0,0 +1,405 @@
+/**
+ * @file engine.cpp
+ * @brief Live auction engine
+ * The server is a single-threaded poll loop, the answers of a connection are collected over a round of the loop
+ * and written by one send. The client sockets are non-blocking, the answers a client does not take stay with its
+ * connection and are sent once poll reports the socket writable.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include "engine.h"
+#include "pacer.h"
+#include "protocol.h"
+#include "wal.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+
+const int64_t SWEEP_INTERVAL = 1000000;   // Nanoseconds between two sweeps of the ended auctions, a tick of the timer wheel
+const int IDLE_TIMEOUT = 10;              // Milliseconds the server waits in poll at most, bounds how late an auction ends
+const int RING_ROUNDS = 256;              // Rounds of the ring between two looks at the sockets
+const int RING_BURST = 256;               // Requests of the ring handled in a round
+
+/**
+ * @struct Connection
+ * @brief A client of the server.
+ */
+struct Connection
+{
+    string input;         // Received bytes not handled yet
+    string output;        // Answers not sent yet
+    bool http = false;    // Flag if the client sent an HTTP request, its headers are skipped
+    bool closing = false; // Flag if the connection is closed once the answers are sent
+};
+
+/**
+ * @brief Appends formatted text to a string.
+ */
+template <typename... Arguments>
+void append(string &text, const char *format, Arguments... arguments)
+{
+    char line[160];
+    int length = snprintf(line, sizeof(line), format, arguments...);
+    text.append(line, min<size_t>(length, sizeof(line) - 1));
+}
+
+} // namespace
+
+EngineServer::EngineServer(const Endpoint &endpoint, bool tiered, int64_t softClose)
+    : endpoint(endpoint), engine(tiered, softClose)
+{
+}
+
+EngineServer::~EngineServer()
+{
+    if (this->listener >= 0)
+    {
+        close(this->listener);
+        if (this->endpoint.transport == UNIX_TRANSPORT)
+        {
+            unlink(this->endpoint.path.c_str());
+        }
+    }
+}
+
+bool EngineServer::open()
+{
+    this->listener = this->endpoint.listen();
+    return this->listener >= 0;
+}
+
+bool EngineServer::openLog(const WalConfig &config)
+{
+    this->wal = make_unique<WriteAheadLog>();
+    if (!this->wal->open(config, this->engine))
+    {
+        this->wal.reset();
+        return false;
+    }
+    return true;
+}
+
+const WalStats *EngineServer::getLogStats() const
+{
+    return this->wal ? &this->wal->getStats() : nullptr;
+}
+
+void EngineServer::persist(WalRecordType type, uint32_t id, int64_t now)
+{
+    if (this->wal && !this->wal->append(type, id, *this->engine.find(id, now), now))
+    {
+        this->error = errno;
+        this->stopped = true;
+    }
+}
+
+void EngineServer::settle(bool idle)
+{
+    int64_t now = Pacer::now();
+    if (!this->wal || !(this->wal->isDue(now) || (idle && this->wal->isHolding())))
+    {
+        return;
+    }
+    if (!this->wal->commit(now))
+    {
+        this->error = errno;
+        this->stopped = true;
+        return;
+    }
+    for (const auto &[client, response] : this->held)
+    {
+        this->ring.respond(client, response);
+    }
+    this->held.clear();
+}
+
+void EngineServer::handle(const char *request, string &answer)
+{
+    int64_t now = Pacer::now();
+    char *next;
+    if (strncmp(request, "BID ", 4) == 0)
+    {
+        const char *field = request + 4;
+        uint32_t id = parseUnsigned(field);
+        uint64_t bidder = parseUnsigned(field);
+        Cents amount = parseCents(field);
+        uint64_t sequence = parseUnsigned(field);
+        BidStatus status = this->engine.bid(id, bidder, amount, now);
+        if (status == ACCEPTED)
+        {
+            persist(WAL_BID, id, now);
+        }
+        const AuctionState *auction = this->engine.find(id, now);
+        answer += status == ACCEPTED ? "ACK" : "REJ";
+        appendUnsigned(answer, sequence);
+        if (status != ACCEPTED)
+        {
+            answer += ' ';
+            answer += BID_REASONS[status];
+        }
+        appendCents(answer, auction ? auction->price : 0);
+        answer += '\n';
+    }
+    else if (strncmp(request, "OPEN ", 5) == 0)
+    {
+        uint32_t id = strtoul(request + 5, &next, 10);
+        Cents price = toCents(strtod(next, &next));
+        double duration = strtod(next, &next);
+        double timeout = strtod(next, &next);
+        bool opened = price > 0 && duration > 0 &&
+                      this->engine.open(id, price, now + (int64_t)(duration * 1e9), now + (int64_t)((timeout > 0 ? timeout : duration) * 1e9));
+        if (opened)
+        {
+            persist(WAL_OPEN, id, now);
+        }
+        append(answer, "%s %u\n", opened ? "OK" : "ERR", id);
+    }
+    else if (strncmp(request, "GET ", 4) == 0 && request[4] != '/')
+    {
+        uint32_t id = strtoul(request + 4, &next, 10);
+        const AuctionState *auction = this->engine.find(id, now);
+        if (!auction)
+        {
+            append(answer, "STATE %u 0 0 0 unknown\n", id);
+        }
+        else
+        {
+            const char *state = auction->open ? "open" : auction->ending == SOLD ? "sold" : "unsold";
+            append(answer, "STATE %u %.2f %llu %d %s\n", id, toAmount(auction->price), (unsigned long long)auction->leader,
+                   auction->bids, state);
+        }
+    }
+    else
+    {
+        answer += "ERR\n";
+    }
+    this->engine.getStats().requests++;
+    this->latency.record(Pacer::now() - now);
+}
+
+void EngineServer::handle(const RingRequest &request)
+{
+    int64_t now = Pacer::now();
+    RingResponse response;
+    response.sequence = request.sequence;
+    if (request.operation == RING_OPEN)
+    {
+        int64_t timeout = request.timeout > 0 ? request.timeout : request.duration;
+        bool opened = request.amount > 0 && request.duration > 0 &&
+                      this->engine.open(request.auction, request.amount, now + request.duration, now + timeout);
+        response.status = opened ? ACCEPTED : UNKNOWN_AUCTION;
+        response.price = request.amount;
+        if (opened)
+        {
+            persist(WAL_OPEN, request.auction, now);
+        }
+    }
+    else
+    {
+        response.status = this->engine.bid(request.auction, request.bidder, request.amount, now);
+        if (response.status == ACCEPTED)
+        {
+            persist(WAL_BID, request.auction, now);
+        }
+        const AuctionState *auction = this->engine.find(request.auction, now);
+        response.price = auction ? auction->price : 0;
+    }
+    if (this->wal && this->wal->isHolding())
+    {
+        this->held.emplace_back(request.client, response);
+    }
+    else
+    {
+        this->ring.respond(request.client, response);
+    }
+    this->engine.getStats().requests++;
+    this->latency.record(Pacer::now() - now);
+}
+
+int EngineServer::drain()
+{
+    RingRequest request;
+    int handled = 0;
+    while (handled < RING_BURST && this->ring.receive(request))
+    {
+        handle(request);
+        handled++;
+    }
+    return handled;
+}
+
+string EngineServer::histogram() const
+{
+    string text;
+    const LatencyHistogram &latency = this->latency;
+    const EngineStats &stats = this->engine.getStats();
+    append(text, "# Internal latency of the requests in nanoseconds\n");
+    append(text, "requests %lld\naccepted %lld\n", (long long)stats.requests, (long long)stats.accepted);
+    for (int status = TOO_LOW; status <= UNKNOWN_AUCTION; status++)
+    {
+        append(text, "rejected_%s %lld\n", BID_REASONS[status], (long long)stats.rejected[status]);
+    }
+    append(text, "auctions %lld\nsold %lld\nunsold %lld\n", (long long)stats.opened, (long long)stats.sold, (long long)stats.unsold);
+    if (this->ring.isOpen())
+    {
+        append(text, "ring_recovered %llu\n", (unsigned long long)this->ring.recovered());
+    }
+    append(text, "mean %.1f\n", latency.mean());
+    const double percentiles[] = {50, 90, 99, 99.9, 99.99};
+    for (double percentile : percentiles)
+    {
+        append(text, "p%g %llu\n", percentile, (unsigned long long)latency.percentile(percentile));
+    }
+    append(text, "max %llu\n# lowest highest count\n", (unsigned long long)latency.max());
+    for (int bucket = 0; bucket < LatencyHistogram::BUCKETS; bucket++)
+    {
+        if (latency.bucketCount(bucket) > 0)
+        {
+            append(text, "%llu %llu %llu\n", (unsigned long long)LatencyHistogram::lowest(bucket),
+                   (unsigned long long)LatencyHistogram::highest(bucket), (unsigned long long)latency.bucketCount(bucket));
+        }
+    }
+    return text;
+}
+
+void EngineServer::serve()
+{
+    vector<pollfd> sockets = {{this->listener, POLLIN, 0}};
+    vector<Connection> connections(1);
+    int64_t sweep = Pacer::now();
+    int round = 0;
+    int spins = 0;
+    while (!this->stopped)
+    {
+        int timeout = IDLE_TIMEOUT;
+        if (this->ring.isOpen())
+        {
+            // An idle ring is waited for by BidRing::relax, which yields the processor to the clients
+            int handled = drain();
+            settle(handled == 0);
+            if (handled > 0)
+            {
+                spins = 0;
+            }
+            else
+            {
+                BidRing::relax(spins);
+            }
+            if (++round % RING_ROUNDS != 0)
+            {
+                continue;
+            }
+            timeout = 0;
+        }
+
+        // A group of the log is committed as soon as no request is waiting
+        int ready = poll(sockets.data(), sockets.size(), this->wal && this->wal->isHolding() ? 0 : timeout);
+        if (Pacer::now() - sweep >= SWEEP_INTERVAL)
+        {
+            sweep = Pacer::now();
+            this->engine.sweep(sweep);
+        }
+        if (ready > 0 && (sockets[0].revents & POLLIN))
+        {
+            int client = accept4(this->listener, nullptr, nullptr, SOCK_NONBLOCK);
+            if (client >= 0)
+            {
+                int on = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                sockets.push_back({client, POLLIN, 0});
+                connections.emplace_back();
+            }
+        }
+
+        for (size_t i = 1; ready > 0 && i < sockets.size(); i++)
+        {
+            Connection &connection = connections[i];
+            if (!(sockets[i].revents & (POLLIN | POLLHUP | POLLERR)) || connection.closing)
+            {
+                continue;
+            }
+            char data[16384];
+            ssize_t received = recv(sockets[i].fd, data, sizeof(data), 0);
+            bool open = received > 0 || (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+            if (received > 0)
+            {
+                connection.input.append(data, received);
+            }
+
+            // Handles every complete line in place, the handled lines are dropped at once
+            size_t start = 0;
+            size_t end;
+            while (!connection.closing && (end = connection.input.find('\n', start)) != string::npos)
+            {
+                connection.input[end] = '\0';
+                if (end > start && connection.input[end - 1] == '\r')
+                {
+                    connection.input[end - 1] = '\0';
+                }
+                const char *line = connection.input.c_str() + start;
+                if (connection.http)
+                {
+                    // The headers end with an empty line
+                    if (*line == '\0')
+                    {
+                        string body = histogram();
+                        append(connection.output, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                               body.size());
+                        connection.output += body;
+                        connection.closing = true;
+                    }
+                }
+                else if (strncmp(line, "GET /", 5) == 0)
+                {
+                    connection.http = true;
+                }
+                else
+                {
+                    handle(line, connection.output);
+                }
+                start = end + 1;
+            }
+            connection.input.erase(0, start);
+
+            if (!open)
+            {
+                // A client closing its side still receives the answers to its last requests
+                settle(true);
+                connection.closing = true;
+            }
+        }
+
+        // The answers go out once the records they acknowledge are in the log
+        settle(ready <= 0);
+        for (size_t i = 1; (!this->wal || !this->wal->isHolding()) && i < sockets.size(); i++)
+        {
+            Connection &connection = connections[i];
+            if (!sendPending(sockets[i].fd, connection.output) || (connection.closing && connection.output.empty()))
+            {
+                close(sockets[i].fd);
+                sockets.erase(sockets.begin() + i);
+                connections.erase(connections.begin() + i);
+                i--;
+                continue;
+            }
+            sockets[i].events = clientEvents(connection.output, connection.closing);
+        }
+    }
+    for (size_t i = 1; i < sockets.size(); i++)
+    {
+        close(sockets[i].fd);
+    }
+}
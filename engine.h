@@ -0,0 +1,393 @@
+/**
+ * @file engine.h
+ * @brief Live auction engine
+ * Hosts live auctions in memory and matches bids against them with the bidding rules of the model: the first bid
+ * must meet the starting price, every further bid must add the minimal increment, an auction without a bid ends
+ * at its first-bid timeout and the leader at the end wins. The server accepts bids over a local socket in the line
+ * protocol of the load generator, so the simulated bidders can be replayed against it.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "auction.h"
+#include "currency.h"
+#include "histogram.h"
+#include "loadgen.h"
+#include "ring.h"
+#include "timer.h"
+
+class WriteAheadLog;
+struct WalConfig;
+struct WalStats;
+enum WalRecordType : uint8_t;
+
+/**
+ * @enum BidStatus
+ * @brief Answer of the engine to a bid.
+ */
+enum BidStatus
+{
+    ACCEPTED,        // The bidder leads the auction
+    TOO_LOW,         // The bid is below the starting price or does not add the increment
+    LEADING,         // The bidder already leads the auction
+    AUCTION_CLOSED,  // The auction has ended
+    UNKNOWN_AUCTION, // No such auction was opened
+};
+
+/**
+ * @struct AuctionState
+ * @brief A live auction, times are nanoseconds of the monotonic clock.
+ */
+struct AuctionState
+{
+    Cents price = 0;          // Current price, the starting price before the first bid
+    uint64_t leader = 0;      // Leading bidder, valid after the first bid
+    int64_t end = 0;          // End of the auction
+    int64_t firstBidEnd = 0;  // End of an auction without bids, the first-bid timeout
+    int32_t bids = 0;         // Accepted bids
+    bool open = false;        // Flag if the auction was opened and did not end yet
+    bool opened = false;      // Flag if the auction was ever opened
+    ItemEnding ending = SOLD; // Way the auction ended, valid once it is closed
+};
+
+/**
+ * @struct EngineStats
+ * @brief Counters of the engine.
+ */
+struct EngineStats
+{
+    int64_t opened = 0;        // Opened auctions
+    int64_t sold = 0;          // Auctions ended with a winner
+    int64_t unsold = 0;        // Auctions ended without a bid
+    int64_t requests = 0;      // Handled requests
+    int64_t accepted = 0;      // Accepted bids
+    int64_t rejected[5] = {0}; // Rejected bids by BidStatus, ACCEPTED unused
+};
+
+/**
+ * @class MatchingEngine
+ * @brief The live auctions, indexed by their number.
+ *
+ * @details
+ * Auctions end lazily, the state of an auction is checked against the clock whenever it is touched. Every open
+ * auction also has a timer in a timer wheel at its next possible end, the first-bid timeout until the first bid and
+ * the end later, moved by soft-close extensions, so sweep() ends the untouched auctions in time proportional to the
+ * ended ones. The engine is single-threaded, the server drives it from its event loop.
+ */
+class MatchingEngine
+{
+private:
+    std::vector<AuctionState> auctions;
+    bool tiered;       // eBay increment table instead of 1 % of the price
+    int64_t softClose; // A bid in the last softClose nanoseconds extends the end to softClose after the bid, 0 disables
+    EngineStats stats;
+    TimerWheel timers; // Next possible end of every open auction
+
+    /**
+     * @brief Ends the auction if its time is up.
+     * @return true if the auction is open
+     */
+    bool live(uint32_t id, int64_t now)
+    {
+        AuctionState &auction = this->auctions[id];
+        if (!auction.open)
+        {
+            return false;
+        }
+        if (now >= closing(auction))
+        {
+            auction.open = false;
+            auction.ending = auction.bids > 0 ? SOLD : NO_BIDS;
+            auction.bids > 0 ? this->stats.sold++ : this->stats.unsold++;
+            this->timers.cancel(id);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    static const uint32_t MAX_AUCTIONS = 1 << 24; // Highest auction number + 1
+
+    explicit MatchingEngine(bool tiered = false, int64_t softClose = 0) : tiered(tiered), softClose(softClose) {}
+
+    /**
+     * @brief Time an open auction ends at unless it is extended.
+     */
+    static int64_t closing(const AuctionState &auction)
+    {
+        return auction.bids == 0 ? std::min(auction.end, auction.firstBidEnd) : auction.end;
+    }
+
+    /**
+     * @brief Minimal increment of a price, the rule of the model.
+     */
+    Cents increment(Cents price) const { return this->tiered ? tieredIncrement(price) : percentOf(price, 1); }
+
+    /**
+     * @brief Opens an auction.
+     * @param id Number of the auction, below MAX_AUCTIONS.
+     * @param price Starting price.
+     * @param end End of the auction.
+     * @param firstBidEnd End of the auction if no bid is placed.
+     * @return false if the number is out of range or the auction is already open
+     */
+    bool open(uint32_t id, Cents price, int64_t end, int64_t firstBidEnd)
+    {
+        if (id >= MAX_AUCTIONS)
+        {
+            return false;
+        }
+        if (id >= this->auctions.size())
+        {
+            this->auctions.resize(std::max<size_t>(id + 1, this->auctions.size() * 2));
+        }
+        AuctionState &auction = this->auctions[id];
+        if (auction.open)
+        {
+            return false;
+        }
+        auction = AuctionState();
+        auction.price = price;
+        auction.end = end;
+        auction.firstBidEnd = firstBidEnd;
+        auction.open = true;
+        auction.opened = true;
+        this->stats.opened++;
+        this->timers.schedule(id, closing(auction));
+        return true;
+    }
+
+    /**
+     * @brief Matches a bid against an auction.
+     * @param id Number of the auction.
+     * @param bidder The bidder.
+     * @param amount The bid.
+     * @param now Time of the bid.
+     * @return Answer to the bid
+     */
+    BidStatus bid(uint32_t id, uint64_t bidder, Cents amount, int64_t now)
+    {
+        BidStatus status = ACCEPTED;
+        if (id >= this->auctions.size() || !this->auctions[id].opened)
+        {
+            status = UNKNOWN_AUCTION;
+        }
+        else
+        {
+            AuctionState &auction = this->auctions[id];
+            if (!live(id, now))
+            {
+                status = AUCTION_CLOSED;
+            }
+            else if (auction.bids > 0 && auction.leader == bidder)
+            {
+                status = LEADING;
+            }
+            else if (amount < (auction.bids == 0 ? auction.price : auction.price + increment(auction.price)))
+            {
+                status = TOO_LOW;
+            }
+            else
+            {
+                // The first bid lifts the first-bid timeout, a late bid extends the end
+                int64_t before = closing(auction);
+                auction.price = amount;
+                auction.leader = bidder;
+                auction.bids++;
+                if (this->softClose > 0 && auction.end - now < this->softClose)
+                {
+                    auction.end = now + this->softClose;
+                }
+                if (closing(auction) != before)
+                {
+                    this->timers.schedule(id, closing(auction));
+                }
+            }
+        }
+        status == ACCEPTED ? this->stats.accepted++ : this->stats.rejected[status]++;
+        return status;
+    }
+
+    /**
+     * @brief Finds an auction, its end is resolved first.
+     * @return The auction, nullptr if it was never opened
+     */
+    const AuctionState *find(uint32_t id, int64_t now)
+    {
+        if (id >= this->auctions.size() || !this->auctions[id].opened)
+        {
+            return nullptr;
+        }
+        live(id, now);
+        return &this->auctions[id];
+    }
+
+    /**
+     * @brief Moves an auction out of the engine, its number is free for open() or place().
+     * @return The auction
+     */
+    AuctionState take(uint32_t id)
+    {
+        AuctionState auction = this->auctions[id];
+        this->auctions[id] = AuctionState();
+        this->timers.cancel(id);
+        return auction;
+    }
+
+    /**
+     * @brief Places an auction moved out of another engine, its counters stay with the other engine.
+     */
+    void place(uint32_t id, const AuctionState &auction)
+    {
+        if (id >= this->auctions.size())
+        {
+            this->auctions.resize(std::max<size_t>(id + 1, this->auctions.size() * 2));
+        }
+        this->auctions[id] = auction;
+        if (auction.open)
+        {
+            this->timers.schedule(id, closing(auction));
+        }
+    }
+
+    /**
+     * @brief Ends every auction whose time is up, at most a tick of the timer wheel late.
+     */
+    void sweep(int64_t now)
+    {
+        this->timers.advance(now, [this, now](uint32_t id)
+                             {
+                                 if (live(id, now))
+                                 {
+                                     this->timers.schedule(id, closing(this->auctions[id]));
+                                 }
+                             });
+    }
+
+    EngineStats &getStats() { return this->stats; }
+    const EngineStats &getStats() const { return this->stats; }
+};
+
+/**
+ * @class EngineServer
+ * @brief Serves a matching engine over a local socket.
+ *
+ * @details
+ * Requests are lines, answered in order by a line each:
+ *
+ *     OPEN auction price duration timeout -> OK auction | ERR auction
+ *     BID auction bidder amount sequence  -> ACK sequence price | REJ sequence reason price
+ *     GET auction                         -> STATE auction price leader bids open|sold|unsold|unknown
+ *
+ * Prices are amounts of money, durations are seconds from the request. "GET /histogram HTTP/1.1" is answered by
+ * an HTTP response with the internal latency histogram, from the parsed request to the formatted answer, and the
+ * connection is closed, so the histogram can be fetched by curl from a TCP endpoint.
+ *
+ * Local clients can submit their requests through a shared-memory ring (ring.h) instead, the loop then polls the
+ * ring busily and looks at the sockets between its rounds.
+ *
+ * With a write-ahead log (wal.h) every opened auction and accepted bid is logged before it is answered. The answers
+ * of the sockets and of the ring are held while the log holds a group, and released once the group is committed.
+ */
+class EngineServer
+{
+private:
+    Endpoint endpoint;
+    MatchingEngine engine;
+    int listener = -1;
+    std::atomic<bool> stopped{false};
+    LatencyHistogram latency;                            // Internal latency of the requests in nanoseconds
+    BidRing ring;                                        // Requests of local clients, if created
+    std::unique_ptr<WriteAheadLog> wal;                  // Log of the accepted requests, if opened
+    std::vector<std::pair<uint32_t, RingResponse>> held; // Answers of the ring waiting for the log, with their client
+    int error = 0;                                       // errno of a failed log, which stopped the server
+
+    /**
+     * @brief Logs the state of an auction after a request, a failed log stops the server.
+     */
+    void persist(WalRecordType type, uint32_t id, int64_t now);
+
+    /**
+     * @brief Commits the log if it is due, or if it holds records and the server is idle, and releases the answers
+     *        of the ring, a failed log stops the server.
+     */
+    void settle(bool idle);
+
+    /**
+     * @brief Handles a request of the ring and answers it in the response slots of its client.
+     */
+    void handle(const RingRequest &request);
+
+    /**
+     * @brief Handles the requests waiting in the ring.
+     * @return Handled requests
+     */
+    int drain();
+
+public:
+    EngineServer(const Endpoint &endpoint, bool tiered, int64_t softClose = 0);
+    ~EngineServer();
+
+    /**
+     * @brief Starts listening on the endpoint.
+     * @return false on an error (errno is set)
+     */
+    bool open();
+
+    /**
+     * @brief Serves the connections until stop() is called.
+     */
+    void serve();
+
+    /**
+     * @brief Creates the shared-memory ring of the local clients, served next to the endpoint.
+     * @param name Name of the shared memory object, "/name".
+     * @param clients Clients that can join the ring.
+     * @return false on an error (errno is set)
+     */
+    bool openRing(const std::string &name, uint32_t clients = 64) { return this->ring.create(name, 4096, clients); }
+
+    /**
+     * @brief Opens the write-ahead log, the open auctions of the log are recovered into the engine first.
+     * @return false on an error (errno is set)
+     */
+    bool openLog(const WalConfig &config);
+
+    void stop() { this->stopped = true; }
+
+    /**
+     * @brief Handles a request line and appends its answer, the latency of the request is recorded.
+     * @param request The line without its end.
+     * @param answer Answers of the connection.
+     */
+    void handle(const char *request, std::string &answer);
+
+    /**
+     * @brief Writes the latency percentiles and the non-empty buckets of the histogram.
+     */
+    std::string histogram() const;
+
+    const LatencyHistogram &getLatency() const { return this->latency; }
+    const EngineStats &getStats() const { return this->engine.getStats(); }
+
+    /**
+     * @brief Counters of the write-ahead log, nullptr without it.
+     */
+    const WalStats *getLogStats() const;
+
+    /**
+     * @brief errno of the write-ahead log if it failed and stopped the server, 0 otherwise.
+     */
+    int getLogError() const { return this->error; }
+};
+
+#endif // ENGINE_H
@@ -0,0 +1,393 @@
+/**
+ * @file evolution.cpp
+ * @brief Evolutionary dynamics of the strategy mix of the auction model
+ * The batches of every generation run in a pool of forked worker processes, which is reused by all generations.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include "evolution.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+/**
+ * @struct BatchRequest
+ * @brief Batch of items sent to a worker, no items stop the worker.
+ */
+struct BatchRequest
+{
+    int32_t batch;  // Index of the batch in the generation
+    int32_t items;  // Number of items of the batch
+    int64_t seed;   // Seed of the batch
+    double mix[3];  // Strategy mix of the generation
+};
+
+/**
+ * @struct BatchReply
+ * @brief Payoffs of a batch returned by a worker.
+ */
+struct BatchReply
+{
+    int32_t batch;      // Index of the batch in the generation
+    int32_t wins[3];    // Units won by each strategy
+    int64_t bidders[3]; // Bidders of each strategy
+    double surplus[3];  // Surplus of the units won by each strategy
+};
+
+/**
+ * @brief Sends or receives a whole message over a socket.
+ * @return false if the peer is gone
+ */
+bool sendMessage(int socket, const void *message, size_t size)
+{
+    const char *data = (const char *)message;
+    while (size > 0)
+    {
+        ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool receiveMessage(int socket, void *message, size_t size)
+{
+    char *data = (char *)message;
+    while (size > 0)
+    {
+        ssize_t received = recv(socket, data, size, 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+/**
+ * @brief Main loop of a worker process, runs the requested batches until it is stopped.
+ *
+ * @param socket Socket connected to the parent.
+ * @param config Configuration of the batches, the requests set their items, seed and mix.
+ */
+void serve(int socket, AuctionConfig config)
+{
+    config.verbose = false;
+    config.recordBids = false;
+    BatchRequest request;
+    while (receiveMessage(socket, &request, sizeof(request)) && request.items > 0)
+    {
+        config.numberOfItems = request.items;
+        config.seed = request.seed;
+        copy(request.mix, request.mix + 3, config.mix);
+
+        AuctionSimulator simulator(config);
+        const AuctionResults &results = simulator.run();
+        BatchReply reply = {};
+        reply.batch = request.batch;
+        for (const ItemResult &item : results.items)
+        {
+            reply.bidders[AGENT] += item.agents;
+            reply.bidders[RATCHET] += item.ratchets;
+            reply.bidders[SNIPER] += item.snipers;
+            for (int strategy = AGENT; strategy <= SNIPER; strategy++)
+            {
+                reply.wins[strategy] += item.unitsWon[strategy + 1];
+            }
+        }
+        for (int strategy = AGENT; strategy <= SNIPER; strategy++)
+        {
+            reply.surplus[strategy] = results.surplus[strategy + 1];
+        }
+        if (!sendMessage(socket, &reply, sizeof(reply)))
+        {
+            break;
+        }
+    }
+    close(socket);
+}
+
+/**
+ * @class WorkerPool
+ * @brief Forked worker processes, each runs one batch at a time.
+ */
+class WorkerPool
+{
+private:
+    vector<pid_t> processes;
+    vector<int> sockets; // Socket of the parent connected to every worker
+
+public:
+    /**
+     * @brief Forks the workers.
+     * @param count Number of workers.
+     * @param config Configuration of the batches.
+     * @return false if a worker could not be started
+     */
+    bool start(int count, const AuctionConfig &config)
+    {
+        // Buffered output would be written again by every worker
+        fflush(nullptr);
+        for (int i = 0; i < count; i++)
+        {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+            {
+                perror("socketpair");
+                return false;
+            }
+            pid_t process = fork();
+            if (process < 0)
+            {
+                perror("fork");
+                close(pair[0]);
+                close(pair[1]);
+                return false;
+            }
+            if (process == 0)
+            {
+                // The worker keeps only its own socket, so the others see the parent exit
+                for (int socket : this->sockets)
+                {
+                    close(socket);
+                }
+                close(pair[0]);
+                serve(pair[1], config);
+                _exit(EXIT_SUCCESS);
+            }
+            close(pair[1]);
+            this->processes.push_back(process);
+            this->sockets.push_back(pair[0]);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Runs the batches on the workers, a worker gets the next batch as soon as it returns the previous one.
+     * @param requests The batches.
+     * @param replies Payoffs of the batches in the order of the requests.
+     * @return false if a worker was lost
+     */
+    bool run(const vector<BatchRequest> &requests, vector<BatchReply> &replies)
+    {
+        replies.resize(requests.size());
+        size_t next = 0;
+        size_t pending = 0;
+        vector<pollfd> ready(this->sockets.size());
+        for (size_t worker = 0; worker < this->sockets.size(); worker++)
+        {
+            ready[worker] = {this->sockets[worker], POLLIN, 0};
+            if (next < requests.size())
+            {
+                if (!sendMessage(this->sockets[worker], &requests[next++], sizeof(BatchRequest)))
+                {
+                    return false;
+                }
+                pending++;
+            }
+        }
+
+        while (pending > 0)
+        {
+            if (poll(ready.data(), ready.size(), -1) < 0)
+            {
+                perror("poll");
+                return false;
+            }
+            for (pollfd &worker : ready)
+            {
+                if (worker.revents == 0)
+                {
+                    continue;
+                }
+                BatchReply reply;
+                if (!receiveMessage(worker.fd, &reply, sizeof(reply)))
+                {
+                    return false;
+                }
+                replies[reply.batch] = reply;
+                pending--;
+                if (next < requests.size())
+                {
+                    if (!sendMessage(worker.fd, &requests[next++], sizeof(BatchRequest)))
+                    {
+                        return false;
+                    }
+                    pending++;
+                }
+            }
+        }
+        return true;
+    }
+
+    ~WorkerPool()
+    {
+        BatchRequest stop = {};
+        for (int socket : this->sockets)
+        {
+            sendMessage(socket, &stop, sizeof(stop));
+            close(socket);
+        }
+        for (pid_t process : this->processes)
+        {
+            waitpid(process, nullptr, 0);
+        }
+    }
+};
+
+const double DEGENERATE = -1; // Change returned by replicate when the payoffs give no direction
+
+/**
+ * @brief Updates the mix by the discrete replicator equation x_i' = x_i (1 + step (f_i / f - 1)).
+ * Payoffs are shifted to be non-negative, the equation needs a positive mean payoff f. Shares below the extinction
+ * threshold die out.
+ *
+ * @param mix The mix, replaced by the next one.
+ * @param payoff Mean payoff per bidder of each strategy.
+ * @param config Parameters of the update.
+ *
+ * @return Largest change of a share, DEGENERATE if the mean payoff is not positive and the mix was kept
+ */
+double replicate(double mix[3], const double payoff[3], const EvolutionConfig &config)
+{
+    double shift = 0;
+    for (int strategy = AGENT; strategy <= SNIPER; strategy++)
+    {
+        if (mix[strategy] > 0)
+        {
+            shift = max(shift, -payoff[strategy]);
+        }
+    }
+    double mean = 0;
+    for (int strategy = AGENT; strategy <= SNIPER; strategy++)
+    {
+        mean += mix[strategy] * (payoff[strategy] + shift);
+    }
+    if (mean <= 0)
+    {
+        return DEGENERATE;
+    }
+
+    double next[3];
+    double total = 0;
+    for (int strategy = AGENT; strategy <= SNIPER; strategy++)
+    {
+        next[strategy] = mix[strategy] * (1 + config.step * ((payoff[strategy] + shift) / mean - 1));
+        if (next[strategy] < config.extinction)
+        {
+            next[strategy] = 0;
+        }
+        total += next[strategy];
+    }
+    double change = 0;
+    for (int strategy = AGENT; strategy <= SNIPER; strategy++)
+    {
+        next[strategy] /= total;
+        change = max(change, fabs(next[strategy] - mix[strategy]));
+        mix[strategy] = next[strategy];
+    }
+    return change;
+}
+
+} // namespace
+
+const EvolutionResults &EvolutionSimulator::run()
+{
+    this->results = EvolutionResults();
+    AuctionConfig auction = this->config.auction;
+    auction.learners = 0;
+    auction.numberOfItems = max(auction.numberOfItems, 1);
+
+    double mix[3];
+    double total = auction.mix[AGENT] + auction.mix[RATCHET] + auction.mix[SNIPER];
+    for (int strategy = AGENT; strategy <= SNIPER; strategy++)
+    {
+        mix[strategy] = auction.mix[strategy] / total;
+    }
+
+    int batchItems = max(this->config.batchItems, 1);
+    int batches = (auction.numberOfItems + batchItems - 1) / batchItems;
+    WorkerPool pool;
+    if (!pool.start(clamp(this->config.workers, 1, batches), auction))
+    {
+        this->results.failed = true;
+        return this->results;
+    }
+
+    vector<BatchRequest> requests(batches);
+    vector<BatchReply> replies;
+    int stable = 0;
+    for (int number = 0; number < this->config.generations; number++)
+    {
+        auto start = chrono::steady_clock::now();
+        for (int batch = 0; batch < batches; batch++)
+        {
+            BatchRequest &request = requests[batch];
+            request.batch = batch;
+            request.items = min(batchItems, auction.numberOfItems - batch * batchItems);
+            request.seed = auction.seed + (int64_t)number * batches + batch;
+            copy(mix, mix + 3, request.mix);
+        }
+        if (!pool.run(requests, replies))
+        {
+            this->results.failed = true;
+            break;
+        }
+
+        // Sums in the batch order, the payoffs do not depend on the order the workers finished in
+        Generation generation = {};
+        generation.number = number;
+        double surplus[3] = {0, 0, 0};
+        for (const BatchReply &reply : replies)
+        {
+            for (int strategy = AGENT; strategy <= SNIPER; strategy++)
+            {
+                generation.bidders[strategy] += reply.bidders[strategy];
+                generation.wins[strategy] += reply.wins[strategy];
+                surplus[strategy] += reply.surplus[strategy];
+            }
+        }
+        for (int strategy = AGENT; strategy <= SNIPER; strategy++)
+        {
+            generation.mix[strategy] = mix[strategy];
+            generation.payoff[strategy] = generation.bidders[strategy] > 0 ? surplus[strategy] / generation.bidders[strategy] : 0;
+        }
+
+        generation.change = replicate(mix, generation.payoff, this->config);
+        generation.degenerate = generation.change == DEGENERATE;
+        generation.change = max(generation.change, 0.0);
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        generation.seconds = elapsed.count();
+        this->results.trajectory.push_back(generation);
+
+        // A generation without payoffs kept the mix because nothing pushed it, not because it is stable
+        stable = !generation.degenerate && generation.change < this->config.tolerance ? stable + 1 : 0;
+        if (stable >= this->config.stableGenerations)
+        {
+            this->results.converged = true;
+            break;
+        }
+    }
+    copy(mix, mix + 3, this->results.mix);
+    return this->results;
+}
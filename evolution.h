@@ -0,0 +1,91 @@
+/**
+ * @file evolution.h
+ * @brief Evolutionary dynamics of the strategy mix of the auction model
+ * Every generation runs a batch of items with the current mix of the agent, ratchet and sniper strategies and
+ * updates the mix by the replicator equation, strategies earning more surplus per bidder grow.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef EVOLUTION_H
+#define EVOLUTION_H
+
+#include <cstdint>
+#include <vector>
+#include "auction.h"
+
+/**
+ * @struct EvolutionConfig
+ * @brief Parameters of an evolution run.
+ */
+struct EvolutionConfig
+{
+    AuctionConfig auction;     // Items of every generation (numberOfItems), their format and the initial mix,
+                               // learning bidders are not part of the mix and are disabled
+    int generations = 50;      // Maximal number of generations
+    int workers = 1;           // Worker processes running the batches of a generation
+    int batchItems = 250;      // Items of a batch, a generation is split into batches dealt to the workers
+    double step = 0.5;         // Step of the replicator update, 1 is the discrete replicator equation
+    double tolerance = 0.005;  // The mix converged when no share moves more than this ...
+    int stableGenerations = 3; // ... in this many consecutive generations
+    double extinction = 0.001; // Shares below this die out
+};
+
+/**
+ * @struct Generation
+ * @brief Strategy mix of a generation and the payoffs it earned.
+ */
+struct Generation
+{
+    int number;         // Number of the generation, the first is 0
+    double mix[3];      // Shares of the agent, ratchet and sniper strategies
+    double payoff[3];   // Mean surplus (valuation - price) per bidder of each strategy
+    int64_t bidders[3]; // Bidders of each strategy over all items of the generation
+    int32_t wins[3];    // Units won by each strategy
+    double change;      // Largest change of a share by the update after the generation
+    bool degenerate;    // Flag if no strategy earned a positive payoff, the mix was kept and the generation does not count as stable
+    double seconds;     // Wall-clock time of the generation
+};
+
+/**
+ * @struct EvolutionResults
+ * @brief Results of an evolution run.
+ */
+struct EvolutionResults
+{
+    std::vector<Generation> trajectory; // Every generation in order
+    double mix[3] = {0};                // Mix after the last update
+    bool converged = false;             // Flag if the mix converged before the generation limit
+    bool failed = false;                // Flag if a worker process was lost, the trajectory ends before it
+};
+
+/**
+ * @class EvolutionSimulator
+ * @brief Runs the replicator dynamics of the strategy mix.
+ *
+ * @details
+ * SIMLIB keeps a single process-wide calendar, so the batches of a generation run in forked worker processes.
+ * The workers are started once and reused by all generations, each receives the mix and the seed of a batch
+ * and returns its payoffs. Batch b of generation g always uses the seed seed + g * batches + b and the payoffs are
+ * summed in batch order, so the trajectory does not depend on the number of workers.
+ */
+class EvolutionSimulator
+{
+private:
+    EvolutionConfig config;
+    EvolutionResults results;
+
+public:
+    explicit EvolutionSimulator(const EvolutionConfig &config) : config(config) {}
+
+    /**
+     * @brief Runs the generations until the mix converges or the generation limit is reached.
+     * @return Results of the run.
+     */
+    const EvolutionResults &run();
+
+    const EvolutionConfig &getConfig() const { return this->config; }
+    const EvolutionResults &getResults() const { return this->results; }
+};
+
+#endif // EVOLUTION_H
@@ -0,0 +1,120 @@
+/**
+ * @file histogram.h
+ * @brief Log-linear latency histogram
+ * Every power of two is split into 128 linear buckets, so a recorded value is kept with a relative error below 1 %
+ * over the whole range from nanoseconds to minutes in a fixed array, and recording a value costs a few instructions.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+/**
+ * @class LatencyHistogram
+ * @brief Histogram of latencies in nanoseconds.
+ */
+class LatencyHistogram
+{
+public:
+    static const int SUB_BITS = 7;                                // Bits of the linear part of a bucket
+    static const int SUB_BUCKETS = 1 << SUB_BITS;                 // Linear buckets of a power of two
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS; // Buckets covering all 64-bit values
+
+private:
+    std::array<uint64_t, BUCKETS> counts{}; // Values in every bucket
+    uint64_t total = 0;                     // Recorded values
+    uint64_t maximum = 0;                   // Largest recorded value
+    double sum = 0;                         // Sum of the recorded values
+
+public:
+    /**
+     * @brief Bucket of a value, values below 2 * SUB_BUCKETS have a bucket each.
+     */
+    static int bucket(uint64_t value)
+    {
+        if (value < 2 * SUB_BUCKETS)
+        {
+            return value;
+        }
+        int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return shift * SUB_BUCKETS + (int)(value >> shift);
+    }
+
+    /**
+     * @brief Lowest value of a bucket.
+     */
+    static uint64_t lowest(int bucket)
+    {
+        if (bucket < 2 * SUB_BUCKETS)
+        {
+            return bucket;
+        }
+        int shift = bucket / SUB_BUCKETS - 1;
+        return (uint64_t)(bucket - shift * SUB_BUCKETS) << shift;
+    }
+
+    /**
+     * @brief Highest value of a bucket.
+     */
+    static uint64_t highest(int bucket)
+    {
+        return bucket + 1 < BUCKETS ? lowest(bucket + 1) - 1 : UINT64_MAX;
+    }
+
+    void record(uint64_t value, uint64_t count = 1)
+    {
+        this->counts[bucket(value)] += count;
+        this->total += count;
+        this->maximum = std::max(this->maximum, value);
+        this->sum += (double)value * count;
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            this->counts[i] += other.counts[i];
+        }
+        this->total += other.total;
+        this->maximum = std::max(this->maximum, other.maximum);
+        this->sum += other.sum;
+    }
+
+    void clear() { *this = LatencyHistogram(); }
+
+    uint64_t count() const { return this->total; }
+    uint64_t max() const { return this->maximum; }
+    double mean() const { return this->total > 0 ? this->sum / this->total : 0; }
+    uint64_t bucketCount(int bucket) const { return this->counts[bucket]; }
+
+    /**
+     * @brief Value below which a share of the recorded values lies.
+     * @param percentile Percentile in (0, 100].
+     * @return Highest value of the bucket holding the percentile, capped by the largest recorded value
+     */
+    uint64_t percentile(double percentile) const
+    {
+        if (this->total == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>((uint64_t)(percentile / 100 * this->total + 0.5), 1);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            seen += this->counts[i];
+            if (seen >= rank)
+            {
+                return std::min(highest(i), this->maximum);
+            }
+        }
+        return this->maximum;
+    }
+};
+
+#endif // HISTOGRAM_H
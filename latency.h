@@ -0,0 +1,165 @@
+/**
+ * @file latency.h
+ * @brief Network latency of the bidders
+ * Every bidder connects over one latency class (broadband, mobile or a datacenter of a sniping service), the latency
+ * of a class follows an empirical histogram. Histogram bins and the classes themselves are drawn from alias tables,
+ * so a sample costs O(1) (two uniform numbers) regardless of the number of bins.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <vector>
+
+/**
+ * @class AliasTable
+ * @brief Walker's alias table of a discrete distribution, built by Vose's method in O(n).
+ */
+class AliasTable
+{
+private:
+    std::vector<double> probability; // Probability of keeping a column instead of taking its alias
+    std::vector<int> alias;          // Alias of every column
+
+public:
+    AliasTable() = default;
+
+    /**
+     * @brief Builds the table of a distribution.
+     * @param weights Non-negative weights of the outcomes, they do not need to sum to one.
+     */
+    explicit AliasTable(const std::vector<double> &weights) : probability(weights.size(), 1), alias(weights.size(), 0)
+    {
+        size_t count = weights.size();
+        double total = 0;
+        for (double weight : weights)
+        {
+            total += weight;
+        }
+
+        // Columns below the average are filled up by the columns above it
+        std::vector<double> scaled(count);
+        std::vector<int> small;
+        std::vector<int> large;
+        for (size_t i = 0; i < count; i++)
+        {
+            scaled[i] = weights[i] * count / total;
+            (scaled[i] < 1 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty())
+        {
+            int lower = small.back();
+            int upper = large.back();
+            small.pop_back();
+            this->probability[lower] = scaled[lower];
+            this->alias[lower] = upper;
+            scaled[upper] -= 1 - scaled[lower];
+            if (scaled[upper] < 1)
+            {
+                large.pop_back();
+                small.push_back(upper);
+            }
+        }
+
+        // Rounding leaves columns of full height
+        for (int column : small)
+        {
+            this->probability[column] = 1;
+        }
+        for (int column : large)
+        {
+            this->probability[column] = 1;
+        }
+    }
+
+    size_t size() const { return this->probability.size(); }
+
+    /**
+     * @brief Draws an outcome.
+     * @param uniform Uniform number in [0, 1), its integer part picks the column and the fraction decides the alias.
+     * @return Index of the outcome
+     */
+    int pick(double uniform) const
+    {
+        double column = uniform * this->probability.size();
+        int index = (int)column;
+        return column - index < this->probability[index] ? index : this->alias[index];
+    }
+};
+
+/**
+ * @struct LatencyBin
+ * @brief Bin of an empirical latency histogram, latencies are uniform within the bin.
+ */
+struct LatencyBin
+{
+    double lower;  // Lowest latency of the bin in seconds
+    double upper;  // Highest latency of the bin in seconds
+    double weight; // Share of the submissions falling into the bin
+};
+
+/**
+ * @class LatencyDistribution
+ * @brief Empirical latency histogram of a latency class.
+ */
+class LatencyDistribution
+{
+private:
+    std::vector<LatencyBin> bins;
+    AliasTable table;
+
+public:
+    LatencyDistribution() = default;
+
+    explicit LatencyDistribution(const std::vector<LatencyBin> &bins) : bins(bins)
+    {
+        std::vector<double> weights;
+        for (const LatencyBin &bin : bins)
+        {
+            weights.push_back(bin.weight);
+        }
+        this->table = AliasTable(weights);
+    }
+
+    /**
+     * @brief Draws a latency.
+     * @param bin Uniform number in [0, 1) picking the bin.
+     * @param offset Uniform number in [0, 1) picking the latency within the bin.
+     * @return Latency in seconds
+     */
+    double sample(double bin, double offset) const
+    {
+        const LatencyBin &picked = this->bins[this->table.pick(bin)];
+        return picked.lower + offset * (picked.upper - picked.lower);
+    }
+
+    double mean() const
+    {
+        double total = 0;
+        double weighted = 0;
+        for (const LatencyBin &bin : this->bins)
+        {
+            total += bin.weight;
+            weighted += bin.weight * (bin.lower + bin.upper) / 2;
+        }
+        return weighted / total;
+    }
+};
+
+/**
+ * @brief Empirical latency of a bid submission of each LatencyClass, from the click (or the request of the sniping
+ * service) until the bid is accepted by the auction site. Residential links have a long tail of retransmissions,
+ * mobile links add radio wake-ups and handovers.
+ */
+inline const std::vector<LatencyBin> LATENCY_BINS[3] = {
+    // Broadband
+    {{0.02, 0.05, 0.30}, {0.05, 0.1, 0.45}, {0.1, 0.2, 0.18}, {0.2, 0.5, 0.05}, {0.5, 2, 0.02}},
+    // Mobile
+    {{0.05, 0.1, 0.10}, {0.1, 0.2, 0.35}, {0.2, 0.4, 0.30}, {0.4, 1, 0.17}, {1, 3, 0.08}},
+    // Datacenter of a sniping service
+    {{0.002, 0.005, 0.40}, {0.005, 0.01, 0.45}, {0.01, 0.02, 0.12}, {0.02, 0.1, 0.03}},
+};
+
+#endif // LATENCY_H
@@ -0,0 +1,175 @@
+/**
+ * @file learning.h
+ * @brief Bidding policy of the learning bidders
+ * A Gaussian policy linear in the item features picks the bid shading and the entry time of every learning bidder,
+ * it is trained from the outcomes of the items by REINFORCE with a running baseline. The policy is evaluated and
+ * updated once per item for all its learning bidders, the batch is a structure of arrays.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef LEARNING_H
+#define LEARNING_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+const int POLICY_FEATURES = 3; // Bias, log of the valuation relative to the starting price, relative number of bidders
+
+/**
+ * @struct LearningBatch
+ * @brief Learning bidders of a single item, the policy fills their actions and the item their rewards.
+ */
+struct LearningBatch
+{
+    std::vector<double> features[POLICY_FEATURES]; // Features of every bidder
+    std::vector<double> noise[2];                   // Standard normal exploration noise of the shading and the timing
+    std::vector<double> sample[2];                  // Sampled pre-activation of the shading and the timing
+    std::vector<double> shading;                    // Bid limit relative to the valuation, in (0, 1)
+    std::vector<double> timing;                     // Entry time before the end relative to the duration, in (0, 1)
+    std::vector<double> valuation;                  // Valuation of every bidder
+    std::vector<double> reward;                     // Surplus relative to the valuation, 0 for a lost item
+
+    size_t size() const { return this->valuation.size(); }
+
+    void clear()
+    {
+        for (std::vector<double> &column : this->features)
+        {
+            column.clear();
+        }
+        for (int action = 0; action < 2; action++)
+        {
+            this->noise[action].clear();
+            this->sample[action].clear();
+        }
+        this->shading.clear();
+        this->timing.clear();
+        this->valuation.clear();
+        this->reward.clear();
+    }
+
+    /**
+     * @brief Adds a learning bidder, its actions are set by LearningPolicy::act.
+     *
+     * @param valuation Valuation of the bidder.
+     * @param startPrice Starting price of the item.
+     * @param competition Number of bidders of the item relative to the expected number.
+     * @param shadingNoise Standard normal noise of the shading.
+     * @param timingNoise Standard normal noise of the timing.
+     *
+     * @return Index of the bidder in the batch
+     */
+    int add(double valuation, double startPrice, double competition, double shadingNoise, double timingNoise)
+    {
+        this->features[0].push_back(1);
+        this->features[1].push_back(std::log(std::fmax(valuation, 0.01) / std::fmax(startPrice, 0.01)));
+        this->features[2].push_back(competition);
+        this->noise[0].push_back(shadingNoise);
+        this->noise[1].push_back(timingNoise);
+        this->valuation.push_back(valuation);
+        this->reward.push_back(0);
+        return this->valuation.size() - 1;
+    }
+};
+
+/**
+ * @class LearningPolicy
+ * @brief Gaussian policy over the shading and the timing, trained by REINFORCE.
+ */
+class LearningPolicy
+{
+private:
+    double weights[2][POLICY_FEATURES] = {{2, 0, 0}, {0, 0, 0}}; // Shading starts at 88 % of the valuation
+    double deviation = 0.3;                                      // Exploration noise of the pre-activations
+    double rate = 0.05;                                          // Learning rate
+    double baseline = 0;                                         // Running mean of the rewards
+    uint64_t updates = 0;                                        // Items the policy learned from
+
+    static double logistic(double x) { return 1 / (1 + std::exp(-x)); }
+
+public:
+    /**
+     * @brief Evaluates the policy for all bidders of a batch in one pass.
+     * @param batch The batch, its shading, timing and samples are overwritten.
+     */
+    void act(LearningBatch &batch) const
+    {
+        size_t count = batch.size();
+        batch.shading.resize(count);
+        batch.timing.resize(count);
+        for (int action = 0; action < 2; action++)
+        {
+            std::vector<double> &sample = batch.sample[action];
+            sample.assign(count, 0);
+            for (int feature = 0; feature < POLICY_FEATURES; feature++)
+            {
+                const double weight = this->weights[action][feature];
+                const double *values = batch.features[feature].data();
+                for (size_t i = 0; i < count; i++)
+                {
+                    sample[i] += weight * values[i];
+                }
+            }
+            const double *noise = batch.noise[action].data();
+            std::vector<double> &output = action == 0 ? batch.shading : batch.timing;
+            for (size_t i = 0; i < count; i++)
+            {
+                sample[i] += this->deviation * noise[i];
+                output[i] = logistic(sample[i]);
+            }
+        }
+    }
+
+    /**
+     * @brief Updates the policy from the rewards of a batch (REINFORCE with the running baseline).
+     * @param batch The batch with the rewards.
+     * @param timed Flag if the timing influenced the rewards, otherwise only the shading learns.
+     */
+    void learn(const LearningBatch &batch, bool timed)
+    {
+        size_t count = batch.size();
+        if (count == 0)
+        {
+            return;
+        }
+
+        // The gradient of the log-likelihood of a Gaussian sample is (sample - mean) / deviation^2 = noise / deviation
+        for (int action = 0; action < (timed ? 2 : 1); action++)
+        {
+            const double *noise = batch.noise[action].data();
+            for (int feature = 0; feature < POLICY_FEATURES; feature++)
+            {
+                const double *values = batch.features[feature].data();
+                double gradient = 0;
+                for (size_t i = 0; i < count; i++)
+                {
+                    gradient += (batch.reward[i] - this->baseline) * noise[i] * values[i];
+                }
+                this->weights[action][feature] += this->rate * gradient / (count * this->deviation);
+            }
+        }
+        double mean = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            mean += batch.reward[i];
+        }
+        this->baseline += 0.01 * (mean / count - this->baseline);
+        this->updates++;
+    }
+
+    /**
+     * @brief Weights of the policy, the shading weights followed by the timing weights and the reward baseline.
+     */
+    std::vector<double> parameters() const
+    {
+        std::vector<double> values(&this->weights[0][0], &this->weights[0][0] + 2 * POLICY_FEATURES);
+        values.push_back(this->baseline);
+        return values;
+    }
+
+    uint64_t getUpdates() const { return this->updates; }
+};
+
+#endif // LEARNING_H
@@ -0,0 +1,551 @@
+/**
+ * @file loadgen.cpp
+ * @brief Load generator replaying the simulated bids to a bid ingestion service
+ * Every connection runs in its own thread and sleeps until the scheduled time of its next bid on the monotonic
+ * clock, the threads keep their own histograms, which are merged when the replay ends.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include "loadgen.h"
+#include "pacer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+
+bool sendAll(int socket, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+/**
+ * @brief Appends the available bytes of a socket to a buffer, waits until some are available.
+ * @return false if the peer is gone
+ */
+bool receiveSome(int socket, string &buffer)
+{
+    char data[4096];
+    ssize_t received = recv(socket, data, sizeof(data), 0);
+    if (received <= 0)
+    {
+        return false;
+    }
+    buffer.append(data, received);
+    return true;
+}
+
+/**
+ * @brief Finds a complete HTTP message at the start of a buffer.
+ * @param buffer Received bytes.
+ * @param status Status code of a response, unchanged for a request.
+ * @return Length of the message including its body, 0 if it is not complete yet
+ */
+size_t httpMessage(const string &buffer, int &status)
+{
+    size_t headerEnd = buffer.find("\r\n\r\n");
+    if (headerEnd == string::npos)
+    {
+        return 0;
+    }
+    size_t bodyLength = 0;
+    for (size_t line = buffer.find("\r\n") + 2; line < headerEnd; line = buffer.find("\r\n", line) + 2)
+    {
+        if (strncasecmp(buffer.c_str() + line, "Content-Length:", 15) == 0)
+        {
+            bodyLength = strtoul(buffer.c_str() + line + 15, nullptr, 10);
+        }
+    }
+    if (buffer.size() < headerEnd + 4 + bodyLength)
+    {
+        return 0;
+    }
+    if (buffer.compare(0, 5, "HTTP/") == 0)
+    {
+        const char *code = strchr(buffer.c_str(), ' ');
+        status = code ? atoi(code + 1) : 0;
+    }
+    return headerEnd + 4 + bodyLength;
+}
+
+/**
+ * @class Sender
+ * @brief A connection of the load generator, sends a bid and waits for its acknowledgement.
+ */
+class Sender
+{
+private:
+    const Endpoint &endpoint;
+    int socket = -1;
+    string buffer; // Received bytes not consumed yet
+
+public:
+    LoadResults results; // Results of the bids of the connection
+
+    explicit Sender(const Endpoint &endpoint) : endpoint(endpoint) {}
+    Sender(const Sender &) = delete;
+    ~Sender()
+    {
+        if (this->socket >= 0)
+        {
+            close(this->socket);
+        }
+    }
+
+    bool open()
+    {
+        this->socket = this->endpoint.connect();
+        return this->socket >= 0;
+    }
+
+    /**
+     * @brief Opens an item on the live engine and waits for the answer.
+     * @param item The item.
+     * @param duration Wall-clock seconds until the end of the item.
+     * @return false if the connection was lost
+     */
+    bool list(const ItemResult &item, double duration)
+    {
+        char request[128];
+        int length = snprintf(request, sizeof(request), "OPEN %d %.2f %.6f\n", item.itemNumber, item.startPrice, duration);
+        size_t end;
+        if (!sendAll(this->socket, request, length))
+        {
+            return false;
+        }
+        while ((end = this->buffer.find('\n')) == string::npos)
+        {
+            if (!receiveSome(this->socket, this->buffer))
+            {
+                return false;
+            }
+        }
+        this->buffer.erase(0, end + 1);
+        return true;
+    }
+
+    /**
+     * @brief Sends a bid and waits for the response.
+     * @param bid The bid.
+     * @param sequence Sequence number of the bid in the replay.
+     * @param acknowledged Flag if the service accepted the bid.
+     * @return false if the connection was lost
+     */
+    bool send(const BidEvent &bid, int64_t sequence, bool &acknowledged)
+    {
+        char body[256];
+        char request[512];
+        int length;
+        if (this->endpoint.transport == HTTP_TRANSPORT)
+        {
+            int bodyLength = snprintf(body, sizeof(body), "{\"item\":%d,\"bidder\":%llu,\"strategy\":%d,\"amount\":%.2f,\"sequence\":%lld}",
+                                      bid.itemNumber, (unsigned long long)bid.bidderId, bid.bidder, bid.amount, (long long)sequence);
+            length = snprintf(request, sizeof(request), "POST %s HTTP/1.1\r\nHost: %s:%d\r\nContent-Type: application/json\r\nContent-Length: %d\r\n\r\n%s",
+                              this->endpoint.path.c_str(), this->endpoint.host.c_str(), this->endpoint.port, bodyLength, body);
+        }
+        else
+        {
+            length = snprintf(request, sizeof(request), "BID %d %llu %.2f %lld\n", bid.itemNumber, (unsigned long long)bid.bidderId,
+                              bid.amount, (long long)sequence);
+        }
+        if (!sendAll(this->socket, request, length))
+        {
+            return false;
+        }
+
+        if (this->endpoint.transport == HTTP_TRANSPORT)
+        {
+            int status = 0;
+            size_t response;
+            while ((response = httpMessage(this->buffer, status)) == 0)
+            {
+                if (!receiveSome(this->socket, this->buffer))
+                {
+                    return false;
+                }
+            }
+            this->buffer.erase(0, response);
+            acknowledged = status >= 200 && status < 300;
+            return true;
+        }
+
+        size_t end;
+        while ((end = this->buffer.find('\n')) == string::npos)
+        {
+            if (!receiveSome(this->socket, this->buffer))
+            {
+                return false;
+            }
+        }
+        long long acked = -1;
+        acknowledged = sscanf(this->buffer.c_str(), "ACK %lld", &acked) == 1 && acked == sequence;
+        this->buffer.erase(0, end + 1);
+        return true;
+    }
+};
+
+/**
+ * @brief Opens a socket of a host and port, connected or listening.
+ * @return The socket, -1 on an error
+ */
+int openInet(const Endpoint &endpoint, bool listening)
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo *addresses;
+    string port = to_string(endpoint.port);
+    if (getaddrinfo(endpoint.host.c_str(), port.c_str(), &hints, &addresses) != 0)
+    {
+        errno = EADDRNOTAVAIL;
+        return -1;
+    }
+
+    int socket = -1;
+    for (addrinfo *address = addresses; address && socket < 0; address = address->ai_next)
+    {
+        socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (socket < 0)
+        {
+            continue;
+        }
+        int on = 1;
+        bool ready;
+        if (listening)
+        {
+            setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            ready = bind(socket, address->ai_addr, address->ai_addrlen) == 0 && ::listen(socket, SOMAXCONN) == 0;
+        }
+        else
+        {
+            // Bids are small and latency bound, they must not wait for Nagle's algorithm
+            setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            ready = ::connect(socket, address->ai_addr, address->ai_addrlen) == 0;
+        }
+        if (!ready)
+        {
+            int error = errno;
+            close(socket);
+            socket = -1;
+            errno = error;
+        }
+    }
+    freeaddrinfo(addresses);
+    return socket;
+}
+
+} // namespace
+
+bool Endpoint::parse(const string &text, Endpoint &endpoint)
+{
+    endpoint = Endpoint();
+    string address;
+    if (text.compare(0, 5, "unix:") == 0)
+    {
+        endpoint.transport = UNIX_TRANSPORT;
+        endpoint.path = text.substr(5);
+        return !endpoint.path.empty() && endpoint.path.size() < sizeof(sockaddr_un::sun_path);
+    }
+    if (text.compare(0, 4, "tcp:") == 0)
+    {
+        endpoint.transport = TCP_TRANSPORT;
+        address = text.substr(4);
+    }
+    else if (text.compare(0, 7, "http://") == 0)
+    {
+        endpoint.transport = HTTP_TRANSPORT;
+        address = text.substr(7);
+        size_t slash = address.find('/');
+        endpoint.path = slash == string::npos ? "/" : address.substr(slash);
+        address = address.substr(0, slash);
+        endpoint.port = 80;
+    }
+    else
+    {
+        return false;
+    }
+
+    size_t colon = address.rfind(':');
+    if (colon != string::npos)
+    {
+        endpoint.port = atoi(address.c_str() + colon + 1);
+        address = address.substr(0, colon);
+    }
+    endpoint.host = address;
+    return !endpoint.host.empty() && endpoint.port > 0 && endpoint.port < 65536;
+}
+
+int Endpoint::connect() const
+{
+    if (this->transport != UNIX_TRANSPORT)
+    {
+        return openInet(*this, false);
+    }
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, this->path.c_str());
+    int socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket >= 0 && ::connect(socket, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        int error = errno;
+        close(socket);
+        socket = -1;
+        errno = error;
+    }
+    return socket;
+}
+
+int Endpoint::listen() const
+{
+    if (this->transport != UNIX_TRANSPORT)
+    {
+        return openInet(*this, true);
+    }
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, this->path.c_str());
+    unlink(this->path.c_str());
+    int socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket >= 0 && (bind(socket, (sockaddr *)&address, sizeof(address)) != 0 || ::listen(socket, SOMAXCONN) != 0))
+    {
+        int error = errno;
+        close(socket);
+        socket = -1;
+        errno = error;
+    }
+    return socket;
+}
+
+const LoadResults &LoadGenerator::replay(const vector<BidEvent> &bids, const vector<ItemResult> &items)
+{
+    this->results = LoadResults();
+
+    // The bids are reported in the order of the simulation, sorting only guards the schedule
+    vector<const BidEvent *> schedule;
+    for (const BidEvent &bid : bids)
+    {
+        schedule.push_back(&bid);
+    }
+    stable_sort(schedule.begin(), schedule.end(), [](const BidEvent *a, const BidEvent *b) { return a->time < b->time; });
+
+    // The bids of an item share a connection, so they arrive in order
+    int connections = max(this->config.connections, 1);
+    vector<vector<size_t>> lanes(connections);
+    for (size_t k = 0; k < schedule.size(); k++)
+    {
+        lanes[schedule[k]->itemNumber % connections].push_back(k);
+    }
+    vector<const ItemResult *> listings;
+    for (const ItemResult &item : items)
+    {
+        if (this->config.openItems)
+        {
+            listings.resize(max<size_t>(listings.size(), item.itemNumber + 1));
+            listings[item.itemNumber] = &item;
+        }
+    }
+
+    vector<unique_ptr<Sender>> senders;
+    for (int i = 0; i < connections; i++)
+    {
+        senders.push_back(make_unique<Sender>(this->config.endpoint));
+        if (!senders.back()->open())
+        {
+            this->results.error = string("cannot connect to the endpoint: ") + strerror(errno);
+            return this->results;
+        }
+    }
+    if (schedule.empty())
+    {
+        return this->results;
+    }
+
+    double first = schedule.front()->time;
+    double nanoseconds = 1e9 / this->config.speedup;
+    int64_t start = Pacer::now() + 1000000;
+    Pacer pacer;
+    vector<thread> threads;
+    for (int i = 0; i < connections; i++)
+    {
+        threads.emplace_back([&, i]()
+        {
+            Sender &sender = *senders[i];
+            LoadResults &own = sender.results;
+            const vector<size_t> &lane = lanes[i];
+            for (size_t position = 0; position < lane.size(); position++)
+            {
+                size_t k = lane[position];
+                const BidEvent &bid = *schedule[k];
+                int64_t scheduled = start + (int64_t)((bid.time - first) * nanoseconds);
+                pacer.sleepUntil(scheduled);
+                int64_t sent = Pacer::now();
+                own.lag.record(max<int64_t>(sent - scheduled, 0));
+
+                // The item is opened right before its first bid, for the rest of its simulated duration
+                bool acknowledged = false;
+                bool connected = true;
+                if ((size_t)bid.itemNumber < listings.size() && listings[bid.itemNumber])
+                {
+                    const ItemResult &item = *listings[bid.itemNumber];
+                    connected = sender.list(item, (item.endTime - bid.time) / this->config.speedup);
+                    listings[bid.itemNumber] = nullptr;
+                }
+                if (!connected || !sender.send(bid, k, acknowledged))
+                {
+                    // The bids left for the lost connection are never sent
+                    own.failed += lane.size() - position;
+                    own.sent++;
+                    break;
+                }
+                int64_t done = Pacer::now();
+                own.sent++;
+                own.acknowledged += acknowledged;
+                own.failed += !acknowledged;
+                own.corrected.record(done - scheduled);
+                own.uncorrected.record(done - sent);
+            }
+        });
+    }
+    for (thread &worker : threads)
+    {
+        worker.join();
+    }
+
+    for (const unique_ptr<Sender> &sender : senders)
+    {
+        const LoadResults &own = sender->results;
+        this->results.sent += own.sent;
+        this->results.acknowledged += own.acknowledged;
+        this->results.failed += own.failed;
+        this->results.corrected.merge(own.corrected);
+        this->results.uncorrected.merge(own.uncorrected);
+        this->results.lag.merge(own.lag);
+    }
+    this->results.seconds = (Pacer::now() - start) / 1e9;
+    this->results.scheduled = (schedule.back()->time - first) / this->config.speedup;
+    return this->results;
+}
+
+StubServer::~StubServer()
+{
+    if (this->listener >= 0)
+    {
+        close(this->listener);
+        if (this->endpoint.transport == UNIX_TRANSPORT)
+        {
+            unlink(this->endpoint.path.c_str());
+        }
+    }
+}
+
+bool StubServer::open()
+{
+    this->listener = this->endpoint.listen();
+    return this->listener >= 0;
+}
+
+void StubServer::serve()
+{
+    vector<pollfd> sockets = {{this->listener, POLLIN, 0}};
+    vector<string> buffers = {""};
+    while (!this->stopped)
+    {
+        // Wakes up regularly to notice stop()
+        if (poll(sockets.data(), sockets.size(), 100) <= 0)
+        {
+            continue;
+        }
+        if (sockets[0].revents & POLLIN)
+        {
+            int client = accept(this->listener, nullptr, nullptr);
+            if (client >= 0)
+            {
+                int on = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                sockets.push_back({client, POLLIN, 0});
+                buffers.push_back("");
+            }
+        }
+
+        for (size_t i = 1; i < sockets.size(); i++)
+        {
+            if (!sockets[i].revents)
+            {
+                continue;
+            }
+            string &buffer = buffers[i];
+            bool open = receiveSome(sockets[i].fd, buffer);
+
+            // Answers every complete request, pipelined requests are answered in order
+            string responses;
+            if (this->endpoint.transport == HTTP_TRANSPORT)
+            {
+                int status = 0;
+                size_t request;
+                while ((request = httpMessage(buffer, status)) > 0)
+                {
+                    bool bid = buffer.compare(0, 5, "POST ") == 0;
+                    responses += bid ? "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nOK" : "HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n";
+                    this->acknowledged += bid;
+                    buffer.erase(0, request);
+                }
+            }
+            else
+            {
+                size_t end;
+                while ((end = buffer.find('\n')) != string::npos)
+                {
+                    size_t space = buffer.rfind(' ', end);
+                    if (buffer.compare(0, 4, "BID ") == 0 && space != string::npos)
+                    {
+                        responses += "ACK " + buffer.substr(space + 1, end - space - 1) + "\n";
+                        this->acknowledged++;
+                    }
+                    else
+                    {
+                        responses += "ERR\n";
+                    }
+                    buffer.erase(0, end + 1);
+                }
+            }
+
+            if (!open || !sendAll(sockets[i].fd, responses.data(), responses.size()))
+            {
+                close(sockets[i].fd);
+                sockets.erase(sockets.begin() + i);
+                buffers.erase(buffers.begin() + i);
+                i--;
+            }
+        }
+    }
+    for (size_t i = 1; i < sockets.size(); i++)
+    {
+        close(sockets[i].fd);
+    }
+}
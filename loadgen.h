@@ -0,0 +1,157 @@
+/**
+ * @file loadgen.h
+ * @brief Load generator replaying the simulated bids to a bid ingestion service
+ * The bids of a simulation run are sent at their simulated times, paced by the wall clock with a speed-up factor,
+ * over a UNIX socket, TCP or HTTP to a local endpoint. The latency of every bid is measured until it is acknowledged.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "auction.h"
+#include "histogram.h"
+
+/**
+ * @enum Transport
+ * @brief Protocol of an endpoint.
+ */
+enum Transport
+{
+    UNIX_TRANSPORT, // Lines over a UNIX stream socket
+    TCP_TRANSPORT,  // Lines over TCP
+    HTTP_TRANSPORT  // HTTP/1.1 POST requests over a keep-alive TCP connection
+};
+
+/**
+ * @struct Endpoint
+ * @brief Address of a bid ingestion service.
+ *
+ * @details
+ * Written as unix:/path/to/socket, tcp:host:port or http://host:port/path. Over a UNIX socket and TCP every bid
+ * is the line "BID item bidder amount sequence" answered by the line "ACK sequence" (anything else refuses it),
+ * over HTTP the bid is a JSON object posted to the path and any 2xx response acknowledges it.
+ */
+struct Endpoint
+{
+    Transport transport = UNIX_TRANSPORT;
+    std::string path; // Path of the UNIX socket, target of the HTTP requests
+    std::string host; // Host of TCP and HTTP
+    int port = 0;     // Port of TCP and HTTP
+
+    /**
+     * @brief Parses an endpoint.
+     * @param text The endpoint as written on the command line.
+     * @param endpoint The parsed endpoint.
+     * @return false if the endpoint is malformed
+     */
+    static bool parse(const std::string &text, Endpoint &endpoint);
+
+    /**
+     * @brief Opens a connection to the endpoint.
+     * @return The connected socket, -1 on an error (errno is set)
+     */
+    int connect() const;
+
+    /**
+     * @brief Opens a socket listening on the endpoint, a stale UNIX socket file is replaced.
+     * @return The listening socket, -1 on an error (errno is set)
+     */
+    int listen() const;
+};
+
+/**
+ * @struct LoadConfig
+ * @brief Parameters of a replay.
+ */
+struct LoadConfig
+{
+    Endpoint endpoint;
+    double speedup = 1;     // Simulated seconds replayed in a second of the wall clock
+    int connections = 1;    // Connections, each sends the bids of every connections-th item and waits for their answers
+    bool openItems = false; // Opens every item before its first bid, for the live engine (engine.h)
+};
+
+/**
+ * @struct LoadResults
+ * @brief Results of a replay.
+ *
+ * @details
+ * A connection waits for the acknowledgement of a bid before it sends the next one, so a slow response delays
+ * the following bids and a latency measured from the send would hide the waiting (coordinated omission). The
+ * corrected latency is measured from the time the bid was scheduled to be sent instead.
+ */
+struct LoadResults
+{
+    int64_t sent = 0;               // Bids sent
+    int64_t acknowledged = 0;       // Bids acknowledged
+    int64_t failed = 0;             // Bids refused by the service or lost with a connection
+    double seconds = 0;             // Wall-clock time of the replay
+    double scheduled = 0;           // Wall-clock time of the schedule, the simulated span over the speed-up
+    LatencyHistogram corrected;     // Latency from the scheduled send to the acknowledgement, in nanoseconds
+    LatencyHistogram uncorrected;   // Latency from the actual send to the acknowledgement, in nanoseconds
+    LatencyHistogram lag;           // Delay of the actual send behind the schedule, in nanoseconds
+    std::string error;              // Reason the replay could not start, empty on success
+};
+
+/**
+ * @class LoadGenerator
+ * @brief Replays bids to an endpoint.
+ */
+class LoadGenerator
+{
+private:
+    LoadConfig config;
+    LoadResults results;
+
+public:
+    explicit LoadGenerator(const LoadConfig &config) : config(config) {}
+
+    /**
+     * @brief Sends the bids at their simulated times, the first bid is sent right after all connections are open.
+     * @param bids Bids of a simulation run.
+     * @param items Items of the run, opened on the endpoint if LoadConfig::openItems is set.
+     * @return Results of the replay.
+     */
+    const LoadResults &replay(const std::vector<BidEvent> &bids, const std::vector<ItemResult> &items = {});
+
+    const LoadResults &getResults() const { return this->results; }
+};
+
+/**
+ * @class StubServer
+ * @brief Bid ingestion service acknowledging every bid, for testing the load generator.
+ */
+class StubServer
+{
+private:
+    Endpoint endpoint;
+    int listener = -1;
+    std::atomic<bool> stopped{false};
+    std::atomic<int64_t> acknowledged{0};
+
+public:
+    explicit StubServer(const Endpoint &endpoint) : endpoint(endpoint) {}
+    ~StubServer();
+
+    /**
+     * @brief Starts listening on the endpoint.
+     * @return false on an error (errno is set)
+     */
+    bool open();
+
+    /**
+     * @brief Serves the connections until stop() is called.
+     */
+    void serve();
+
+    void stop() { this->stopped = true; }
+    int64_t getAcknowledged() const { return this->acknowledged; }
+};
+
+#endif // LOADGEN_H
@@ -0,0 +1,1328 @@
+/**
+ * @file marketplace.cpp
+ * @brief Marketplace simulation with persistent bidders across concurrent auction items
+ * Items and bidders are logical processes exchanging timestamped messages, the model runs sequentially or
+ * partitioned across threads, either in conservative synchronization windows or optimistically (Time Warp).
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include "marketplace.h"
+#include "currency.h"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+const double ARBITRATION_DELAY = 0.1;  // Time for a message of a bidder to reach an item
+const double NOTIFICATION_DELAY = 0.2; // Minimal time before a bidder reacts to a message of an item
+const uint32_t NOBODY = UINT32_MAX;    // No bidder or no item
+const int SUBSTITUTE_TRIES = 4;        // Random draws when looking for a substitute item
+const double RATCHET_REACTION = 0.3;   // Probability that a ratchet bidder reacts to a price change
+const double SNIPE_LEAD = 1;           // Snipers wake up this long before the end of the item
+const Cents MINIMAL_BUDGET = 100;      // Bidders with less uncommitted budget stop watching new items
+const uint8_t ANTI = 0x80;             // Kind flag of an anti-message, it cancels a message of a rolled back event
+const int GVT_INTERVAL = 4096;         // Events an optimistic partition processes between GVT rounds
+const int DELIVERY_INTERVAL = 64;      // Events an optimistic partition processes between taking its messages
+
+/**
+ * @brief Kind of a message between the logical processes.
+ */
+enum EventKind : uint8_t
+{
+    ARRIVE,   // Bidder enters the market
+    WAKE,     // Agent or sniper starts bidding on a watched item
+    CLOSE,    // Item ends
+    WATCH,    // Bidder starts watching an item
+    UNWATCH,  // Bidder stops watching an item
+    BID,      // Bid of a bidder on an item
+    PRICE,    // New price of a watched item
+    REJECTED, // Bid arrived after a higher price
+    CLOSED,   // Watched item ended
+};
+
+/**
+ * @struct MarketEvent
+ * @brief Timestamped message delivered to a logical process.
+ */
+struct MarketEvent
+{
+    double time;     // Delivery time
+    uint64_t key;    // Sender and its message counter, orders simultaneous messages independently of the execution
+    uint32_t target; // Receiving logical process
+    uint32_t source; // Sending logical process
+    Cents amount;    // Bid or price
+    uint32_t other;  // Leader of the item in notifications, the watched item in wake-ups
+    uint8_t kind;    // EventKind
+};
+
+/**
+ * @brief Orders the event queue, the earliest message with the lowest key is delivered first.
+ */
+struct LaterEvent
+{
+    bool operator()(const MarketEvent &a, const MarketEvent &b) const
+    {
+        return a.time > b.time || (a.time == b.time && a.key > b.key);
+    }
+};
+
+/**
+ * @brief Orders the pending messages of an optimistic partition, the earliest first.
+ */
+struct EarlierEvent
+{
+    bool operator()(const MarketEvent &a, const MarketEvent &b) const { return LaterEvent()(b, a); }
+};
+
+/**
+ * @brief Draws the next number of a random stream (splitmix64), every logical process owns a stream.
+ */
+uint64_t nextRandom(uint64_t &state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+double uniform(uint64_t &state)
+{
+    return (nextRandom(state) >> 11) * 0x1.0p-53;
+}
+
+double exponential(uint64_t &state, double mean)
+{
+    return -mean * log1p(-uniform(state));
+}
+
+double normal(uint64_t &state, double mean, double deviation)
+{
+    double radius = sqrt(-2 * log1p(-uniform(state)));
+    return mean + deviation * radius * cos(2 * M_PI * uniform(state));
+}
+
+/**
+ * @brief Seeds the random stream of a logical process.
+ */
+uint64_t streamSeed(long seed, uint64_t process)
+{
+    uint64_t state = (uint64_t)seed * 0xD1B54A32D192ED03ull ^ process;
+    nextRandom(state);
+    return state;
+}
+
+/**
+ * @struct Catalog
+ * @brief Static description of the items, bidders look up running items of their category in it.
+ * The catalog is built before the run and only read during it, all partitions share it.
+ */
+struct Catalog
+{
+    vector<double> start;                 // Start time of every item
+    vector<double> realPrice;             // Real price of every item
+    vector<Cents> startPrice;             // Starting price of every item
+    vector<vector<uint32_t>> byCategory;  // Items of every category, sorted by the start time
+    double duration = 0;                  // Duration of every item
+
+    /**
+     * @brief Draws the items, every item from its own random stream.
+     * @param config Parameters of the marketplace.
+     */
+    explicit Catalog(const MarketConfig &config)
+    {
+        uint32_t count = max(config.numberOfItems, 0);
+        this->duration = config.singleItemDuration;
+        this->start.resize(count);
+        this->realPrice.resize(count);
+        this->startPrice.resize(count);
+        this->byCategory.assign(max(config.categories, 1), {});
+
+        for (uint32_t item = 0; item < count; item++)
+        {
+            uint64_t random = streamSeed(config.seed, item);
+
+            // Items start evenly over the horizon, the real and the starting price follow the single-item model
+            double realPrice = exponential(random, 1000 * normal(random, 1.0, 0.2));
+            this->start[item] = config.horizon * item / count;
+            this->realPrice[item] = realPrice;
+            this->byCategory[nextRandom(random) % this->byCategory.size()].push_back(item);
+            this->startPrice[item] = max<Cents>(toCents(realPrice * normal(random, 0.8, 0.2)), 1);
+        }
+    }
+
+    double end(uint32_t item) const { return this->start[item] + this->duration; }
+
+    /**
+     * @brief Draws a running item of a category.
+     * Items of a category are sorted by the start time, the running ones form a contiguous range.
+     *
+     * @param category The category.
+     * @param time Current time.
+     * @param random Random stream of the drawing bidder.
+     *
+     * @return The item, NOBODY if no item of the category is running
+     */
+    uint32_t running(uint32_t category, double time, uint64_t &random) const
+    {
+        const vector<uint32_t> &items = this->byCategory[category];
+        auto startsAfter = [this](double t, uint32_t item)
+        { return t < this->start[item]; };
+        auto first = upper_bound(items.begin(), items.end(), time - this->duration, startsAfter);
+        auto last = upper_bound(items.begin(), items.end(), time, startsAfter);
+        if (first == last)
+        {
+            return NOBODY;
+        }
+        return first[nextRandom(random) % (last - first)];
+    }
+};
+
+/**
+ * @struct ItemLp
+ * @brief State of an item, the item keeps the index of its watchers.
+ */
+struct ItemLp
+{
+    Cents price = 0;           // Current price, the starting price before the first bid
+    uint32_t leader = NOBODY;  // Leading bidder
+    int leaderType = NONE;     // Strategy of the leading bidder
+    bool closed = false;       // Flag if the item ended
+    uint32_t sent = 0;         // Counter of the sent messages
+    vector<uint32_t> watchers; // Bidders notified about price changes
+    ItemResult result = {};    // Outcome of the item
+};
+
+/**
+ * @brief Flags of a watched item.
+ */
+enum WatchFlags : uint8_t
+{
+    PENDING = 1,    // A bid is on its way to the item
+    LEADING = 2,    // The bidder leads the item
+    AWAKE = 4,      // The bidder bids on the item (agents and snipers wait until late in the auction)
+    HAS_LEADER = 8, // The item has a leader, the next bid must add the increment
+    SEEN = 16,      // The price of the item is known
+};
+
+/**
+ * @struct WatchSlot
+ * @brief An item watched by a bidder.
+ */
+struct WatchSlot
+{
+    Cents valuation = 0;    // The maximum price the bidder is willing to pay for the item
+    Cents committed = 0;    // Budget committed to the pending or leading bid
+    Cents seen = 0;         // The last known price of the item
+    uint32_t item = NOBODY; // The watched item, NOBODY for a free slot
+    uint8_t flags = 0;      // WatchFlags
+};
+
+/**
+ * @struct BidderTable
+ * @brief Structure of arrays with the persistent bidders, a bidder owns watchLimit consecutive watch slots.
+ */
+struct BidderTable
+{
+    vector<uint8_t> type;         // BidderType
+    vector<uint32_t> category;    // Category of the wanted items
+    vector<Cents> budget;         // Remaining budget
+    vector<Cents> committed;      // Budget committed to pending and leading bids
+    vector<int32_t> substitutes;  // Substitute items the bidder still tries
+    vector<uint64_t> random;      // Random stream
+    vector<uint32_t> sent;        // Counter of the sent messages
+    vector<WatchSlot> slots;      // Watched items
+};
+
+/**
+ * @brief Change of the watchers of an item, undone on rollback.
+ */
+enum WatcherChange : uint8_t
+{
+    UNCHANGED, // The watchers did not change
+    ADDED,     // A watcher was appended
+    REMOVED,   // A watcher was removed, the last watcher took its place
+    CLEARED,   // The item ended and dropped its watchers
+};
+
+/**
+ * @struct SavedEvent
+ * @brief An event processed by an optimistic partition with the state it may have changed.
+ * A handler changes only the receiving process, so the entry saves the price and the leader of an item or the
+ * record of a bidder (its watch slots are saved aside), not the whole partition.
+ */
+struct SavedEvent
+{
+    MarketEvent event;
+    MarketStatistics stats; // Counters of the partition before the event
+    Cents spent;            // Budget spent by the bidders of the partition before the event
+    double now;             // Time of the partition before the event
+    uint32_t sent = 0;      // Messages sent by the handler, the newest ones of the sent log
+    uint32_t counter;       // Message counter of the process
+
+    // Item
+    Cents price;
+    uint32_t leader;
+    int leaderType;
+    bool closed;
+    ItemResult result;
+    WatcherChange change = UNCHANGED;
+    uint32_t watcherIndex;     // Position of the removed watcher
+    uint32_t watcher;          // The removed watcher
+    vector<uint32_t> watchers; // Watchers dropped at the end of the item
+
+    // Bidder
+    Cents budget;
+    Cents committed;
+    int32_t substitutes;
+    uint64_t random;
+};
+
+/**
+ * @class Market
+ * @brief A partition of the marketplace model, the handlers of its logical processes and its event loop.
+ *
+ * @details
+ * Logical processes 0 .. items - 1 are the items, the bidders follow them. Item i and bidder b belong to the
+ * partition i mod P and b mod P, where they have the local index i / P and b / P. A handler only changes the state
+ * of the receiving process, other processes are reached by messages. Messages for other partitions wait in the
+ * outboxes until the partitions synchronize.
+ *
+ * An optimistic partition does not wait for the others. It keeps its processed events with the saved state until
+ * the global virtual time (GVT) passes them, a message earlier than the last processed event (a straggler) rolls the
+ * partition back and the messages of the undone events are cancelled by anti-messages.
+ */
+class Market
+{
+private:
+    const MarketConfig &config;
+    const Catalog &catalog;
+    uint32_t partition;  // Index of the partition
+    uint32_t partitions; // Number of partitions
+    uint32_t itemCount;
+    int watchLimit;
+
+    vector<ItemLp> items;
+    BidderTable bidders;
+    priority_queue<MarketEvent, vector<MarketEvent>, LaterEvent> queue;
+    vector<MarketEvent> scheduled; // Arrivals and closes known in advance, sorted and merged with the queue
+    size_t nextScheduled = 0;
+    vector<vector<MarketEvent>> outboxes; // Messages for the other partitions
+    double now = 0;
+    Cents spent = 0;
+
+    // Optimistic execution
+    bool optimistic;
+    set<MarketEvent, EarlierEvent> pending; // Unprocessed messages, they replace the queue
+    deque<SavedEvent> processed;           // Processed events above GVT, they may still be rolled back
+    deque<MarketEvent> sentLog;            // Messages sent by the processed events
+    deque<WatchSlot> savedSlots;           // Watch slots saved by the processed bidder events
+    mutex inboxLock;
+    vector<MarketEvent> inbox;             // Messages and anti-messages from the other partitions
+    uint64_t rollbacks = 0;
+    uint64_t rolledBack = 0;
+    uint64_t antiMessages = 0;
+
+    uint32_t bidderProcess(uint32_t bidder) const { return this->itemCount + bidder; }
+    size_t local(uint32_t id) const { return id / this->partitions; }
+    ItemLp &item(uint32_t item) { return this->items[local(item)]; }
+
+    uint32_t partitionOf(uint32_t process) const
+    {
+        return (process < this->itemCount ? process : process - this->itemCount) % this->partitions;
+    }
+
+    uint32_t &counter(uint32_t process)
+    {
+        return process < this->itemCount ? item(process).sent : this->bidders.sent[local(process - this->itemCount)];
+    }
+
+    /**
+     * @brief Sends a message, the key makes the order of simultaneous messages deterministic.
+     */
+    void send(uint32_t source, uint32_t target, double time, EventKind kind, Cents amount = 0, uint32_t other = NOBODY)
+    {
+        MarketEvent event = {time, (uint64_t)source << 32 | counter(source)++, target, source, amount, other, kind};
+        uint32_t destination = partitionOf(target);
+        if (this->optimistic)
+        {
+            this->processed.back().sent++;
+            this->sentLog.push_back(event);
+        }
+        if (destination == this->partition && this->optimistic)
+        {
+            this->pending.insert(event);
+        }
+        else if (destination == this->partition)
+        {
+            this->queue.push(event);
+        }
+        else
+        {
+            this->outboxes[destination].push_back(event);
+        }
+    }
+
+    /**
+     * @brief Schedules a message known before the run, it does not occupy the queue until it is due.
+     */
+    void schedule(uint32_t process, double time, EventKind kind)
+    {
+        this->scheduled.push_back({time, (uint64_t)process << 32 | counter(process)++, process, process, 0, NOBODY, kind});
+    }
+
+    WatchSlot *slotsOf(uint32_t bidder) { return &this->bidders.slots[local(bidder) * this->watchLimit]; }
+
+    WatchSlot *findSlot(uint32_t bidder, uint32_t item)
+    {
+        WatchSlot *slots = slotsOf(bidder);
+        for (int i = 0; i < this->watchLimit; i++)
+        {
+            if (slots[i].item == item)
+            {
+                return &slots[i];
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Sends a message to every watcher of an item, the cost is O(watchers).
+     */
+    void notifyWatchers(uint32_t item, EventKind kind)
+    {
+        ItemLp &state = this->item(item);
+        for (uint32_t watcher : state.watchers)
+        {
+            send(item, bidderProcess(watcher), this->now + NOTIFICATION_DELAY, kind, state.price, state.leader);
+        }
+        this->stats.notifications += state.watchers.size();
+    }
+
+    void closeItem(uint32_t item)
+    {
+        ItemLp &state = this->item(item);
+        state.closed = true;
+
+        ItemResult &result = state.result;
+        result.itemNumber = item + 1;
+        result.winner = state.leaderType;
+        result.winnerId = state.leader == NOBODY ? -1 : (int32_t)state.leader; // Marketplace bidders are not a Population, their index identifies them
+        result.ending = state.leader == NOBODY ? NO_BIDS : SOLD;
+        result.finalPrice = toAmount(state.price);
+        result.endTime = this->now;
+        result.units = 1;
+        result.unitsSold = state.leader != NOBODY;
+        result.unitsWon[result.winner + 1] = 1;
+        result.revenue = result.unitsSold ? result.finalPrice : 0;
+
+        notifyWatchers(item, CLOSED);
+        if (this->optimistic)
+        {
+            this->processed.back().change = CLEARED;
+            this->processed.back().watchers.swap(state.watchers);
+        }
+        else
+        {
+            vector<uint32_t>().swap(state.watchers);
+        }
+    }
+
+    void watchItem(uint32_t item, uint32_t bidder, int type)
+    {
+        ItemLp &state = this->item(item);
+        if (state.closed)
+        {
+            send(item, bidderProcess(bidder), this->now + NOTIFICATION_DELAY, CLOSED, state.price, state.leader);
+            return;
+        }
+        state.watchers.push_back(bidder);
+        if (this->optimistic)
+        {
+            this->processed.back().change = ADDED;
+        }
+        state.result.agents += type == AGENT;
+        state.result.ratchets += type == RATCHET;
+        state.result.snipers += type == SNIPER;
+        send(item, bidderProcess(bidder), this->now + NOTIFICATION_DELAY, PRICE, state.price, state.leader);
+    }
+
+    void unwatchItem(uint32_t item, uint32_t bidder)
+    {
+        vector<uint32_t> &watchers = this->item(item).watchers;
+        auto watcher = find(watchers.begin(), watchers.end(), bidder);
+        if (watcher != watchers.end())
+        {
+            if (this->optimistic)
+            {
+                SavedEvent &saved = this->processed.back();
+                saved.change = REMOVED;
+                saved.watcherIndex = watcher - watchers.begin();
+                saved.watcher = bidder;
+            }
+            *watcher = watchers.back();
+            watchers.pop_back();
+        }
+    }
+
+    /**
+     * @brief Accepts a bid raising the price at least by the tiered increment (the first bid by the starting price).
+     */
+    void placeBid(uint32_t item, uint32_t bidder, int type, Cents amount)
+    {
+        ItemLp &state = this->item(item);
+        if (state.closed)
+        {
+            send(item, bidderProcess(bidder), this->now + NOTIFICATION_DELAY, CLOSED, state.price, state.leader);
+            return;
+        }
+
+        Cents minimal = state.leader == NOBODY ? state.price : state.price + tieredIncrement(state.price);
+        if (amount < minimal)
+        {
+            this->stats.rejected++;
+            send(item, bidderProcess(bidder), this->now + NOTIFICATION_DELAY, REJECTED, state.price, state.leader);
+            return;
+        }
+        state.price = amount;
+        state.leader = bidder;
+        state.leaderType = type;
+        state.result.bids++;
+        notifyWatchers(item, PRICE);
+    }
+
+    double reactionTime(int type, uint64_t &random)
+    {
+        if (type == AGENT)
+        {
+            return max(exponential(random, 0.5), 0.2);
+        }
+        if (type == RATCHET)
+        {
+            return 1 + exponential(random, 1);
+        }
+        return exponential(random, 0.2) + exponential(random, 0.1); // Reaction time and network latency of a sniper
+    }
+
+    void release(uint32_t bidder, WatchSlot &slot)
+    {
+        this->bidders.committed[local(bidder)] -= slot.committed;
+        slot.committed = 0;
+        slot.flags &= ~(PENDING | LEADING);
+    }
+
+    /**
+     * @brief Starts watching running items of the bidder's category in the free slots.
+     *
+     * @param bidder The bidder.
+     * @param shift Flag if the items replace lost or too expensive items, the bidder tries a limited number of them.
+     */
+    void watchItems(uint32_t bidder, bool shift)
+    {
+        BidderTable &table = this->bidders;
+        size_t self = local(bidder);
+        uint64_t &random = table.random[self];
+        WatchSlot *slots = slotsOf(bidder);
+        bool enoughBudget = table.budget[self] - table.committed[self] >= MINIMAL_BUDGET;
+
+        int watched = count_if(slots, slots + this->watchLimit, [](const WatchSlot &slot)
+                               { return slot.item != NOBODY; });
+        for (int i = 0; i < this->watchLimit && enoughBudget; i++)
+        {
+            if (slots[i].item != NOBODY || (shift && table.substitutes[self] == 0))
+            {
+                continue;
+            }
+
+            uint32_t item = NOBODY;
+            for (int tries = 0; tries < SUBSTITUTE_TRIES && item == NOBODY; tries++)
+            {
+                item = this->catalog.running(table.category[self], this->now, random);
+                if (item != NOBODY && findSlot(bidder, item))
+                {
+                    item = NOBODY;
+                }
+            }
+            if (item == NOBODY)
+            {
+                break;
+            }
+
+            int type = table.type[self];
+            WatchSlot &slot = slots[i];
+            slot.item = item;
+            slot.valuation = toCents(this->catalog.realPrice[item] * normal(random, 1.2, (type == SNIPER ? 0.3 : 0.5) / 2));
+            slot.committed = 0;
+            slot.seen = 0;
+            slot.flags = type == RATCHET ? AWAKE : 0;
+            send(bidderProcess(bidder), item, this->now + ARBITRATION_DELAY, WATCH, 0, type);
+            watched++;
+            this->stats.watches++;
+            if (shift)
+            {
+                this->stats.shifts++;
+                table.substitutes[self]--;
+            }
+
+            // Agents engage late in the auction, snipers just before its end. A wake-up is never due at once, every
+            // message is later than the event sending it, so an optimistic partition processes in (time, key) order
+            double end = this->catalog.end(item);
+            double wake = type == AGENT ? end - exponential(random, this->config.singleItemDuration * 0.75)
+                                        : end - SNIPE_LEAD - fabs(normal(random, 0, 0.1 / 3));
+            if (type != RATCHET)
+            {
+                send(bidderProcess(bidder), bidderProcess(bidder), max(wake, this->now + ARBITRATION_DELAY), WAKE, 0, item);
+            }
+        }
+
+        if (watched == 0)
+        {
+            this->stats.departures++;
+        }
+    }
+
+    /**
+     * @brief Decides about the next bid on a watched item.
+     * A bidder who cannot afford the next price stops watching the item and moves to a substitute.
+     *
+     * @param bidder The bidder.
+     * @param slot The watched item.
+     * @param urgent Flag if the bidder reacts for sure (first look, outbid, rejected bid or wake-up).
+     */
+    void react(uint32_t bidder, WatchSlot &slot, bool urgent)
+    {
+        BidderTable &table = this->bidders;
+        size_t self = local(bidder);
+        Cents amount = (slot.flags & HAS_LEADER) ? slot.seen + tieredIncrement(slot.seen) : slot.seen;
+        if (amount > slot.valuation || amount > table.budget[self] - table.committed[self])
+        {
+            send(bidderProcess(bidder), slot.item, this->now + ARBITRATION_DELAY, UNWATCH);
+            slot.item = NOBODY;
+            watchItems(bidder, true);
+            return;
+        }
+
+        int type = table.type[self];
+        uint64_t &random = table.random[self];
+        if (!(slot.flags & AWAKE) || (type == RATCHET && !urgent && uniform(random) > RATCHET_REACTION))
+        {
+            return;
+        }
+
+        double delay = reactionTime(type, random) + ARBITRATION_DELAY;
+        send(bidderProcess(bidder), slot.item, this->now + delay, BID, amount, type);
+        table.committed[self] += amount;
+        slot.committed = amount;
+        slot.flags |= PENDING;
+        this->stats.bids++;
+    }
+
+    void onPrice(uint32_t bidder, const MarketEvent &event)
+    {
+        WatchSlot *slot = findSlot(bidder, event.source);
+        if (!slot)
+        {
+            return;
+        }
+        bool firstLook = !(slot->flags & SEEN);
+        slot->seen = event.amount;
+        slot->flags |= SEEN | (event.other != NOBODY ? HAS_LEADER : 0);
+        if (event.other == bidder)
+        {
+            slot->flags = (slot->flags | LEADING) & ~PENDING;
+            return;
+        }
+
+        bool outbid = slot->flags & LEADING;
+        if (outbid)
+        {
+            release(bidder, *slot);
+            this->stats.outbid++;
+        }
+        if (!(slot->flags & PENDING))
+        {
+            react(bidder, *slot, firstLook || outbid);
+        }
+    }
+
+    void onRejected(uint32_t bidder, const MarketEvent &event)
+    {
+        WatchSlot *slot = findSlot(bidder, event.source);
+        if (!slot)
+        {
+            return;
+        }
+        slot->seen = event.amount;
+        slot->flags |= event.other != NOBODY ? HAS_LEADER : 0;
+        release(bidder, *slot);
+        react(bidder, *slot, true);
+    }
+
+    void onClosed(uint32_t bidder, const MarketEvent &event)
+    {
+        WatchSlot *slot = findSlot(bidder, event.source);
+        if (!slot)
+        {
+            return;
+        }
+        if (event.other == bidder)
+        {
+            this->bidders.budget[local(bidder)] -= event.amount;
+            this->spent += event.amount;
+        }
+        release(bidder, *slot);
+        slot->item = NOBODY;
+        watchItems(bidder, true);
+    }
+
+    void onWake(uint32_t bidder, const MarketEvent &event)
+    {
+        WatchSlot *slot = findSlot(bidder, event.other);
+        if (!slot)
+        {
+            return;
+        }
+        slot->flags |= AWAKE;
+        if ((slot->flags & SEEN) && !(slot->flags & (PENDING | LEADING)))
+        {
+            react(bidder, *slot, true);
+        }
+    }
+
+    void handle(const MarketEvent &event)
+    {
+        this->now = event.time;
+        this->stats.events++;
+        if (event.target < this->itemCount)
+        {
+            uint32_t bidder = event.source - this->itemCount;
+            switch (event.kind)
+            {
+            case CLOSE:
+                closeItem(event.target);
+                break;
+            case WATCH:
+                watchItem(event.target, bidder, event.other);
+                break;
+            case UNWATCH:
+                unwatchItem(event.target, bidder);
+                break;
+            case BID:
+                placeBid(event.target, bidder, event.other, event.amount);
+                break;
+            }
+            return;
+        }
+
+        uint32_t bidder = event.target - this->itemCount;
+        switch (event.kind)
+        {
+        case ARRIVE:
+            watchItems(bidder, false);
+            break;
+        case WAKE:
+            onWake(bidder, event);
+            break;
+        case PRICE:
+            onPrice(bidder, event);
+            break;
+        case REJECTED:
+            onRejected(bidder, event);
+            break;
+        case CLOSED:
+            onClosed(bidder, event);
+            break;
+        }
+    }
+
+    /**
+     * @brief Saves the state of the receiving process before an optimistic partition handles an event.
+     */
+    void save(const MarketEvent &event)
+    {
+        SavedEvent &saved = this->processed.emplace_back();
+        saved.event = event;
+        saved.stats = this->stats;
+        saved.spent = this->spent;
+        saved.now = this->now;
+        saved.counter = counter(event.target);
+        if (event.target < this->itemCount)
+        {
+            const ItemLp &state = item(event.target);
+            saved.price = state.price;
+            saved.leader = state.leader;
+            saved.leaderType = state.leaderType;
+            saved.closed = state.closed;
+            saved.result = state.result;
+            return;
+        }
+
+        uint32_t bidder = event.target - this->itemCount;
+        size_t self = local(bidder);
+        saved.budget = this->bidders.budget[self];
+        saved.committed = this->bidders.committed[self];
+        saved.substitutes = this->bidders.substitutes[self];
+        saved.random = this->bidders.random[self];
+        WatchSlot *slots = slotsOf(bidder);
+        this->savedSlots.insert(this->savedSlots.end(), slots, slots + this->watchLimit);
+    }
+
+    /**
+     * @brief Cancels a message of an undone event, a message of another partition by an anti-message.
+     */
+    void cancel(MarketEvent event)
+    {
+        uint32_t destination = partitionOf(event.target);
+        if (destination == this->partition)
+        {
+            this->pending.erase(event);
+            return;
+        }
+        event.kind |= ANTI;
+        this->outboxes[destination].push_back(event);
+        this->antiMessages++;
+    }
+
+    /**
+     * @brief Undoes the last processed event, the event is pending again.
+     * Messages sent by the event are later than it, so the events they caused were already undone.
+     */
+    void undo()
+    {
+        SavedEvent &saved = this->processed.back();
+        for (uint32_t i = 0; i < saved.sent; i++)
+        {
+            cancel(this->sentLog.back());
+            this->sentLog.pop_back();
+        }
+
+        const MarketEvent &event = saved.event;
+        counter(event.target) = saved.counter;
+        if (event.target < this->itemCount)
+        {
+            ItemLp &state = item(event.target);
+            state.price = saved.price;
+            state.leader = saved.leader;
+            state.leaderType = saved.leaderType;
+            state.closed = saved.closed;
+            state.result = saved.result;
+            switch (saved.change)
+            {
+            case ADDED:
+                state.watchers.pop_back();
+                break;
+            case REMOVED:
+                state.watchers.push_back(saved.watcher);
+                swap(state.watchers[saved.watcherIndex], state.watchers.back());
+                break;
+            case CLEARED:
+                state.watchers.swap(saved.watchers);
+                break;
+            case UNCHANGED:
+                break;
+            }
+        }
+        else
+        {
+            uint32_t bidder = event.target - this->itemCount;
+            size_t self = local(bidder);
+            this->bidders.budget[self] = saved.budget;
+            this->bidders.committed[self] = saved.committed;
+            this->bidders.substitutes[self] = saved.substitutes;
+            this->bidders.random[self] = saved.random;
+            copy(this->savedSlots.end() - this->watchLimit, this->savedSlots.end(), slotsOf(bidder));
+            this->savedSlots.erase(this->savedSlots.end() - this->watchLimit, this->savedSlots.end());
+        }
+
+        this->stats = saved.stats;
+        this->spent = saved.spent;
+        this->now = saved.now;
+        this->pending.insert(event);
+        this->processed.pop_back();
+        this->rolledBack++;
+    }
+
+    /**
+     * @brief Undoes the processed events later than a message.
+     * @param event The message.
+     * @param inclusive Flag if the message itself is undone as well (it is cancelled by an anti-message).
+     */
+    void rollback(const MarketEvent &event, bool inclusive)
+    {
+        this->rollbacks++;
+        while (!this->processed.empty())
+        {
+            const MarketEvent &last = this->processed.back().event;
+            if (!LaterEvent()(last, event) && !(inclusive && last.time == event.time && last.key == event.key))
+            {
+                break;
+            }
+            undo();
+        }
+    }
+
+    void createItems()
+    {
+        for (uint32_t item = this->partition; item < this->itemCount; item += this->partitions)
+        {
+            ItemLp state;
+            state.price = this->catalog.startPrice[item];
+            state.result.realPrice = this->catalog.realPrice[item];
+            state.result.startPrice = toAmount(state.price);
+            this->items.push_back(state);
+            schedule(item, this->catalog.end(item), CLOSE);
+        }
+    }
+
+    void createBidders()
+    {
+        uint32_t total = max(this->config.numberOfBidders, 0);
+        size_t count = total / this->partitions + (this->partition < total % this->partitions);
+        BidderTable &table = this->bidders;
+        table.type.resize(count);
+        table.category.resize(count);
+        table.budget.resize(count);
+        table.committed.assign(count, 0);
+        table.substitutes.assign(count, this->config.substitutes);
+        table.random.resize(count);
+        table.sent.assign(count, 0);
+        table.slots.assign(count * this->watchLimit, WatchSlot());
+
+        // Bidders arrive until the last item ends
+        double arrivals = this->config.horizon + this->config.singleItemDuration;
+        for (uint32_t bidder = this->partition; bidder < total; bidder += this->partitions)
+        {
+            size_t self = local(bidder);
+            uint64_t &random = table.random[self];
+            random = streamSeed(this->config.seed, bidderProcess(bidder));
+
+            double strategy = uniform(random);
+            table.type[self] = strategy < 0.4 ? AGENT : (strategy < 0.65 ? RATCHET : SNIPER);
+            table.category[self] = nextRandom(random) % this->catalog.byCategory.size();
+            table.budget[self] = toCents(exponential(random, this->config.meanBudget));
+            schedule(bidderProcess(bidder), uniform(random) * arrivals, ARRIVE);
+        }
+    }
+
+public:
+    MarketStatistics stats; // Counters of the partition
+
+    Market(const MarketConfig &config, const Catalog &catalog, uint32_t partition, uint32_t partitions, bool optimistic = false)
+        : config(config), catalog(catalog), partition(partition), partitions(partitions),
+          itemCount(catalog.start.size()), watchLimit(max(config.watchLimit, 1)), outboxes(partitions),
+          optimistic(optimistic)
+    {
+        createItems();
+        createBidders();
+        sort(this->scheduled.begin(), this->scheduled.end(), [](const MarketEvent &a, const MarketEvent &b)
+             { return LaterEvent()(b, a); });
+    }
+
+    /**
+     * @brief Time of the earliest pending message of the partition.
+     * @return The time, infinity if there is none
+     */
+    double nextTime() const
+    {
+        double next = INFINITY;
+        if (!this->queue.empty())
+        {
+            next = this->queue.top().time;
+        }
+        if (!this->pending.empty())
+        {
+            next = min(next, this->pending.begin()->time);
+        }
+        if (this->nextScheduled < this->scheduled.size())
+        {
+            next = min(next, this->scheduled[this->nextScheduled].time);
+        }
+        return next;
+    }
+
+    /**
+     * @brief Processes the messages delivered before the end of a window in (time, key) order.
+     * @param end End of the window, messages at this time or later are left for the next window.
+     */
+    void processUntil(double end)
+    {
+        for (vector<MarketEvent> &outbox : this->outboxes)
+        {
+            outbox.clear();
+        }
+        while (true)
+        {
+            bool fromSchedule = this->nextScheduled < this->scheduled.size() &&
+                                (this->queue.empty() || LaterEvent()(this->queue.top(), this->scheduled[this->nextScheduled]));
+            if (fromSchedule && this->scheduled[this->nextScheduled].time < end)
+            {
+                handle(this->scheduled[this->nextScheduled++]);
+            }
+            else if (!fromSchedule && !this->queue.empty() && this->queue.top().time < end)
+            {
+                MarketEvent event = this->queue.top();
+                this->queue.pop();
+                handle(event);
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief Takes the messages the other partitions sent to this one in the last window.
+     * @param markets All partitions.
+     */
+    void receive(const vector<unique_ptr<Market>> &markets)
+    {
+        for (const unique_ptr<Market> &market : markets)
+        {
+            for (const MarketEvent &event : market->outboxes[this->partition])
+            {
+                this->queue.push(event);
+            }
+        }
+    }
+
+    /**
+     * @brief Processes messages of an optimistic partition in (time, key) order, saving the state for a rollback.
+     *
+     * @param limit Messages at this time or later wait for the next GVT round.
+     * @param count Maximal number of processed messages.
+     *
+     * @return Number of processed messages
+     */
+    int speculate(double limit, int count)
+    {
+        int handled = 0;
+        for (; handled < count; handled++)
+        {
+            bool fromSchedule = this->nextScheduled < this->scheduled.size() &&
+                                (this->pending.empty() || LaterEvent()(*this->pending.begin(), this->scheduled[this->nextScheduled]));
+            if (!fromSchedule && this->pending.empty())
+            {
+                break;
+            }
+            MarketEvent event = fromSchedule ? this->scheduled[this->nextScheduled] : *this->pending.begin();
+            if (event.time >= limit)
+            {
+                break;
+            }
+            if (fromSchedule)
+            {
+                this->nextScheduled++;
+            }
+            else
+            {
+                this->pending.erase(this->pending.begin());
+            }
+            save(event);
+            handle(event);
+        }
+        return handled;
+    }
+
+    /**
+     * @brief Passes the messages and anti-messages of an optimistic partition to the inboxes of their partitions.
+     * @param markets All partitions.
+     * @param transit Number of messages in the inboxes of all partitions.
+     */
+    void flush(const vector<unique_ptr<Market>> &markets, atomic<int64_t> &transit)
+    {
+        for (uint32_t destination = 0; destination < this->partitions; destination++)
+        {
+            vector<MarketEvent> &outbox = this->outboxes[destination];
+            if (outbox.empty())
+            {
+                continue;
+            }
+            Market &market = *markets[destination];
+            {
+                lock_guard<mutex> lock(market.inboxLock);
+                market.inbox.insert(market.inbox.end(), outbox.begin(), outbox.end());
+            }
+            transit += outbox.size();
+            outbox.clear();
+        }
+    }
+
+    /**
+     * @brief Takes the messages of an optimistic partition from its inbox.
+     * A straggler rolls the partition back to its time, an anti-message annihilates its message, the message is
+     * rolled back first if it was already processed. A partition sends its messages and their anti-messages through
+     * the same inbox, so a message always arrives before its anti-message.
+     *
+     * @param transit Number of messages in the inboxes of all partitions.
+     */
+    void deliver(atomic<int64_t> &transit)
+    {
+        vector<MarketEvent> messages;
+        {
+            lock_guard<mutex> lock(this->inboxLock);
+            messages.swap(this->inbox);
+        }
+        transit -= messages.size();
+
+        for (MarketEvent &message : messages)
+        {
+            if (message.kind & ANTI)
+            {
+                message.kind &= ~ANTI;
+                if (this->pending.erase(message) == 0)
+                {
+                    rollback(message, true);
+                    this->pending.erase(message);
+                }
+                continue;
+            }
+            if (!this->processed.empty() && LaterEvent()(this->processed.back().event, message))
+            {
+                rollback(message, false);
+            }
+            this->pending.insert(message);
+        }
+    }
+
+    /**
+     * @brief Commits the processed events earlier than GVT, no message can roll them back (fossil collection).
+     * @param gvt Global virtual time, the earliest unprocessed message of all partitions.
+     */
+    void commit(double gvt)
+    {
+        while (!this->processed.empty() && this->processed.front().event.time < gvt)
+        {
+            const SavedEvent &saved = this->processed.front();
+            this->sentLog.erase(this->sentLog.begin(), this->sentLog.begin() + saved.sent);
+            if (saved.event.target >= this->itemCount)
+            {
+                this->savedSlots.erase(this->savedSlots.begin(), this->savedSlots.begin() + this->watchLimit);
+            }
+            this->processed.pop_front();
+        }
+    }
+
+    /**
+     * @brief Stores the results of the items of the partition and adds its counters to the results.
+     * @param results Results of the marketplace, the item array is already sized.
+     * @return Budget spent by the bidders of the partition
+     */
+    Cents collect(MarketResults &results)
+    {
+        for (size_t i = 0; i < this->items.size(); i++)
+        {
+            results.items[this->partition + i * this->partitions] = this->items[i].result;
+        }
+
+        MarketStatistics &total = results.statistics;
+        total.events += this->stats.events;
+        total.notifications += this->stats.notifications;
+        total.bids += this->stats.bids;
+        total.rejected += this->stats.rejected;
+        total.outbid += this->stats.outbid;
+        total.watches += this->stats.watches;
+        total.shifts += this->stats.shifts;
+        total.departures += this->stats.departures;
+        total.rollbacks += this->rollbacks;
+        total.rolledBack += this->rolledBack;
+        total.antiMessages += this->antiMessages;
+        return this->spent;
+    }
+};
+
+/**
+ * @brief Runs the partitions in conservative synchronization windows (YAWNS).
+ *
+ * @details
+ * A message between logical processes is delivered at least LOOKAHEAD after it was sent (the arbitration delay
+ * of a bid, item notifications take longer), so no message sent in the window [T, T + LOOKAHEAD), where T is the
+ * earliest pending message of all partitions, can be delivered inside of it. Every thread processes the window of
+ * its partition, the threads then exchange the messages between the partitions and agree on the next window.
+ * Each logical process handles its messages in (time, key) order with any number of threads, so the results are
+ * identical to the sequential run.
+ *
+ * @param markets The partitions, created by the threads.
+ * @param catalog The item catalog.
+ * @param config Parameters of the marketplace.
+ *
+ * @return Number of windows
+ */
+uint64_t runWindows(vector<unique_ptr<Market>> &markets, const Catalog &catalog, const MarketConfig &config)
+{
+    const double LOOKAHEAD = ARBITRATION_DELAY;
+    uint32_t threads = markets.size();
+    vector<double> next(threads);
+    double windowEnd = 0;
+    bool done = false;
+    uint64_t windows = 0;
+
+    auto advance = [&]() noexcept
+    {
+        double start = *min_element(next.begin(), next.end());
+        done = start == INFINITY;
+        windowEnd = start + LOOKAHEAD;
+        windows += !done;
+    };
+    barrier processed(threads);
+    barrier delivered(threads, advance);
+
+    vector<thread> workers;
+    for (uint32_t partition = 0; partition < threads; partition++)
+    {
+        workers.emplace_back([&, partition]()
+                             {
+            markets[partition] = make_unique<Market>(config, catalog, partition, threads);
+            Market &market = *markets[partition];
+            next[partition] = market.nextTime();
+            delivered.arrive_and_wait();
+            while (!done)
+            {
+                market.processUntil(windowEnd);
+                processed.arrive_and_wait();
+                market.receive(markets);
+                next[partition] = market.nextTime();
+                delivered.arrive_and_wait();
+            } });
+    }
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+    return windows;
+}
+
+/**
+ * @brief Runs the partitions optimistically (Time Warp).
+ *
+ * @details
+ * Every thread processes the events of its partition up to the optimism window ahead of GVT without waiting for the
+ * others and exchanges messages with them through their inboxes. Each GVT round stops the threads, which exchange
+ * messages until none is in transit (deliveries may roll back and send anti-messages). GVT is then the earliest
+ * pending message of all partitions, events before it are committed and their saved state is dropped. Rolled back
+ * events are processed again with the restored state and random streams, so the committed events and the results
+ * are identical to the sequential run.
+ *
+ * @param markets The partitions, created by the threads.
+ * @param catalog The item catalog.
+ * @param config Parameters of the marketplace.
+ *
+ * @return Number of GVT rounds
+ */
+uint64_t runOptimistic(vector<unique_ptr<Market>> &markets, const Catalog &catalog, const MarketConfig &config)
+{
+    uint32_t threads = markets.size();
+    vector<double> next(threads);
+    atomic<int64_t> transit(0);
+    double gvt = 0;
+    bool done = false;
+    bool quiet = false;
+    uint64_t rounds = 0;
+
+    auto settle = [&]() noexcept
+    { quiet = transit == 0; };
+    auto advance = [&]() noexcept
+    {
+        gvt = *min_element(next.begin(), next.end());
+        done = gvt == INFINITY;
+        rounds += !done;
+    };
+    barrier exchanged(threads);
+    barrier settled(threads, settle);
+    barrier agreed(threads, advance);
+
+    vector<thread> workers;
+    for (uint32_t partition = 0; partition < threads; partition++)
+    {
+        workers.emplace_back([&, partition]()
+                             {
+            markets[partition] = make_unique<Market>(config, catalog, partition, threads, true);
+            Market &market = *markets[partition];
+            next[partition] = market.nextTime();
+            agreed.arrive_and_wait();
+            while (!done)
+            {
+                double limit = gvt + max(config.optimism, ARBITRATION_DELAY);
+                for (int handled = 0; handled < GVT_INTERVAL;)
+                {
+                    market.deliver(transit);
+                    int count = market.speculate(limit, DELIVERY_INTERVAL);
+                    market.flush(markets, transit);
+                    if (count == 0)
+                    {
+                        break;
+                    }
+                    handled += count;
+                }
+
+                do
+                {
+                    exchanged.arrive_and_wait();
+                    market.deliver(transit);
+                    market.flush(markets, transit);
+                    settled.arrive_and_wait();
+                } while (!quiet);
+
+                next[partition] = market.nextTime();
+                agreed.arrive_and_wait();
+                market.commit(gvt);
+            } });
+    }
+    for (thread &worker : workers)
+    {
+        worker.join();
+    }
+    return rounds;
+}
+
+} // namespace
+
+const MarketResults &MarketSimulator::run()
+{
+    this->results = MarketResults();
+    Catalog catalog(this->config);
+    uint32_t threads = max(this->config.threads, 1);
+    vector<unique_ptr<Market>> markets(threads);
+
+    // A single partition runs to the end without synchronization
+    if (threads == 1)
+    {
+        markets[0] = make_unique<Market>(this->config, catalog, 0, 1);
+        markets[0]->processUntil(INFINITY);
+    }
+    else if (this->config.optimistic)
+    {
+        this->results.statistics.windows = runOptimistic(markets, catalog, this->config);
+    }
+    else
+    {
+        this->results.statistics.windows = runWindows(markets, catalog, this->config);
+    }
+
+    // Sums are integer, so they do not depend on the number of partitions
+    this->results.items.resize(catalog.start.size());
+    Cents spent = 0;
+    for (unique_ptr<Market> &market : markets)
+    {
+        spent += market->collect(this->results);
+    }
+    this->results.statistics.spent = toAmount(spent);
+    for (const ItemResult &item : this->results.items)
+    {
+        this->results.winnerStats[item.winner + 1]++;
+    }
+    return this->results;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file marketplace.h
+ * @brief Marketplace simulation with persistent bidders across concurrent auction items
+ * Bidders hold a budget, watch several running items of their category at once and move to a substitute
+ * item after being priced out or losing an item.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef MARKETPLACE_H
+#define MARKETPLACE_H
+
+#include <cstdint>
+#include <vector>
+#include "auction.h"
+
+/**
+ * @struct MarketConfig
+ * @brief Parameters of a marketplace run.
+ */
+struct MarketConfig
+{
+    int numberOfItems = 10000;       // Number of auction items
+    int numberOfBidders = 100000;    // Number of persistent bidders
+    int categories = 100;            // Number of item categories, items of a category are substitutes
+    int watchLimit = 4;              // Number of items a bidder watches at once
+    int substitutes = 8;             // Number of substitute items a bidder tries before leaving the market
+    double singleItemDuration = 60;  // Duration of a single auction item
+    double horizon = 600;            // Items start evenly over [0, horizon), bidders arrive until the last item ends
+    double meanBudget = 2500;        // Mean budget of a bidder
+    long seed = 1;                   // Seed of the random number generator
+    int threads = 1;                 // Threads of the parallel run, items and bidders are partitioned across them
+    bool optimistic = false;         // Run the threads optimistically (Time Warp) instead of in conservative windows
+    double optimism = 5;             // How far ahead of the global virtual time the optimistic threads may run
+};
+
+/**
+ * @struct MarketStatistics
+ * @brief Counters of a marketplace run.
+ */
+struct MarketStatistics
+{
+    uint64_t events = 0;        // Processed events
+    uint64_t notifications = 0; // Price and close notifications sent to watchers
+    uint64_t bids = 0;          // Bids sent by the bidders
+    uint64_t rejected = 0;      // Bids rejected because the price moved in the meantime
+    uint64_t outbid = 0;        // Leading bidders that were outbid
+    uint64_t watches = 0;       // Items watched by the bidders
+    uint64_t shifts = 0;        // Watches of substitute items after an item was lost or got too expensive
+    uint64_t departures = 0;    // Bidders that left the market (budget spent or out of substitutes)
+    double spent = 0;           // Budget spent by all bidders
+    uint64_t windows = 0;       // Synchronization windows of the conservative run, GVT rounds of the optimistic run
+    uint64_t rollbacks = 0;     // Rollbacks of the optimistic run (straggler messages and anti-messages)
+    uint64_t rolledBack = 0;    // Events undone by the rollbacks, the optimistic run processed events + rolledBack
+    uint64_t antiMessages = 0;  // Anti-messages cancelling messages of rolled back events
+};
+
+/**
+ * @struct MarketResults
+ * @brief Results of a marketplace run.
+ */
+struct MarketResults
+{
+    std::vector<ItemResult> items;     // Outcome of every item, in item number order
+    MarketStatistics statistics;       // Counters of the run
+    int winnerStats[5] = {0};          // None, Agent, Ratchet, Sniper, Learner (not used by the marketplace)
+};
+
+/**
+ * @class MarketSimulator
+ * @brief Runs the marketplace model with a given configuration.
+ *
+ * @details
+ * Items and bidders are logical processes exchanging timestamped messages. A bidder reaches an item after the
+ * arbitration delay (0.1 s), an item reaches its watchers no sooner than the minimal bidder reaction (0.2 s).
+ * Every logical process draws from its own random stream, so the results depend on the seed only, not on the number
+ * of threads and the synchronization. The model does not use SIMLIB, the marketplace runs next to the single-item model.
+ */
+class MarketSimulator
+{
+private:
+    MarketConfig config;
+    MarketResults results;
+
+public:
+    explicit MarketSimulator(const MarketConfig &config) : config(config) {}
+
+    /**
+     * @brief Runs the marketplace, results of a previous run are discarded.
+     * @return Results of the marketplace.
+     */
+    const MarketResults &run();
+
+    const MarketConfig &getConfig() const { return this->config; }
+    const MarketResults &getResults() const { return this->results; }
+};
+
+#endif // MARKETPLACE_H
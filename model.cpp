@@ -1,84 +1,59 @@
 /**
- * @file auction.cpp
- * @brief Auction simulation with multiple bidders
+ * @file model.cpp
+ * @brief Command line interface of the auction simulation
  * Bidders strategies are: Agent-bidding, Ratchet-bidding, and Sniping
  *
  * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
  */
 
 #include <iostream>
-#include <ctime>
+#include <chrono>
+#include <csignal>
 #include <cmath>
-#include "simlib.h"
+#include <ctime>
 #include <cstdint>
-#include <vector>
 #include <cstring>
+#include <string>
+#include <thread>
+#include "auction.h"
+#include "engine.h"
+#include "evolution.h"
+#include "loadgen.h"
+#include "marketplace.h"
+#include "output.h"
+#include "shard.h"
+#include "wal.h"
 
 using namespace std;
 
 #define LOGGING false
 #define LOG_STRATEGIES false
 
-// Default simulation parameters, can be changed using command line arguments
-int NUMBER_OF_ITEMS = 3460;       // Number of auction items
-double NUMBER_OF_BIDDERS = 70;    // Number of potential bidders for each item
-int SINGLE_ITEM_DURATION = 60;    // Duration of a single auction item
-double AUCTION_ITEM_TIMEOUT = 30; // Timeout for the first bid
-
-// Simulation helping variables
-double currentPrice = -1;                                 // Current price of the auction
-double minimalIncrement() { return currentPrice * 0.01; } // Current increment of the auction
-bool firstBidPlaced = false;                              // Flag if the first bid was placed for an item
-double ItemEndTime = 0;                                   // End time of the current item
-
-enum BidderType
-{
-    AGENT,
-    RATCHET,
-    SNIPER,
-    NONE = -1
-};
-
-// Statistics
-int itemNumber = 0;                // Unique identifier of the item
-int lastBidder = NONE;             // Helper variable for histogram
-int winnerStats[4] = {0, 0, 0, 0}; // Agent, Ratchet, Sniper, None
-
-Facility biddingFacility("Bidding process");         // Facility for bidding
-Facility runningAuction("Item auction");             // Facility for running the auction
-Histogram winners("Winners", -1, 1, 4);              // Histogram of winners
-Queue AgentDecidedToBid("Agent decided to bid");     // Queue of agents that decided to bid
-Queue RatchetDecidedToBid("Ratchet decided to bid"); // Queue of ratchet bidders that decided to bid
-Queue SniperDecidedToBid("Sniper decided to bid");   // Queue of snipers that decided to bid
-Process *AgentBidsProcess;                           // Agent bids handler
-Process *RatchetBidsProcess;                         // Ratchet bids handler
-Process *SniperBidsProcess;                          // Sniper bids handler
-
 /**
  * @brief Logs a single bid to a file
- * Function is used for further analysis of the auction
+ * Function is used for further analysis of the auction, the log stays open and is written in large buffers
+ * (output.h) until the program exits
  *
- * @param bidAmount Amount of the bid
+ * @param bid The placed bid
  *
  * @return void
  */
-void logSingleBid(double bidAmount)
+void logSingleBid(const BidEvent &bid)
 {
-    static bool header = false; // Variable to check if the header was already written
-    FILE *logFile = fopen("analysis/results/auction_detailed_log.csv", "a");
-    if (logFile)
+    static OutputFile logFile;  // Opened by the first bid
+    static bool failed = false; // Flag if the log could not be opened
+    if (!logFile.isOpen() && !failed)
     {
-        if (!header)
+        failed = !logFile.open("analysis/results/auction_detailed_log.csv", true, OUTPUT_PWRITE); // io_uring is not faster here
+        if (!failed && logFile.size() == 0)
         {
-            header = true;
-            fprintf(logFile, "ItemNumber,ItemTime,BidAmount\n"); // Header
+            logFile.print("ItemNumber,ItemTime,BidAmount\n"); // Header
         }
-
-        // Time since the start of the auction for the current item
-        double itemTime = SINGLE_ITEM_DURATION - (ItemEndTime - Time);
+    }
+    if (logFile.isOpen())
+    {
         // Log the bid
-        fprintf(logFile, "%d,%.1f,%.2f\n", itemNumber, itemTime, bidAmount);
-        fclose(logFile);
+        logFile.print("%d,%.1f,%.2f\n", bid.itemNumber, bid.itemTime, bid.amount);
     }
 }
 
@@ -86,702 +61,912 @@ void logSingleBid(double bidAmount)
  * @brief Logs the results of the auction strategies
  * Function is used for further analysis of the auction
  *
+ * @param winnerStats Number of wins of each strategy (None, Agent, Ratchet, Sniper, Learner), None counts the
+ *                    unsold and discarded items
+ *
  * @return void
  */
-void logStrategiesResults()
+void logStrategiesResults(const int winnerStats[5])
 {
-    FILE *logFile = fopen("analysis/results/auction_strategies_results.csv", "a");
-    if (logFile)
+    OutputFile logFile;
+    if (logFile.open("analysis/results/auction_strategies_results.csv", true, OUTPUT_PWRITE))
     {
-        fseek(logFile, 0, SEEK_END);
-        if (ftell(logFile) == 0)
+        if (logFile.size() == 0)
         {
-            fprintf(logFile, "Agent,Ratchet,Sniper,None\n");
+            logFile.print("Agent,Ratchet,Sniper,None\n");
         }
         // Agent, Ratchet, Sniper, None
-        fprintf(logFile, "%d,%d,%d,%d\n", winnerStats[1], winnerStats[2], winnerStats[3], winnerStats[0]);
-        fclose(logFile);
+        logFile.print("%d,%d,%d,%d\n", winnerStats[1], winnerStats[2], winnerStats[3], winnerStats[0]);
+        logFile.close();
     }
 }
 
 /**
- * @brief Funcion gets the first bidder from the queues and activates it
+ * @brief Runs the marketplace with persistent bidders and prints its summary.
+ *
+ * @param config Parameters of the marketplace.
  *
  * @return void
  */
-void returnFromQueues()
+void runMarketplace(const MarketConfig &config)
 {
-    while (!AgentDecidedToBid.Empty())
+    printf("Starting marketplace with %d items, %d bidders in %d categories, %d watched items per bidder, %d %s threads\n",
+           config.numberOfItems, config.numberOfBidders, config.categories, config.watchLimit, config.threads,
+           config.optimistic ? "optimistic" : "conservative");
+
+    MarketSimulator simulator(config);
+    auto start = chrono::steady_clock::now();
+    const MarketResults &results = simulator.run();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    const MarketStatistics &stats = results.statistics;
+    printf("Marketplace finished in %.3f s (%.0f events/s)\n", elapsed.count(), stats.events / elapsed.count());
+    printf("Events %llu, notifications %llu, bids %llu (%llu rejected), outbid %llu\n",
+           (unsigned long long)stats.events, (unsigned long long)stats.notifications, (unsigned long long)stats.bids,
+           (unsigned long long)stats.rejected, (unsigned long long)stats.outbid);
+    printf("Watches %llu, substitute shifts %llu, departures %llu, spent %.2f\n",
+           (unsigned long long)stats.watches, (unsigned long long)stats.shifts, (unsigned long long)stats.departures, stats.spent);
+    printf("Winners: agent %d, ratchet %d, sniper %d, unsold %d\n",
+           results.winnerStats[AGENT + 1], results.winnerStats[RATCHET + 1], results.winnerStats[SNIPER + 1], results.winnerStats[0]);
+    if (stats.windows > 0 && config.optimistic)
     {
-        AgentDecidedToBid.GetFirst()->Activate();
+        // Efficiency is the share of the processed events that were committed
+        uint64_t processed = stats.events + stats.rolledBack;
+        printf("GVT rounds %llu, rollbacks %llu (%.2f per 1000 events), rolled back events %llu, anti-messages %llu\n",
+               (unsigned long long)stats.windows, (unsigned long long)stats.rollbacks, 1000.0 * stats.rollbacks / processed,
+               (unsigned long long)stats.rolledBack, (unsigned long long)stats.antiMessages);
+        printf("Efficiency %.1f %% (%llu committed of %llu processed events)\n", 100.0 * stats.events / processed,
+               (unsigned long long)stats.events, (unsigned long long)processed);
     }
-    while (!RatchetDecidedToBid.Empty())
+    else if (stats.windows > 0)
     {
-        RatchetDecidedToBid.GetFirst()->Activate();
+        printf("Synchronization windows %llu (%.0f events per window)\n", (unsigned long long)stats.windows, (double)stats.events / stats.windows);
     }
-    while (!SniperDecidedToBid.Empty())
+
+    // Digest of the item outcomes, identical for any number of threads
+    uint64_t digest = 1469598103934665603ull;
+    for (const ItemResult &item : results.items)
     {
-        SniperDecidedToBid.GetFirst()->Activate();
+        uint64_t values[3] = {(uint64_t)item.winner, (uint64_t)item.bids, (uint64_t)llround(item.finalPrice * 100)};
+        for (uint64_t value : values)
+        {
+            digest = (digest ^ value) * 1099511628211ull;
+        }
     }
+    printf("Results digest %016llx\n", (unsigned long long)digest);
 }
 
 /**
- * @class AgentBidder
- * @brief Represents an agent bidder strategy in an auction.
- *
- * @details
- * Agents bid higher than the current price by the minimum increment if the current price is lower than the agent's item valuation.
- * The bidding behavior is influenced by patience, which decreases over time.
+ * @brief Runs the replicator dynamics of the strategy mix and prints its trajectory.
  *
- * @note The agent does not engage in bidding during the early stages of the auction.
+ * @param config Parameters of the evolution.
  *
- * @param valuation The maximum price the agent is willing to pay for the item.
- * @param roundEndTime The time at which the auction round ends.
+ * @return void
  */
-class AgentBidder : public Process
+void runEvolution(const EvolutionConfig &config)
 {
-private:
-    // Behaviour helpers
-    double lastUpdateTime = 0;
-    const double UPDATE_INTERVAL = SINGLE_ITEM_DURATION / 100;
+    printf("Starting evolution of the strategy mix with %d items per generation, at most %d generations, %d workers\n",
+           config.auction.numberOfItems, config.generations, config.workers);
 
-    double valuation = 0;
-    bool isLeading = false;
-    double patience = 1.0;
-    double roundEndTime = 0;
+    EvolutionSimulator simulator(config);
+    auto start = chrono::steady_clock::now();
+    const EvolutionResults &results = simulator.run();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
 
-public:
-    /**
-     * @brief Constructs an AgentBidder with a specified valuation and round end time.
-     * @param val The maximum price the agent is willing to pay for the item.
-     * @param roundEndTime The time at which the auction round ends.
-     */
-    AgentBidder(double val, double roundEndTime) : valuation(val)
+    printf("Generation   Agent Ratchet  Sniper   Payoff agent ratchet  sniper   Change   Time\n");
+    for (const Generation &generation : results.trajectory)
     {
-        this->roundEndTime = roundEndTime;
-    }
-
-    /**
-     * @brief The behavior of the agent bidder.
-     */
-    void Behavior()
-    {
-        while ((currentPrice < this->valuation) && (this->patience > Exponential(0.1)) && (Time < this->roundEndTime))
+        printf("%10d  %6.3f  %6.3f  %6.3f  %13.3f %7.3f %7.3f  %7.4f %5.2fs\n", generation.number, generation.mix[AGENT],
+               generation.mix[RATCHET], generation.mix[SNIPER], generation.payoff[AGENT], generation.payoff[RATCHET],
+               generation.payoff[SNIPER], generation.change, generation.seconds);
+        if (generation.degenerate)
         {
-            // Check if enough time has passed since the last update
-            if ((Time - lastUpdateTime) >= UPDATE_INTERVAL)
-            {
-                updatePatience();
-                lastUpdateTime = Time; // Update the timestamp
-            }
-
-            Wait(max(this->patience, 0.2));
-
-            // Agents do not engage in bidding in the early stages of the auction
-            if (Time > (this->roundEndTime - (Exponential((SINGLE_ITEM_DURATION / 4) * 3))))
-            {
-                if ((Random() > this->patience) && ((currentPrice + minimalIncrement()) < this->valuation))
-                {
-                    Wait(0.1);
-                    if (Time >= this->roundEndTime)
-                    {
-                        Terminate();
-                    }
-                    AgentDecidedToBid.Insert(this);
-                    Passivate();
-                }
-            }
+            printf("%10d  no strategy earned a positive payoff, the mix was kept\n", generation.number);
         }
-        // Stop if patience is exhausted
-        if (this->patience <= 0)
-        {
-            printf("[AGENT] bidder ran out of patience and stopped bidding.\n");
-        }
-        Terminate();
     }
-
-    /**
-     * @brief Updates the patience of the agent bidder based on the time remaining in the auction of an item.
-     */
-    void updatePatience()
+    if (results.failed)
     {
-        double normalizedTime = (SINGLE_ITEM_DURATION - (ItemEndTime - Time)) / SINGLE_ITEM_DURATION;
-
-        if (normalizedTime < 0.75)
-        {
-            this->patience = 1.0 - (Exponential(0.01));
-        }
-        else
-        {
-            double remainingTime = (normalizedTime - 0.75) / (1.0 - 0.75);
-            this->patience = 0.99 - 0.1 * pow(remainingTime, 5);
-        }
+        fprintf(stderr, "A worker process was lost, the evolution stopped\n");
+        return;
     }
-};
+    printf("%s after %zu generations in %.3f s, mix: agent %.3f, ratchet %.3f, sniper %.3f\n",
+           results.converged ? "Converged" : "Not converged", results.trajectory.size(), elapsed.count(),
+           results.mix[AGENT], results.mix[RATCHET], results.mix[SNIPER]);
+}
 
 /**
- * @class AgentBids
- * @brief Represents the bidding process of agents in an auction.
+ * @brief Runs the simulation and replays its bids to a bid ingestion service, then prints the latency percentiles.
+ *
+ * @param config Parameters of the simulation, the bids are recorded.
+ * @param load Parameters of the replay.
+ *
+ * @return false if the replay could not start
  */
-class AgentBids : public Process
+bool runLoad(AuctionConfig config, const LoadConfig &load)
 {
-    void Behavior()
+    config.verbose = false;
+    config.recordBids = true;
+    AuctionSimulator simulator(config);
+    const AuctionResults &simulated = simulator.run();
+    printf("Replaying %zu bids of %d items at %gx speed over %d connections\n", simulated.bids.size(), config.numberOfItems,
+           load.speedup, load.connections);
+
+    LoadGenerator generator(load);
+    const LoadResults &results = generator.replay(simulated.bids, simulated.items);
+    if (!results.error.empty())
     {
-        while (Time < ItemEndTime)
+        fprintf(stderr, "%s\n", results.error.c_str());
+        return false;
+    }
+    printf("Sent %lld bids in %.3f s (scheduled %.3f s, %.0f bids/s), %lld acknowledged, %lld refused or lost\n",
+           (long long)results.sent, results.seconds, results.scheduled, results.sent / max(results.seconds, 1e-9),
+           (long long)results.acknowledged, (long long)results.failed);
+    printf("Send lag behind the schedule: mean %.1f us, p99 %.1f us, max %.1f us\n", results.lag.mean() / 1000,
+           results.lag.percentile(99) / 1000.0, results.lag.max() / 1000.0);
+
+    // The corrected latency counts the time a bid waited for the previous acknowledgement on its connection
+    const double percentiles[] = {50, 90, 99, 99.9, 99.99, 100};
+    printf("%-12s %10s %10s %10s %10s %10s %10s %10s\n", "Latency us", "mean", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+    const LatencyHistogram *histograms[2] = {&results.corrected, &results.uncorrected};
+    const char *names[2] = {"corrected", "uncorrected"};
+    for (int i = 0; i < 2; i++)
+    {
+        printf("%-12s %10.1f", names[i], histograms[i]->mean() / 1000);
+        for (double percentile : percentiles)
         {
-            Wait(0.1); // Time to process the bid
-
-            if (Time >= ItemEndTime)
-            {
-                Passivate();
-            }
-            if (!AgentDecidedToBid.Empty())
-            {
-                if (!biddingFacility.Busy())
-                {
-                    Seize(biddingFacility);
-                    firstBidPlaced = true;
-                    currentPrice += minimalIncrement();
-                    if (LOGGING)
-                    {
-                        logSingleBid(currentPrice);
-                    }
-                    printf("[AGENT] bidder placed a bid at time: %.2f. New price: %.2f\n", Time, currentPrice);
-                    lastBidder = AGENT;
-                    returnFromQueues();
-                    Release(biddingFacility);
-                }
-            }
+            printf(" %10.1f", histograms[i]->percentile(percentile) / 1000.0);
         }
-        Passivate();
+        printf("\n");
     }
-};
+    return true;
+}
+
+StubServer *stubServer = nullptr; // Stub server stopped by a signal
 
 /**
- * @class RatchetBidder
- * @brief Represents a ratchet bidder strategy in an auction.
+ * @brief Serves a stub bid ingestion service until SIGINT or SIGTERM.
  *
- * @details
- * Ratchet bidders bid higher than the current price by the minimum increment if the current price is lower than the agent's item valuation.
- * The bidding behavior is influenced by patience, which decreases over time.
+ * @param endpoint Endpoint of the service.
  *
- * @note Ratchet bidders are humans, sometimes they are irrational and bid with a unrealistic price valuation.
- *
- * @param valuation The maximum price the ratchet bidder is willing to pay for the item.
- * @param roundEndTime The time at which the auction round ends.
+ * @return false if the endpoint could not be opened
  */
-class RatchetBidder : public Process
+bool runStub(const Endpoint &endpoint)
 {
-private:
-    // Behaviour helpers
-    const double UPDATE_INTERVAL = SINGLE_ITEM_DURATION / 100;
-    double lastUpdateTime = 0;
+    StubServer server(endpoint);
+    if (!server.open())
+    {
+        perror("Stub server");
+        return false;
+    }
+    stubServer = &server;
+    signal(SIGINT, [](int) { stubServer->stop(); });
+    signal(SIGTERM, [](int) { stubServer->stop(); });
+    printf("Stub server listening\n");
+    fflush(stdout);
+    server.serve();
+    printf("Stub server acknowledged %lld bids\n", (long long)server.getAcknowledged());
+    return true;
+}
 
-    double valuation = 0;    // The maximum price the agent is willing to pay for the item
-    bool isLeading = false;  // Whether the bidder is leading the auction
-    double patience = 1.0;   // Initial patience
-    double roundEndTime = 0; // Prevents bidding after the end of the auction round
+EngineServer *engineServer = nullptr; // Live engine stopped by a signal
 
-public:
-    /**
-     * @brief Constructs a RatchetBidder with a specified valuation and round end time.
-     * @param val The maximum price the agent is willing to pay for the item.
-     * @param roundEndTime The time at which the auction round for an item ends.
-     */
-    RatchetBidder(double val, double roundEndTime) : valuation(val)
+/**
+ * @brief Serves the live auction engine until SIGINT or SIGTERM, then prints its counters and latency.
+ *
+ * @param endpoint Endpoint of the engine.
+ * @param ring Name of the shared-memory ring of local clients, empty for none.
+ * @param wal Write-ahead log, an empty path for none.
+ * @param tiered Flag if the eBay increment table is used instead of 1 % of the price.
+ * @param softClose Soft close of the auctions in seconds, 0 disables.
+ *
+ * @return false if the endpoint, the ring or the log could not be opened, or the log failed
+ */
+bool runEngine(const Endpoint &endpoint, const string &ring, const WalConfig &wal, bool tiered, double softClose)
+{
+    EngineServer server(endpoint, tiered, (int64_t)(softClose * 1e9));
+    if (!wal.path.empty() && !server.openLog(wal))
+    {
+        perror("Write-ahead log");
+        return false;
+    }
+    if (!server.open() || (!ring.empty() && !server.openRing(ring)))
+    {
+        perror("Live engine");
+        return false;
+    }
+    if (server.getLogStats())
+    {
+        const WalStats &log = *server.getLogStats();
+        printf("Write-ahead log replayed %lld records, %lld open and %lld closed auctions recovered, %lld bytes of a torn end dropped\n",
+               (long long)log.replayed, (long long)log.recovered, (long long)log.closed, (long long)log.dropped);
+    }
+    engineServer = &server;
+    signal(SIGINT, [](int) { engineServer->stop(); });
+    signal(SIGTERM, [](int) { engineServer->stop(); });
+    printf("Live engine listening\n");
+    fflush(stdout);
+    server.serve();
+
+    const EngineStats &stats = server.getStats();
+    const LatencyHistogram &latency = server.getLatency();
+    printf("Live engine handled %lld requests, %lld auctions (%lld sold, %lld unsold), %lld bids accepted\n",
+           (long long)stats.requests, (long long)stats.opened, (long long)stats.sold, (long long)stats.unsold,
+           (long long)stats.accepted);
+    printf("Rejected bids: %lld too low, %lld leading, %lld closed, %lld unknown auction\n", (long long)stats.rejected[TOO_LOW],
+           (long long)stats.rejected[LEADING], (long long)stats.rejected[AUCTION_CLOSED], (long long)stats.rejected[UNKNOWN_AUCTION]);
+    printf("Internal latency ns: mean %.0f, p50 %llu, p99 %llu, p99.9 %llu, max %llu\n", latency.mean(),
+           (unsigned long long)latency.percentile(50), (unsigned long long)latency.percentile(99),
+           (unsigned long long)latency.percentile(99.9), (unsigned long long)latency.max());
+    if (server.getLogStats())
     {
-        this->roundEndTime = roundEndTime;
+        const WalStats &log = *server.getLogStats();
+        printf("Write-ahead log: %lld records in %lld writes, %lld syncs (mean %.1f records, %.0f us)\n", (long long)log.records,
+               (long long)log.writes, (long long)log.syncs, log.syncs > 0 ? (double)log.records / log.syncs : 0.0,
+               log.syncs > 0 ? log.syncTime / 1000.0 / log.syncs : 0.0);
+    }
+    if (server.getLogError() != 0)
+    {
+        fprintf(stderr, "Write-ahead log: %s, the engine stopped\n", strerror(server.getLogError()));
+        return false;
+    }
+    return true;
+}
+
+ShardedServer *shardedServer = nullptr; // Sharded live engine stopped by a signal
 
-        // 5% chance of being irrational
-        if (Random() < 0.05)
+/**
+ * @brief Serves the sharded live engine until SIGINT or SIGTERM, then prints the counters of every shard.
+ *
+ * @param endpoint Endpoint of the engine.
+ * @param config Shards of the engine.
+ *
+ * @return false if the endpoint could not be opened
+ */
+bool runShards(const Endpoint &endpoint, const ShardConfig &config)
+{
+    ShardedServer server(endpoint, config);
+    if (!server.open())
+    {
+        perror("Live engine");
+        return false;
+    }
+    shardedServer = &server;
+    signal(SIGINT, [](int) { shardedServer->stop(); });
+    signal(SIGTERM, [](int) { shardedServer->stop(); });
+    printf("Live engine listening, %d shards\n", server.getShards());
+    fflush(stdout);
+    server.serve();
+
+    // Messages between the shards are requests for auctions of another shard, their answers and moved auctions
+    EngineStats total;
+    LatencyHistogram latency;
+    printf("%-6s %8s %10s %10s %10s %10s %10s %8s %8s %8s\n", "Shard", "busy %", "read", "executed", "auctions", "sent/s",
+           "recv/s", "moved in", "out", "hot s");
+    for (int shard = 0; shard < server.getShards(); shard++)
+    {
+        const ShardStats &stats = server.getStats(shard);
+        double seconds = max(stats.wall / 1e9, 1e-9);
+        printf("%-6d %8.1f %10lld %10lld %10lld %10.0f %10.0f %8lld %8lld %8.1f\n", shard,
+               100.0 * (stats.wall - stats.idle) / max<int64_t>(stats.wall, 1), (long long)stats.read,
+               (long long)stats.requests, (long long)stats.engine.opened, stats.sent / seconds, stats.received / seconds,
+               (long long)stats.movedIn, (long long)stats.movedOut, stats.hotRounds * config.interval);
+        total.accepted += stats.engine.accepted;
+        total.opened += stats.engine.opened;
+        total.sold += stats.engine.sold;
+        total.unsold += stats.engine.unsold;
+        total.requests += stats.engine.requests;
+        for (int status = TOO_LOW; status <= UNKNOWN_AUCTION; status++)
         {
-            this->valuation = INFINITY;
+            total.rejected[status] += stats.engine.rejected[status];
         }
+        latency.merge(stats.latency);
     }
+    printf("Live engine handled %lld requests, %lld auctions (%lld sold, %lld unsold), %lld bids accepted\n",
+           (long long)total.requests, (long long)total.opened, (long long)total.sold, (long long)total.unsold,
+           (long long)total.accepted);
+    printf("Rejected bids: %lld too low, %lld leading, %lld closed, %lld unknown auction\n", (long long)total.rejected[TOO_LOW],
+           (long long)total.rejected[LEADING], (long long)total.rejected[AUCTION_CLOSED], (long long)total.rejected[UNKNOWN_AUCTION]);
+    printf("Latency ns: mean %.0f, p50 %llu, p99 %llu, p99.9 %llu, max %llu\n", latency.mean(),
+           (unsigned long long)latency.percentile(50), (unsigned long long)latency.percentile(99),
+           (unsigned long long)latency.percentile(99.9), (unsigned long long)latency.max());
+    return true;
+}
+
+/**
+ * @brief Main function of the simulation.
+ */
+int main(int argc, char *argv[])
+{
+    AuctionConfig config;
 
-    /**
-     * @brief The behavior of the ratchet bidder.
-     */
-    void Behavior()
+    // Default values for input parameters
+    int numberOfItems = config.numberOfItems;
+    int numberOfBidders = config.numberOfBidders;
+    int singleItemDuration = config.singleItemDuration;
+    double auctionItemTimeout = config.singleItemDuration / 2;
+    bool proxyBidding = false;
+    double softClose = 0;
+    AuctionFormat format = ENGLISH;
+    double buyItNow = 0;
+    double reservePrice = 0;
+    int units = 1;
+    PricingRule pricing = UNIFORM;
+    int population = 0;
+    double learners = 0;
+    bool latency = false;
+    int servers = 0;
+    int queueCapacity = config.queueCapacity;
+    double serviceTime = config.serviceTime;
+    ServiceDistribution service = EXPONENTIAL_SERVICE;
+    double pacing = 0;
+    double pacingTick = config.pacingTick;
+    double pacingSpin = config.pacingSpin;
+    MarketConfig market;
+    bool marketplace = false;
+    LoadConfig load;
+    bool replay = false;
+    Endpoint stub;
+    bool serveStub = false;
+    Endpoint live;
+    bool serveEngine = false;
+    string ring;
+    WalConfig wal;
+    ShardConfig sharding;
+    EvolutionConfig evolution;
+    bool evolve = false;
+    evolution.workers = max<int>(thread::hardware_concurrency(), 1);
+    long seed = time(NULL);
+
+    // Parse command line arguments
+    for (int i = 1; i < argc; i++)
     {
-        while ((currentPrice < this->valuation) && (this->patience > Exponential(0.1)) && (Time < this->roundEndTime))
+        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
         {
-            if ((Time - lastUpdateTime) >= UPDATE_INTERVAL)
+            numberOfItems = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+        {
+            numberOfBidders = stod(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        {
+            singleItemDuration = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            auctionItemTimeout = stod(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+        {
+            softClose = stod(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "english") == 0)
             {
-                updatePatience();
-                lastUpdateTime = Time;
+                format = ENGLISH;
             }
-
-            Wait(max(this->patience, 0.2));
-
-            // Check if the bidder should bid
-            if ((Random() > this->patience) && ((currentPrice + minimalIncrement()) <= valuation))
+            else if (strcmp(argv[i], "first") == 0)
+            {
+                format = FIRST_PRICE;
+            }
+            else if (strcmp(argv[i], "second") == 0)
+            {
+                format = SECOND_PRICE;
+            }
+            else if (strcmp(argv[i], "dutch") == 0)
+            {
+                format = DUTCH;
+            }
+            else
             {
-                Wait(1);
-                if (Time >= this->roundEndTime)
-                {
-                    Terminate();
-                }
-                RatchetDecidedToBid.Insert(this);
-                Passivate();
+                fprintf(stderr, "Unknown auction format '%s'\n", argv[i]);
+                return EXIT_FAILURE;
             }
         }
-        if (this->patience <= 0)
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
         {
-            printf("[RATCHET] ran out of patience and stopped bidding.\n");
+            buyItNow = stod(argv[++i]);
         }
-        Terminate();
-    }
-
-    /**
-     * @brief Updates the patience of the ratchet bidder based on the time remaining in the auction of an item.
-     */
-    void updatePatience()
-    {
-        double normalizedTime = (SINGLE_ITEM_DURATION - (this->roundEndTime - Time)) / SINGLE_ITEM_DURATION;
-        if (normalizedTime < 0.75)
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
         {
-            this->patience = 1.0 - (Exponential(0.01));
+            reservePrice = stod(argv[++i]);
         }
-        else
+        else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc)
         {
-            double remainingTime = (normalizedTime - 0.75) / (1.0 - 0.75);
-            this->patience = 0.99 - 0.1 * pow(remainingTime, 5);
+            units = stoi(argv[++i]);
         }
-    }
-};
-
-/**
- * @class RatchetBids
- * @brief Represents the bidding process of ratchet bidders in an auction.
- */
-class RatchetBids : public Process
-{
-    void Behavior()
-    {
-        while (Time < ItemEndTime)
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
         {
-            Wait(0.1); // Time to process the bid
-            if (Time >= ItemEndTime)
+            i++;
+            if (strcmp(argv[i], "uniform") == 0)
             {
-                Passivate();
+                pricing = UNIFORM;
             }
-            if (!RatchetDecidedToBid.Empty())
+            else if (strcmp(argv[i], "discriminatory") == 0)
             {
-                if (!biddingFacility.Busy())
-                {
-                    Seize(biddingFacility);
-                    firstBidPlaced = true;
-                    currentPrice += minimalIncrement();
-                    if (LOGGING)
-                    {
-                        logSingleBid(currentPrice);
-                    }
-                    printf("[RATCHET] bidder placed a bid at time: %.2f. New price: %.2f\n", Time, currentPrice);
-                    lastBidder = RATCHET;
-                    returnFromQueues();
-                    Release(biddingFacility);
-                }
+                pricing = DISCRIMINATORY;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown pricing rule '%s'\n", argv[i]);
+                return EXIT_FAILURE;
             }
         }
-        Passivate();
-    }
-};
-
-/**
- * @class SnipingBidder
- * @brief Represents a sniping bidder strategy in an auction.
- *
- * @details
- * Sniping bidders bid higher than the current price by the minimum increment if the current price is lower than their item valuation.
- * The bidding behavior is influenced by human reaction time and network latency.
- *
- * @note Sniping bidders generally do not want to bid when the price is high and their price valuation is lower.
- *
- * @param valuation The maximum price a sniper is willing to pay for the item.
- * @param roundEndTime The time at which the auction round ends.
- */
-class SnipingBidder : public Process
-{
-private:
-    double valuation = 0;
-    double snipeDelay = Normal(0, 0.1 / 3);
-    double roundEndTime = 0;
-
-public:
-    /**
-     * @brief Constructs a SnipingBidder with a specified valuation and round end time.
-     * @param val The maximum price the sniper is willing to pay for the item.
-     * @param roundEndTime The time at which the auction round for an item ends.
-     */
-    SnipingBidder(double val, double roundEndTime) : valuation(val)
-    {
-        this->roundEndTime = roundEndTime;
-    }
-
-    /**
-     * @brief The behavior of the sniping bidder.
-     */
-    void Behavior()
-    {
-        // printf("[SNIPER] bidder created with valuation %.2f\n", valuation);
-        double snipeTime = this->roundEndTime - this->snipeDelay;
-        if (Time < snipeTime)
+        else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc)
         {
-            Wait(snipeTime - Time);
+            population = stoi(argv[++i]);
         }
-
-        Wait(Exponential(0.2)); // Reaction time
-        Wait(Exponential(0.1)); // Network latency
-
-        if (Time > this->roundEndTime)
+        else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc)
         {
-            Terminate();
+            learners = stod(argv[++i]);
         }
-
-        if ((currentPrice + minimalIncrement()) <= valuation)
+        else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc)
         {
-            printf("[SNIPER No. %lu] bidder decided to bid at time: %.2f\n", id(), Time);
-            SniperDecidedToBid.Insert(this);
-            Passivate();
+            servers = stoi(argv[++i]);
         }
-        Terminate();
-    }
-};
-
-/**
- * @class SniperBids
- * @brief Represents the bidding process of sniping bidders in an auction.
- */
-class SniperBids : public Process
-{
-    void Behavior()
-    {
-        while (Time < ItemEndTime)
+        else if (strcmp(argv[i], "-Q") == 0 && i + 1 < argc)
         {
-            Wait(0.1); // Time to process the bid
-            if (Time >= ItemEndTime)
+            queueCapacity = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+        {
+            serviceTime = stod(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-K") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "exponential") == 0)
+            {
+                service = EXPONENTIAL_SERVICE;
+            }
+            else if (strcmp(argv[i], "deterministic") == 0)
             {
-                Passivate();
+                service = DETERMINISTIC_SERVICE;
             }
-            if (!SniperDecidedToBid.Empty())
+            else if (strcmp(argv[i], "lognormal") == 0)
             {
-                if (!biddingFacility.Busy())
-                {
-                    Seize(biddingFacility);
-                    firstBidPlaced = true;
-                    currentPrice += minimalIncrement();
-                    if (LOGGING)
-                    {
-                        logSingleBid(currentPrice);
-                    }
-                    printf("[SNIPER No. %lu] bidder placed a bid at time: %.2f. New price: %.2f\n", SniperDecidedToBid.GetFirst()->id(), Time, currentPrice);
-                    lastBidder = SNIPER;
-                    returnFromQueues();
-                    Release(biddingFacility);
-                }
+                service = LOGNORMAL_SERVICE;
+            }
+            else
+            {
+                fprintf(stderr, "Unknown service time distribution '%s'\n", argv[i]);
+                return EXIT_FAILURE;
             }
         }
-        Passivate();
-    }
-};
-
-/**
- * @class BidderGenerator
- * @brief Generates bidders for an auction item.
- *
- * @details
- * The bidder generator creates a specified number of bidders for an auction item.
- *
- * @note The bidder generator generates agents, ratchet bidders, and snipers based on the probabilities of each strategy.
- * The probabilities are set according to the reference paper.
- *
- * @param roundEndTime The time at which the auction round for an item ends.
- * @param realPrice The real price of the item.
- *
- */
-class BidderGenerator : public Process
-{
-private:
-    double RoundEndTime = 0;
-    double RealPrice = 0;
-
-public:
-    /**
-     * @brief Constructs a BidderGenerator with a specified round end time and real price.
-     * @param roundEndTime The time at which the auction round for an item ends.
-     * @param realPrice The real price of the item.
-     */
-    BidderGenerator(double roundEndTime, double realPrice)
-    {
-        this->RoundEndTime = roundEndTime;
-        this->RealPrice = realPrice;
-    }
-
-    /**
-     * @brief The behavior of the bidder generator.
-     */
-    void Behavior()
-    {
-        int agents = 0;
-        int ratchets = 0;
-        int snipers = 0;
-        int roundBidders = max(Normal(NUMBER_OF_BIDDERS, NUMBER_OF_BIDDERS / 10 / 3), 0.0);
-        for (int i = 0; i < roundBidders; i++)
-        {
-            // Calculate probability of each strategy
-            // Agent-bidding: 40%
-            // Ratchet-bidding: 25%
-            // Sniping: 35%
-            // Follows the reference paper
-            double probability = Random();
-
-            // Wait between the potential bidders to simulate real auction
-            Wait(Exponential((SINGLE_ITEM_DURATION / 2) / NUMBER_OF_BIDDERS));
-
-            // Generate bidder with the given strategy
-            if (probability < 0.4)
+        else if ((strcmp(argv[i], "-G") == 0 || strcmp(argv[i], "-A") == 0) && i + 1 < argc)
+        {
+            bool generator = argv[i][1] == 'G';
+            i++;
+            if (!Endpoint::parse(argv[i], generator ? load.endpoint : stub))
             {
-                Process *agenProc = new AgentBidder(RealPrice * Normal(1.2, 0.5 / 2), this->RoundEndTime);
-                agenProc->Activate();
-                agents++;
+                fprintf(stderr, "Invalid endpoint '%s', use unix:path, tcp:host:port or http://host:port/path\n", argv[i]);
+                return EXIT_FAILURE;
             }
-            else if (probability < 0.65)
+            replay |= generator;
+            serveStub |= !generator;
+        }
+        else if (strcmp(argv[i], "-V") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (!Endpoint::parse(argv[i], live) || live.transport == HTTP_TRANSPORT)
             {
-                Process *ratchetProc = new RatchetBidder(RealPrice * Normal(1.2, 0.5 / 2), this->RoundEndTime);
-                ratchetProc->Activate();
-                ratchets++;
+                fprintf(stderr, "Invalid endpoint '%s', use unix:path or tcp:host:port\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            serveEngine = true;
+        }
+        else if (strcmp(argv[i], "-W") == 0 && i + 1 < argc)
+        {
+            ring = argv[++i];
+            if (ring.size() < 2 || ring[0] != '/' || ring.find('/', 1) != string::npos)
+            {
+                fprintf(stderr, "Invalid ring '%s', use /name\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc)
+        {
+            wal.path = argv[++i];
+        }
+        else if (strcmp(argv[i], "-y") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "write") == 0)
+            {
+                wal.durability = WAL_WRITE;
+            }
+            else if (strcmp(argv[i], "periodic") == 0)
+            {
+                wal.durability = WAL_PERIODIC;
+            }
+            else if (strcmp(argv[i], "group") == 0)
+            {
+                wal.durability = WAL_GROUP;
+            }
+            else if (strcmp(argv[i], "sync") == 0)
+            {
+                wal.durability = WAL_SYNC;
             }
             else
             {
-                // Snipers generally do not want to bid, when the price is high, and their price valuation is lower
-                Process *sniperProc = new SnipingBidder(RealPrice * Normal(1.2, 0.3 / 2), this->RoundEndTime);
-                sniperProc->Activate();
-                snipers++;
+                fprintf(stderr, "Unknown durability '%s'\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "-Y") == 0 && i + 1 < argc)
+        {
+            wal.interval = stod(argv[++i]) / 1000;
+        }
+        else if (strcmp(argv[i], "-N") == 0 && i + 1 < argc)
+        {
+            wal.batch = max(stoi(argv[++i]), 1);
+        }
+        else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc)
+        {
+            sharding.shards = stoi(argv[++i]);
+            if (sharding.shards < 1 || sharding.shards > ShardedServer::MAX_SHARDS)
+            {
+                fprintf(stderr, "The live engine runs 1 to %d shards\n", ShardedServer::MAX_SHARDS);
+                return EXIT_FAILURE;
             }
         }
-        printf("Generated %d agents, %d ratchets, %d snipers\n", agents, ratchets, snipers);
-        Terminate();
+        else if (strcmp(argv[i], "-e") == 0)
+        {
+            load.openItems = true;
+        }
+        else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc)
+        {
+            load.speedup = stod(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc)
+        {
+            load.connections = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc)
+        {
+            pacing = stod(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+        {
+            pacingTick = stod(argv[++i]) / 1000;
+        }
+        else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc)
+        {
+            pacingSpin = stod(argv[++i]) / 1e6;
+        }
+        else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc)
+        {
+            marketplace = true;
+            market.numberOfBidders = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            market.categories = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+        {
+            market.watchLimit = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc)
+        {
+            market.threads = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-O") == 0 && i + 1 < argc)
+        {
+            market.optimistic = true;
+            market.optimism = stod(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-E") == 0 && i + 1 < argc)
+        {
+            evolve = true;
+            evolution.generations = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            evolution.workers = stoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+        {
+            seed = stol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-p") == 0)
+        {
+            proxyBidding = true;
+        }
+        else if (strcmp(argv[i], "-l") == 0)
+        {
+            latency = true;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-i number_of_items] [-b number_of_bidders] [-d single_item_duration] [-t auction_item_timeout | '0' to disable] [-s soft_close_seconds] [-p] [-f english|first|second|dutch] [-n buy_it_now] [-r reserve] [-u units] [-m uniform|discriminatory] [-P population] [-L learner_share] [-l] [-B servers [-Q queue_capacity] [-k service_time] [-K exponential|deterministic|lognormal]] [-R pacing_ratio [-g tick_ms] [-z spin_us]] [-S seed] [-M marketplace_bidders [-c categories] [-w watched_items] [-T threads [-O optimism]]] [-E generations [-j workers]] [-G endpoint [-x speedup] [-C connections] [-e]] [-A endpoint] [-V endpoint [-W /ring] [-H shards] [-D log [-y write|periodic|group|sync] [-Y group_ms] [-N group_records]]]\n", argv[0]);
+            fprintf(stderr, "  -s  soft close, a bid in the last seconds extends the auction by the same time\n");
+            fprintf(stderr, "  -p  proxy bidding with the eBay increment table\n");
+            fprintf(stderr, "  -f  auction format: open ascending, sealed-bid first-price, sealed-bid second-price or descending Dutch clock\n");
+            fprintf(stderr, "  -n  Buy-It-Now price relative to the real price of the item\n");
+            fprintf(stderr, "  -r  reserve price relative to the real price of the item\n");
+            fprintf(stderr, "  -u  identical units of every item in the open ascending and Dutch auctions\n");
+            fprintf(stderr, "  -m  price paid by the winners of multiple units: the lowest accepted bid or the own bid\n");
+            fprintf(stderr, "  -P  persistent bidders sampled for every item, they keep their history and rating across items\n");
+            fprintf(stderr, "  -L  share of learning bidders, their shading and entry time policy is trained over the items\n");
+            fprintf(stderr, "  -l  bids travel over the network latency of the bidder (broadband, mobile or a sniping service)\n");
+            fprintf(stderr, "  -B  bids are processed by a backend of this many servers instead of the polled bidding facility\n");
+            fprintf(stderr, "  -Q  waiting room of the backend, a bid arriving at a full queue is rejected\n");
+            fprintf(stderr, "  -k  mean service time of a bid in the backend in seconds\n");
+            fprintf(stderr, "  -K  distribution of the service time, the lognormal one has a coefficient of variation of 2\n");
+            fprintf(stderr, "  -R  run in real time, simulated seconds per second of the wall clock\n");
+            fprintf(stderr, "  -g  wall-clock milliseconds between two pacing points of a real-time run\n");
+            fprintf(stderr, "  -z  microseconds busy-waited at the end of every pacing sleep instead of sleeping\n");
+            fprintf(stderr, "  -S  seed of the random number generator, the current time by default\n");
+            fprintf(stderr, "  -M  marketplace of concurrent items with persistent bidders watching several items (-i items, -d duration)\n");
+            fprintf(stderr, "  -T  threads of the marketplace, the results do not depend on their number\n");
+            fprintf(stderr, "  -O  run the threads optimistically (Time Warp) up to the given seconds ahead of GVT\n");
+            fprintf(stderr, "  -E  evolve the strategy mix by the replicator dynamics, every generation runs -i items\n");
+            fprintf(stderr, "  -j  worker processes of the evolution, the number of CPUs by default\n");
+            fprintf(stderr, "  -G  replay the simulated bids to unix:path, tcp:host:port or http://host:port/path in real time\n");
+            fprintf(stderr, "  -x  simulated seconds replayed per second of the wall clock\n");
+            fprintf(stderr, "  -C  connections of the replay, each waits for the acknowledgement of its bid before the next one\n");
+            fprintf(stderr, "  -e  open every item on the endpoint before its first bid, for the live engine\n");
+            fprintf(stderr, "  -A  serve a stub bid ingestion service acknowledging every bid on the endpoint until interrupted\n");
+            fprintf(stderr, "  -V  serve the live auction engine on unix:path or tcp:host:port until interrupted (-p for the increment table, -s for soft close)\n");
+            fprintf(stderr, "  -W  also serve local clients of the live engine through the shared-memory ring /name\n");
+            fprintf(stderr, "  -H  shards of the live engine, threads pinned to the cores, each owning a part of the auctions\n");
+            fprintf(stderr, "  -D  write-ahead log of the live engine, its auctions are recovered on start\n");
+            fprintf(stderr, "  -y  durability of an answered request: written, synced periodically, synced in a group (default) or synced alone\n");
+            fprintf(stderr, "  -Y  milliseconds a group of the log waits for more records at most, or between the periodic syncs\n");
+            fprintf(stderr, "  -N  records that close a group of the log at once\n");
+            return EXIT_FAILURE;
+        }
     }
-};
-
-/**
- * @class FirstBidTimeout
- * @brief Represents a timeout for the first bid in an auction.
- *
- * @details
- * The first bid timeout checks if a bid was placed in the first 30 seconds of an auction item.
- * If no bid was placed, the item is discarded.
- *
- * @param p The process of the auction item.
- * @param dt The time after which the timeout occurs.
- * @param firstBidPlaced The flag indicating if the first bid was placed.
- */
-class FirstBidTimeout : public Event
-{
-    Process *id;
-    bool *placed;
 
-public:
-    FirstBidTimeout(Process *p, int dt, bool *firstBidPlaced) : id(p)
+    if (serveStub)
     {
-        placed = firstBidPlaced;
-        Activate(Time + dt);
+        return runStub(stub) ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    void Behavior()
+    if (serveEngine && sharding.shards > 1)
     {
-        if (!*placed)
+        if (!ring.empty())
         {
-            printf("No bids were placed in the first 30 seconds, the item is discarded\n");
-            id->Cancel();
-            winners(NONE);
+            fprintf(stderr, "The shared-memory ring is served by a single shard only\n");
+            return EXIT_FAILURE;
         }
-        Cancel();
+        if (!wal.path.empty())
+        {
+            fprintf(stderr, "The write-ahead log is written by a single shard only\n");
+            return EXIT_FAILURE;
+        }
+        sharding.tiered = proxyBidding;
+        sharding.softClose = softClose;
+        return runShards(live, sharding) ? EXIT_SUCCESS : EXIT_FAILURE;
     }
-};
 
-/**
- * @class AuctionItem
- * @brief Represents an auction item.
- *
- * @details
- * The auction item generates bidders for the item and handles the auction process.
- *
- * @note The auction item is discarded if no bid is placed in the first 30 seconds.
- */
-class AuctionItem : public Process
-{
-public:
-    void Behavior()
+    if (serveEngine)
     {
-        Priority = 10;
-
-        // Set the end time of the item
-        ItemEndTime = Time + SINGLE_ITEM_DURATION;
-        itemNumber++;
-
-        firstBidPlaced = false;
+        return runEngine(live, ring, wal, proxyBidding, softClose) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-        // Generate the value of the item
-        double RealPrice = Exponential(1000 * Normal(1.0, 0.2));
-        printf("Created item with value %.2f\n", RealPrice);
+    if (marketplace)
+    {
+        market.numberOfItems = numberOfItems;
+        market.singleItemDuration = singleItemDuration;
+        market.seed = seed;
+        runMarketplace(market);
+        return EXIT_SUCCESS;
+    }
 
-        // Reset the last bidder
-        lastBidder = NONE;
+    // Sealed-bid items are resolved without simulation time, there is nothing to pace
+    if (pacing > 0 && (format == FIRST_PRICE || format == SECOND_PRICE))
+    {
+        fprintf(stderr, "Real-time pacing needs an open ascending or Dutch auction, sealed-bid items take no simulated time\n");
+        return EXIT_FAILURE;
+    }
 
-        // Starting price of the item
-        currentPrice = RealPrice * Normal(0.8, 0.2);
+    // Set the simulation parameters
+    config.numberOfItems = numberOfItems;
+    config.numberOfBidders = numberOfBidders;
+    config.singleItemDuration = singleItemDuration;
+    if (auctionItemTimeout == 0)
+    {
+        config.auctionItemTimeout = config.singleItemDuration;
+    }
+    else
+    {
+        config.auctionItemTimeout = auctionItemTimeout;
+    }
+    config.proxyBidding = proxyBidding;
+    config.softClose = softClose;
+    config.format = format;
+    config.buyItNow = buyItNow;
+    config.reservePrice = reservePrice;
+    config.units = units;
+    config.pricing = pricing;
+    config.population = population;
+    config.learners = learners;
+    config.latency = latency;
+    config.servers = servers;
+    config.queueCapacity = queueCapacity;
+    config.serviceTime = serviceTime;
+    config.service = service;
+    config.pacing = pacing;
+    config.pacingTick = pacingTick;
+    config.pacingSpin = pacingSpin;
+    config.verbose = true;
+    config.recordBids = false;
 
-        // Reset the current price
-        printf("Auction started for item valued at %.2f\n", currentPrice);
+    // Set a random seed
+    config.seed = seed;
 
-        AgentBidsProcess = new AgentBids();
-        RatchetBidsProcess = new RatchetBids();
-        SniperBidsProcess = new SniperBids();
-        AgentBidsProcess->Activate();
-        RatchetBidsProcess->Activate();
-        SniperBidsProcess->Activate();
+    if (evolve)
+    {
+        evolution.auction = config;
+        runEvolution(evolution);
+        return EXIT_SUCCESS;
+    }
 
-        // Create bidders
-        (new BidderGenerator(ItemEndTime, RealPrice))->Activate();
+    if (replay)
+    {
+        return runLoad(config, load) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-        // If there are no bidders in the first 30 seconds, the item is discarded
-        FirstBidTimeout *firstBidTimeout = new FirstBidTimeout(this, AUCTION_ITEM_TIMEOUT, &firstBidPlaced);
+    printf("Starting simulation with %d items, %d bidders, and %.2d seconds per item\n", numberOfItems, numberOfBidders, singleItemDuration);
 
-        printf("This auction will end at %.2f\n", ItemEndTime);
-        printf("Current time is %.2f\n", Time);
+    // Run the simulation
+    AuctionSimulator simulator(config);
+    if (LOGGING)
+    {
+        simulator.onBid(logSingleBid);
+    }
+    auto start = chrono::steady_clock::now();
+    const AuctionResults &results = simulator.run();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
 
-        // Wait until the end of the auction
-        Wait(SINGLE_ITEM_DURATION);
-        printf("Auction ended\n");
+    printf("Simulation finished\n");
+    if (format == FIRST_PRICE || format == SECOND_PRICE)
+    {
+        printf("Resolved %zu sealed-bid items in %.3f s (%.0f items/s)\n", results.items.size(), elapsed.count(), results.items.size() / elapsed.count());
+    }
 
-        // If a bid was placed, the item is sold
-        if (firstBidPlaced)
-        {
-            printf("Item sold at price %.2f\n", currentPrice);
-            printf("Winner: %d\n", lastBidder);
-            winners(lastBidder);
-            winnerStats[lastBidder + 1]++;
-        }
-        else
+    if (softClose > 0)
+    {
+        long extensions = 0;
+        long reschedules = 0;
+        for (const ItemResult &item : results.items)
         {
-            // Should not happen, it is caught by the timeout
-            printf("Item not sold (no bids)\n");
+            extensions += item.extensions;
+            reschedules += item.reschedules;
         }
-
-        // Terminate the bids processes
-        AgentBidsProcess->Terminate();
-        RatchetBidsProcess->Terminate();
-        SniperBidsProcess->Terminate();
-        delete firstBidTimeout;
-        Terminate();
+        printf("Soft close: %ld extensions, %ld rescheduled waits, sniper win share %.1f%%\n",
+               extensions, reschedules, 100.0 * results.winnerStats[SNIPER + 1] / max<size_t>(results.items.size(), 1));
     }
-};
 
-/**
- * @class Auction
- * @brief Represents an auction process for a set of auction items.
- */
-class Auction : public Process
-{
-public:
-    /**
-     * @brief The behavior of the auction process.
-     */
-    void Behavior()
+    if (units > 1 || format == DUTCH)
     {
-        while (itemNumber < NUMBER_OF_ITEMS)
+        long offered = 0;
+        long sold = 0;
+        double revenue = 0;
+        for (const ItemResult &item : results.items)
         {
-            // Indicates the end of the auction for a single item
-            Seize(runningAuction);
-            printf("AUCTION STARTED\n");
-
-            // Create and activate a new auction item
-            AuctionItem *item = new AuctionItem();
-            item->Activate();
-
-            returnFromQueues();
-            // Pause between items
-            Wait(SINGLE_ITEM_DURATION + 30);
-
-            Release(runningAuction);
+            offered += item.units;
+            sold += item.unitsSold;
+            revenue += item.revenue;
         }
-        printf("All items auctioned!\n");
+        printf("Units: %ld of %ld sold, revenue %.2f (%.2f per unit), %s pricing\n",
+               sold, offered, revenue, revenue / max<long>(sold, 1), pricing == UNIFORM ? "uniform" : "discriminatory");
     }
-};
 
-/**
- * @brief Main function of the simulation.
- */
-int main(int argc, char *argv[])
-{
-    // Default values for input parameters
-    int numberOfItems = NUMBER_OF_ITEMS;
-    int numberOfBidders = NUMBER_OF_BIDDERS;
-    int singleItemDuration = SINGLE_ITEM_DURATION;
-    double auctionItemTimeout = SINGLE_ITEM_DURATION / 2;
-
-    // Parse command line arguments
-    for (int i = 1; i < argc; i++)
+    if (population > 0)
     {
-        if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+        long active = 0;
+        long entered = 0;
+        long wins = 0;
+        long repeatWinners = 0;
+        for (const BidderRecord &bidder : results.bidders)
         {
-            numberOfItems = stoi(argv[++i]);
-        }
-        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
-        {
-            numberOfBidders = stod(argv[++i]);
+            active += bidder.items > 0;
+            entered += bidder.items;
+            wins += bidder.wins;
+            repeatWinners += bidder.wins > 1;
         }
-        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+        long returning = 0;
+        for (const ItemResult &item : results.items)
         {
-            singleItemDuration = stoi(argv[++i]);
+            returning += item.returning;
         }
-        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        printf("Population: %ld of %d bidders active, %.2f items and %.2f wins per active bidder, %ld repeat winners, %.1f%% returning bidders\n",
+               active, population, (double)entered / max(active, 1L), (double)wins / max(active, 1L), repeatWinners,
+               100.0 * returning / max(entered, 1L));
+    }
+
+    if (learners > 0)
+    {
+        // Wins per generated bidder compare the strategies independently of their shares
+        long bidders[4] = {0, 0, 0, 0};
+        for (const ItemResult &item : results.items)
         {
-            auctionItemTimeout = stod(argv[++i]);
+            bidders[AGENT] += item.agents;
+            bidders[RATCHET] += item.ratchets;
+            bidders[SNIPER] += item.snipers;
+            bidders[LEARNER] += item.learners;
         }
-        else
+        long sold = results.items.size() - results.winnerStats[0];
+        printf("Win share: agent %.1f%%, ratchet %.1f%%, sniper %.1f%%, learner %.1f%% of %ld sold items\n",
+               100.0 * results.winnerStats[AGENT + 1] / max(sold, 1L), 100.0 * results.winnerStats[RATCHET + 1] / max(sold, 1L),
+               100.0 * results.winnerStats[SNIPER + 1] / max(sold, 1L), 100.0 * results.winnerStats[LEARNER + 1] / max(sold, 1L), sold);
+        printf("Wins per 1000 bidders: agent %.2f, ratchet %.2f, sniper %.2f, learner %.2f\n",
+               1000.0 * results.winnerStats[AGENT + 1] / max(bidders[AGENT], 1L), 1000.0 * results.winnerStats[RATCHET + 1] / max(bidders[RATCHET], 1L),
+               1000.0 * results.winnerStats[SNIPER + 1] / max(bidders[SNIPER], 1L), 1000.0 * results.winnerStats[LEARNER + 1] / max(bidders[LEARNER], 1L));
+        const vector<double> &policy = results.policy;
+        printf("Learned policy: shading weights (%.3f, %.3f, %.3f), timing weights (%.3f, %.3f, %.3f), reward baseline %.4f\n",
+               policy[0], policy[1], policy[2], policy[3], policy[4], policy[5], policy[6]);
+    }
+
+    if (latency)
+    {
+        const char *names[3] = {"broadband", "mobile", "datacenter"};
+        for (int connection = BROADBAND; connection <= DATACENTER; connection++)
         {
-            fprintf(stderr, "Usage: %s [-i number_of_items] [-b number_of_bidders] [-d single_item_duration] [-t auction_item_timeout | '0' to disable]\n", argv[0]);
-            return EXIT_FAILURE;
+            const LatencyStats &stats = results.latency[connection];
+            int64_t submitted = max<int64_t>(stats.submitted, 1);
+            printf("Latency %-10s: %lld bidders, mean latency %.1f ms, %lld bids, %.1f%% late, %.2f wins per 1000 bidders\n",
+                   names[connection], (long long)stats.bidders, 1000 * stats.delay / submitted, (long long)stats.bids,
+                   100.0 * stats.late / submitted, 1000.0 * stats.wins / max<int64_t>(stats.bidders, 1));
         }
+        printf("Sniper win share %.1f%%\n", 100.0 * results.winnerStats[SNIPER + 1] / max<size_t>(results.items.size(), 1));
     }
 
-    // Set the simulation parameters
-    NUMBER_OF_ITEMS = numberOfItems;
-    NUMBER_OF_BIDDERS = numberOfBidders;
-    SINGLE_ITEM_DURATION = singleItemDuration;
-    if (auctionItemTimeout == 0)
+    if (pacing > 0)
     {
-        AUCTION_ITEM_TIMEOUT = SINGLE_ITEM_DURATION;
+        // The lag counts the pacing points the simulation reached late, the jitter the wake-ups of the others
+        const PacingStats &stats = results.pacing;
+        double simulated = stats.ticks * pacingTick * pacing;
+        printf("Paced %.1f simulated seconds at %gx in %.3f s of wall clock (%.3f s expected), %lld pacing points, %lld late (%.2f%%)\n",
+               simulated, pacing, stats.seconds, simulated / pacing, (long long)stats.ticks, (long long)stats.late,
+               100.0 * stats.late / max<int64_t>(stats.ticks, 1));
+        printf("Lag    us: mean %8.1f, p50 %8.1f, p99 %8.1f, p99.9 %8.1f, max %8.1f\n", stats.lag.mean() / 1000,
+               stats.lag.percentile(50) / 1000.0, stats.lag.percentile(99) / 1000.0, stats.lag.percentile(99.9) / 1000.0,
+               stats.lag.max() / 1000.0);
+        printf("Jitter us: mean %8.1f, p50 %8.1f, p99 %8.1f, p99.9 %8.1f, max %8.1f\n", stats.jitter.mean() / 1000,
+               stats.jitter.percentile(50) / 1000.0, stats.jitter.percentile(99) / 1000.0, stats.jitter.percentile(99.9) / 1000.0,
+               stats.jitter.max() / 1000.0);
     }
-    else
+
+    if (servers > 0)
     {
-        AUCTION_ITEM_TIMEOUT = auctionItemTimeout;
+        // Load of the backend by the second of the auction, utilization is relative to the items open in the second
+        BackendSecond total{};
+        for (const BackendSecond &second : results.backend)
+        {
+            total.arrivals += second.arrivals;
+            total.rejected += second.rejected;
+            total.served += second.served;
+            total.expired += second.expired;
+            total.wait += second.wait;
+            total.maxWait = max(total.maxWait, second.maxWait);
+            total.busy += second.busy;
+            total.maxQueue = max(total.maxQueue, second.maxQueue);
+            total.items += second.items;
+        }
+        printf("Backend: %d servers, %lld bids, %.2f%% rejected, %lld expired, mean wait %.1f ms, max wait %.1f ms, max queue %d, utilization %.1f%%\n",
+               servers, (long long)total.arrivals, 100.0 * total.rejected / max<int64_t>(total.arrivals, 1), (long long)total.expired,
+               1000 * total.wait / max<int64_t>(total.served, 1), 1000 * total.maxWait, total.maxQueue,
+               100 * total.busy / max(servers * (double)total.items, 1.0));
+        printf("%8s %10s %9s %9s %11s %11s %9s %7s\n", "second", "arrivals", "rejected", "expired", "mean wait", "max wait", "max queue", "util");
+        for (size_t i = 0; i < results.backend.size(); i++)
+        {
+            const BackendSecond &second = results.backend[i];
+            printf("%8zu %10lld %9lld %9lld %8.1f ms %8.1f ms %9d %6.1f%%\n", i, (long long)second.arrivals, (long long)second.rejected,
+                   (long long)second.expired, 1000 * second.wait / max<int64_t>(second.served, 1), 1000 * second.maxWait, second.maxQueue,
+                   100 * second.busy / max(servers * (double)second.items, 1.0));
+        }
     }
 
-    printf("Starting simulation with %d items, %d bidders, and %.2d seconds per item\n", numberOfItems, numberOfBidders, singleItemDuration);
-
-    // Set a random seed
-    RandomSeed(time(NULL));
-
-    // The simulation time
-    Init(0, (SINGLE_ITEM_DURATION + 30) * NUMBER_OF_ITEMS); // Single item duration + 30 seconds between items
-
-    // Run the simulation
-    (new Auction)->Activate();
-    Run();
-
-    printf("Simulation finished\n");
-
     // Statistics
-    SetOutput("stats.out");
-    biddingFacility.Output();
-    winners.Output();
-    runningAuction.Output();
+    simulator.writeStats("stats.out");
     if (LOG_STRATEGIES)
     {
-        logStrategiesResults();
+        logStrategiesResults(results.winnerStats);
     }
-}
\ No newline at end of file
+}
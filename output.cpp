@@ -0,0 +1,433 @@
+/**
+ * @file output.cpp
+ * @brief Buffered file output through io_uring
+ * The ring is set up by the raw system calls of linux/io_uring.h. The submission and completion rings are shared
+ * with the kernel, their heads and tails are read and written with acquire and release ordering.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include "output.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+
+const unsigned RING_ENTRIES = 8;  // Entries of the submission ring, a write of every buffer and an fsync fit in
+const uint64_t FSYNC_TAG = ~0ULL; // User data of the fsync entry, the writes carry the index of their buffer
+
+int ioUringSetup(unsigned entries, io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+int ioUringEnter(int ring, unsigned submit, unsigned wait, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring, submit, wait, flags, nullptr, 0);
+}
+
+int ioUringRegister(int ring, unsigned opcode, const void *argument, unsigned count)
+{
+    return (int)syscall(__NR_io_uring_register, ring, opcode, argument, count);
+}
+
+unsigned loadAcquire(unsigned *value)
+{
+    return atomic_ref<unsigned>(*value).load(memory_order_acquire);
+}
+
+void storeRelease(unsigned *value, unsigned stored)
+{
+    atomic_ref<unsigned>(*value).store(stored, memory_order_release);
+}
+
+} // namespace
+
+/**
+ * @struct OutputFile::Ring
+ * @brief The mapped rings of an io_uring instance.
+ */
+struct OutputFile::Ring
+{
+    int descriptor = -1;
+    void *submissions = MAP_FAILED; // Submission ring, also the completion ring with IORING_FEAT_SINGLE_MMAP
+    size_t submissionsSize = 0;
+    void *completions = MAP_FAILED; // Completion ring if mapped separately
+    size_t completionsSize = 0;
+    io_uring_sqe *entries = (io_uring_sqe *)MAP_FAILED;
+    size_t entriesSize = 0;
+    unsigned *sqTail = nullptr;
+    unsigned *sqMask = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned *cqMask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+    unsigned queued = 0;          // Entries queued since the last submission
+    io_uring_sqe *last = nullptr; // Entry queued last
+    bool registered = false;      // Flag if the buffers are registered
+
+    ~Ring()
+    {
+        if (this->entries != MAP_FAILED)
+        {
+            munmap(this->entries, this->entriesSize);
+        }
+        if (this->completions != MAP_FAILED && this->completions != this->submissions)
+        {
+            munmap(this->completions, this->completionsSize);
+        }
+        if (this->submissions != MAP_FAILED)
+        {
+            munmap(this->submissions, this->submissionsSize);
+        }
+        if (this->descriptor >= 0)
+        {
+            ::close(this->descriptor);
+        }
+    }
+
+    /**
+     * @brief Creates the instance and maps its rings.
+     * @return false on an error (errno is set)
+     */
+    bool create()
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        this->descriptor = ioUringSetup(RING_ENTRIES, &params);
+        if (this->descriptor < 0)
+        {
+            return false;
+        }
+        this->submissionsSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        this->completionsSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+        {
+            this->submissionsSize = this->completionsSize = max(this->submissionsSize, this->completionsSize);
+        }
+        this->submissions = mmap(nullptr, this->submissionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 this->descriptor, IORING_OFF_SQ_RING);
+        if (this->submissions == MAP_FAILED)
+        {
+            return false;
+        }
+        this->completions = single ? this->submissions
+                                   : mmap(nullptr, this->completionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                          this->descriptor, IORING_OFF_CQ_RING);
+        if (this->completions == MAP_FAILED)
+        {
+            return false;
+        }
+        this->entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+        this->entries = (io_uring_sqe *)mmap(nullptr, this->entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                             this->descriptor, IORING_OFF_SQES);
+        if (this->entries == MAP_FAILED)
+        {
+            return false;
+        }
+        char *submissions = (char *)this->submissions;
+        char *completions = (char *)this->completions;
+        this->sqTail = (unsigned *)(submissions + params.sq_off.tail);
+        this->sqMask = (unsigned *)(submissions + params.sq_off.ring_mask);
+        this->sqArray = (unsigned *)(submissions + params.sq_off.array);
+        this->cqHead = (unsigned *)(completions + params.cq_off.head);
+        this->cqTail = (unsigned *)(completions + params.cq_off.tail);
+        this->cqMask = (unsigned *)(completions + params.cq_off.ring_mask);
+        this->cqes = (io_uring_cqe *)(completions + params.cq_off.cqes);
+        return true;
+    }
+
+    /**
+     * @brief Queues an entry, visible to the kernel once it is submitted.
+     * @return The cleared entry
+     */
+    io_uring_sqe &queue(uint64_t tag)
+    {
+        unsigned tail = *this->sqTail;
+        unsigned index = tail & *this->sqMask;
+        io_uring_sqe &entry = this->entries[index];
+        memset(&entry, 0, sizeof(entry));
+        entry.user_data = tag;
+        this->sqArray[index] = index;
+        storeRelease(this->sqTail, tail + 1);
+        this->queued++;
+        this->last = &entry;
+        return entry;
+    }
+};
+
+OutputFile::OutputFile() {}
+
+OutputFile::~OutputFile()
+{
+    close();
+    for (Buffer &buffer : this->buffers)
+    {
+        free(buffer.data);
+    }
+}
+
+bool OutputFile::open(const string &path, bool append, OutputBackend backend)
+{
+    close();
+    for (Buffer &buffer : this->buffers)
+    {
+        if (!buffer.data && !(buffer.data = (char *)aligned_alloc(4096, BUFFER_SIZE)))
+        {
+            errno = ENOMEM;
+            return false;
+        }
+        buffer.used = buffer.submitted = 0;
+    }
+    this->file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? 0 : O_TRUNC), 0644);
+    if (this->file < 0)
+    {
+        return false;
+    }
+    this->offset = append ? lseek(this->file, 0, SEEK_END) : 0;
+    this->current = 0;
+    this->inFlight = 0;
+    this->syncing = false;
+    this->stats = OutputStats();
+
+    if (backend != OUTPUT_PWRITE)
+    {
+        // The registration pins the buffers, it fails beyond the locked memory limit and the writes then name them
+        this->ring = new Ring();
+        if (this->ring->create())
+        {
+            iovec vectors[BUFFERS];
+            for (int i = 0; i < BUFFERS; i++)
+            {
+                vectors[i] = {this->buffers[i].data, BUFFER_SIZE};
+            }
+            this->ring->registered = ioUringRegister(this->ring->descriptor, IORING_REGISTER_BUFFERS, vectors, BUFFERS) == 0;
+        }
+        else
+        {
+            int error = errno;
+            delete this->ring;
+            this->ring = nullptr;
+            if (backend == OUTPUT_URING)
+            {
+                ::close(this->file);
+                this->file = -1;
+                errno = error;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool OutputFile::write(const void *data, size_t size)
+{
+    const char *bytes = (const char *)data;
+    while (size > 0)
+    {
+        Buffer &buffer = this->buffers[this->current];
+        size_t copied = min(size, BUFFER_SIZE - buffer.used);
+        memcpy(buffer.data + buffer.used, bytes, copied);
+        buffer.used += copied;
+        bytes += copied;
+        size -= copied;
+        if (buffer.used == BUFFER_SIZE && !flush())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OutputFile::complete(Buffer &buffer, size_t written)
+{
+    while (written < buffer.used)
+    {
+        ssize_t result = pwrite(this->file, buffer.data + written, buffer.used - written, buffer.offset + written);
+        this->stats.pwrites++;
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            errno = result < 0 ? errno : EIO;
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+bool OutputFile::queue()
+{
+    Buffer &buffer = this->buffers[this->current];
+    if (buffer.used == 0)
+    {
+        return true;
+    }
+    buffer.offset = this->offset;
+    this->offset += buffer.used;
+    this->stats.bytes += buffer.used;
+    this->stats.writes++;
+    if (!this->ring)
+    {
+        bool written = complete(buffer, 0);
+        buffer.used = 0;
+        return written;
+    }
+
+    io_uring_sqe &entry = this->ring->queue(this->current);
+    entry.opcode = this->ring->registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    entry.fd = this->file;
+    entry.addr = (uint64_t)(uintptr_t)buffer.data;
+    entry.len = buffer.used;
+    entry.off = buffer.offset;
+    entry.buf_index = this->current;
+    buffer.submitted = buffer.used;
+    this->inFlight++;
+    this->current = (this->current + 1) % BUFFERS;
+    return true;
+}
+
+bool OutputFile::enter(Wait wait)
+{
+    int error = 0;
+    while (true)
+    {
+        // Reaps the completions, a short write is finished by pwrite
+        unsigned head = *this->ring->cqHead;
+        unsigned tail = loadAcquire(this->ring->cqTail);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe &completion = this->ring->cqes[head & *this->ring->cqMask];
+            if (completion.user_data == FSYNC_TAG)
+            {
+                // A short write breaks the link, the fsync is cancelled and repeated once the write is finished
+                this->syncing = false;
+                if (completion.res == -ECANCELED && fdatasync(this->file) != 0)
+                {
+                    error = errno;
+                }
+                else if (completion.res < 0 && completion.res != -ECANCELED)
+                {
+                    error = -completion.res;
+                }
+                continue;
+            }
+            Buffer &buffer = this->buffers[completion.user_data];
+            if (completion.res < 0)
+            {
+                error = -completion.res;
+            }
+            else if ((size_t)completion.res < buffer.submitted && !complete(buffer, completion.res))
+            {
+                error = errno;
+            }
+            buffer.used = buffer.submitted = 0;
+            this->inFlight--;
+        }
+        storeRelease(this->ring->cqHead, head);
+
+        bool done = wait == WAIT_CURRENT ? this->buffers[this->current].submitted == 0 : this->inFlight == 0 && !this->syncing;
+        unsigned queued = this->ring->queued;
+        if (queued == 0 && (done || error != 0))
+        {
+            errno = error;
+            return error == 0;
+        }
+        unsigned waited = done ? 0 : wait == WAIT_CURRENT ? 1 : this->inFlight + this->syncing;
+        int submitted = ioUringEnter(this->ring->descriptor, queued, waited, waited > 0 ? IORING_ENTER_GETEVENTS : 0);
+        this->stats.enters++;
+        this->stats.waits += wait == WAIT_CURRENT && waited > 0;
+        if (submitted < 0 && errno != EINTR)
+        {
+            return false;
+        }
+        this->ring->queued -= submitted > 0 ? submitted : 0;
+    }
+}
+
+bool OutputFile::flush()
+{
+    if (this->file < 0)
+    {
+        return true;
+    }
+    return queue() && (!this->ring || enter(WAIT_CURRENT));
+}
+
+bool OutputFile::drain()
+{
+    if (this->file < 0)
+    {
+        return true;
+    }
+    return queue() && (!this->ring || enter(WAIT_ALL));
+}
+
+bool OutputFile::sync()
+{
+    if (this->file < 0)
+    {
+        return true;
+    }
+    int earlier = this->inFlight;
+    if (!queue())
+    {
+        return false;
+    }
+    this->stats.syncs++;
+    if (!this->ring)
+    {
+        return fdatasync(this->file) == 0;
+    }
+
+    // The fsync starts once the writes before it completed, the writes and the fsync cost one system call. A single
+    // write is linked to the fsync, earlier writes still in flight make the fsync drain the whole ring.
+    bool linked = earlier == 0 && this->inFlight == 1;
+    if (linked)
+    {
+        this->ring->last->flags |= IOSQE_IO_LINK;
+    }
+    io_uring_sqe &entry = this->ring->queue(FSYNC_TAG);
+    entry.opcode = IORING_OP_FSYNC;
+    entry.fd = this->file;
+    entry.flags = linked || this->inFlight == 0 ? 0 : IOSQE_IO_DRAIN;
+    entry.fsync_flags = IORING_FSYNC_DATASYNC;
+    this->syncing = true;
+    return enter(WAIT_SYNC);
+}
+
+bool OutputFile::close()
+{
+    if (this->file < 0)
+    {
+        return true;
+    }
+    bool drained = drain();
+    int error = errno;
+    delete this->ring;
+    this->ring = nullptr;
+    bool closed = ::close(this->file) == 0;
+    this->file = -1;
+    if (!drained)
+    {
+        errno = error;
+    }
+    return drained && closed;
+}
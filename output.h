@@ -0,0 +1,200 @@
+/**
+ * @file output.h
+ * @brief Buffered file output through io_uring
+ * Output files (the bid log, the result files and the write-ahead log) are filled in a few large buffers registered
+ * with an io_uring instance, a full buffer is submitted as one write at its offset in the file and the next buffer
+ * is filled meanwhile. A sync submits the waiting writes and an fdatasync ordered behind them by one system call.
+ * Without io_uring (an old kernel, or one that disables it) the buffers are written by pwrite and synced by
+ * fdatasync. Plain appending gains nothing from io_uring, so the bid log and the result files use pwrite; the
+ * write-ahead log uses io_uring, which halves the system calls of its group commits.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * @enum OutputBackend
+ * @brief Way the buffers reach the file.
+ */
+enum OutputBackend
+{
+    OUTPUT_AUTO,  // io_uring if the kernel offers it, pwrite otherwise
+    OUTPUT_URING, // io_uring only, open() fails without it
+    OUTPUT_PWRITE // pwrite and fdatasync
+};
+
+/**
+ * @struct OutputStats
+ * @brief Counters of an output file.
+ */
+struct OutputStats
+{
+    int64_t bytes = 0;   // Bytes written
+    int64_t writes = 0;  // Buffers written, by io_uring or pwrite
+    int64_t syncs = 0;   // Syncs of the file
+    int64_t enters = 0;  // Calls of io_uring_enter
+    int64_t pwrites = 0; // Calls of pwrite
+    int64_t waits = 0;   // Times a full buffer waited for a write in flight
+};
+
+/**
+ * @class OutputFile
+ * @brief A file written sequentially by a single thread.
+ *
+ * @details
+ * The file keeps its own offset, so an appended file is written at its size at open() and the writes of the buffers
+ * may complete in any order. flush() submits the filled part of the current buffer without waiting, drain() waits
+ * until every write completed and sync() also makes the data durable. The buffers are registered with the ring, so
+ * the kernel does not map them for every write; if the registration is refused (the locked memory limit) the writes
+ * name the buffers by their address instead.
+ */
+class OutputFile
+{
+public:
+    static const size_t BUFFER_SIZE = 1 << 18; // Bytes of a buffer
+    static const int BUFFERS = 4;               // Buffers, at most BUFFERS - 1 writes are in flight while one fills
+
+private:
+    struct Ring;
+
+    struct Buffer
+    {
+        char *data = nullptr;
+        size_t used = 0;      // Filled bytes
+        size_t submitted = 0; // Bytes of the write in flight, 0 if none
+        int64_t offset = 0;   // Offset of the first byte in the file, once submitted
+    };
+
+    /**
+     * @enum Wait
+     * @brief Completions enter() waits for.
+     */
+    enum Wait
+    {
+        WAIT_CURRENT, // Until the current buffer is free
+        WAIT_ALL,     // Until no write is in flight
+        WAIT_SYNC     // Until no write is in flight and the fsync completed
+    };
+
+    int file = -1;
+    int64_t offset = 0;   // Offset of the first byte of the current buffer in the file
+    Buffer buffers[BUFFERS];
+    int current = 0;      // Buffer being filled
+    int inFlight = 0;     // Writes submitted and not completed
+    bool syncing = false; // Flag if an fsync was submitted and did not complete
+    Ring *ring = nullptr; // io_uring instance, nullptr with pwrite
+    OutputStats stats;
+
+    /**
+     * @brief Queues the write of the current buffer in the ring and moves to the next buffer, or writes it by pwrite.
+     * @return false on an error (errno is set)
+     */
+    bool queue();
+
+    /**
+     * @brief Writes the rest of a buffer by pwrite, after a short write of the ring or for the pwrite backend.
+     * @return false on an error (errno is set)
+     */
+    bool complete(Buffer &buffer, size_t written);
+
+    /**
+     * @brief Submits the queued entries of the ring and reaps the completions.
+     * @param wait Completions waited for.
+     * @return false on an error (errno is set)
+     */
+    bool enter(Wait wait);
+
+public:
+    OutputFile();
+    OutputFile(const OutputFile &) = delete;
+    OutputFile &operator=(const OutputFile &) = delete;
+    ~OutputFile();
+
+    /**
+     * @brief Opens a file for writing.
+     * @param path Path of the file, created if it does not exist.
+     * @param append Flag if the file is appended to instead of truncated.
+     * @param backend Way the buffers reach the file.
+     * @return false on an error (errno is set)
+     */
+    bool open(const std::string &path, bool append = false, OutputBackend backend = OUTPUT_AUTO);
+
+    /**
+     * @brief Appends bytes, full buffers are submitted on the way.
+     * @return false on an error (errno is set)
+     */
+    bool write(const void *data, size_t size);
+
+    bool write(const std::string &text) { return write(text.data(), text.size()); }
+
+    /**
+     * @brief Appends formatted text, like fprintf.
+     * @return false on an error (errno is set)
+     */
+    template <typename... Arguments>
+    bool print(const char *format, Arguments... arguments)
+    {
+        Buffer &buffer = this->buffers[this->current];
+        size_t space = BUFFER_SIZE - buffer.used;
+        int length = snprintf(buffer.data + buffer.used, space, format, arguments...);
+        if (length < 0)
+        {
+            return false;
+        }
+        if ((size_t)length < space)
+        {
+            buffer.used += length;
+            return true;
+        }
+        // The text did not fit, it is formatted again into a string of its size
+        std::string text(length + 1, '\0');
+        snprintf(text.data(), text.size(), format, arguments...);
+        return write(text.data(), length);
+    }
+
+    /**
+     * @brief Submits the appended bytes without waiting for them.
+     * @return false on an error (errno is set)
+     */
+    bool flush();
+
+    /**
+     * @brief Submits the appended bytes and waits until they are written to the kernel.
+     * @return false on an error (errno is set)
+     */
+    bool drain();
+
+    /**
+     * @brief Writes the appended bytes and makes them durable, by fdatasync.
+     * @return false on an error (errno is set)
+     */
+    bool sync();
+
+    /**
+     * @brief Drains and closes the file.
+     * @return false on an error (errno is set)
+     */
+    bool close();
+
+    /**
+     * @brief Appended bytes not submitted yet.
+     */
+    size_t buffered() const { return this->buffers[this->current].used; }
+
+    /**
+     * @brief Size of the file including the appended bytes.
+     */
+    int64_t size() const { return this->offset + this->buffers[this->current].used; }
+
+    bool isOpen() const { return this->file >= 0; }
+    bool isUring() const { return this->ring != nullptr; }
+    const OutputStats &getStats() const { return this->stats; }
+};
+
+#endif // OUTPUT_H
@@ -0,0 +1,69 @@
+/**
+ * @file pacer.h
+ * @brief Low-jitter sleeping until a deadline of the wall clock
+ * The thread sleeps by clock_nanosleep until shortly before the deadline and busy-waits the rest, the wake-up latency
+ * of the kernel timer (tens of microseconds, more under load) is spent in the sleep instead of after the deadline.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef PACER_H
+#define PACER_H
+
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+
+/**
+ * @class Pacer
+ * @brief Sleeps until deadlines of the monotonic clock.
+ */
+class Pacer
+{
+private:
+    int64_t spin; // Nanoseconds before the deadline spent busy-waiting instead of sleeping
+
+public:
+    explicit Pacer(int64_t spin = 100000) : spin(spin) {}
+
+    /**
+     * @brief Current time of the monotonic clock in nanoseconds.
+     */
+    static int64_t now()
+    {
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return time.tv_sec * 1000000000LL + time.tv_nsec;
+    }
+
+    /**
+     * @brief Waits until a deadline, returns immediately if it has passed.
+     * @param deadline Time of the monotonic clock in nanoseconds.
+     * @return Wake-up time past the deadline in nanoseconds, negative if the deadline had passed before the call
+     */
+    int64_t sleepUntil(int64_t deadline) const
+    {
+        int64_t time = now();
+        if (time >= deadline)
+        {
+            return deadline - time;
+        }
+        if (deadline - time > this->spin)
+        {
+            int64_t wake = deadline - this->spin;
+            timespec until = {(time_t)(wake / 1000000000), (long)(wake % 1000000000)};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) == EINTR)
+            {
+            }
+        }
+        while ((time = now()) < deadline)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+        return time - deadline;
+    }
+};
+
+#endif // PACER_H
@@ -0,0 +1,114 @@
+/**
+ * @file population.h
+ * @brief Population of persistent bidders shared by all auction items
+ * Bidders keep their identity, strategy, history and rating across items, the table is a structure of arrays
+ * indexed by the bidder identifier, so every lookup and update is O(1).
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef POPULATION_H
+#define POPULATION_H
+
+#include <cstdint>
+#include <vector>
+#include "auction.h"
+
+/**
+ * @class BidderPopulation
+ * @brief Structure of arrays with the persistent bidders, the identifier of a bidder is its index.
+ */
+class BidderPopulation
+{
+private:
+    std::vector<int8_t> types;       // BidderType
+    std::vector<int8_t> connections; // LatencyClass, -1 without the latency model
+    std::vector<int32_t> items;      // Items the bidder entered
+    std::vector<int32_t> wins;       // Items (units) the bidder won
+    std::vector<int32_t> bids;       // Placed bids
+    std::vector<int32_t> ratings;    // Feedback rating
+    std::vector<int32_t> lastItem;   // The last item the bidder was drawn for, a bidder enters an item once
+
+public:
+    /**
+     * @brief Removes all bidders.
+     * @param capacity Expected number of bidders.
+     */
+    void reset(size_t capacity)
+    {
+        for (std::vector<int32_t> *column : {&this->items, &this->wins, &this->bids, &this->ratings, &this->lastItem})
+        {
+            column->clear();
+            column->reserve(capacity);
+        }
+        for (std::vector<int8_t> *column : {&this->types, &this->connections})
+        {
+            column->clear();
+            column->reserve(capacity);
+        }
+    }
+
+    /**
+     * @brief Adds a bidder.
+     * @param type Strategy of the bidder.
+     * @param rating Feedback rating of the bidder before the run.
+     * @return Identifier of the bidder
+     */
+    int32_t add(int type, int32_t rating)
+    {
+        this->types.push_back(type);
+        this->connections.push_back(-1);
+        this->items.push_back(0);
+        this->wins.push_back(0);
+        this->bids.push_back(0);
+        this->ratings.push_back(rating);
+        this->lastItem.push_back(0);
+        return this->types.size() - 1;
+    }
+
+    size_t size() const { return this->types.size(); }
+    int type(int32_t id) const { return this->types[id]; }
+    int connection(int32_t id) const { return this->connections[id]; }
+    void connect(int32_t id, int connection) { this->connections[id] = connection; }
+    int32_t itemsOf(int32_t id) const { return this->items[id]; }
+
+    /**
+     * @brief Draws a bidder for an item, the bidder is counted once it enters the item.
+     * @param id The bidder.
+     * @param itemNumber Number of the item, positive.
+     * @return false if the bidder was already drawn for the item
+     */
+    bool draw(int32_t id, int32_t itemNumber)
+    {
+        if (this->lastItem[id] == itemNumber)
+        {
+            return false;
+        }
+        this->lastItem[id] = itemNumber;
+        return true;
+    }
+
+    /**
+     * @brief Enters a drawn bidder into its item.
+     * @param id The bidder.
+     */
+    void enter(int32_t id) { this->items[id]++; }
+
+    void bid(int32_t id) { this->bids[id]++; }
+
+    /**
+     * @brief Records a won item (unit), the seller's feedback raises the rating of the bidder.
+     */
+    void win(int32_t id)
+    {
+        this->wins[id]++;
+        this->ratings[id]++;
+    }
+
+    BidderRecord record(int32_t id) const
+    {
+        return {id, this->types[id], this->items[id], this->wins[id], this->bids[id], this->ratings[id], this->connections[id]};
+    }
+};
+
+#endif // POPULATION_H
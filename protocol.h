@@ -0,0 +1,132 @@
+/**
+ * @file protocol.h
+ * @brief Line protocol of the live engine
+ * Parsing and formatting of the fields of the request and answer lines (engine.h). The bid path avoids the
+ * locale-aware strto* and printf functions. The answers go out on non-blocking sockets, so a client that stops
+ * reading holds back only its own answers.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cerrno>
+#include <cstdint>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include "currency.h"
+
+inline const char *const BID_REASONS[] = {"accepted", "low", "leading", "closed", "unknown"}; // Reasons of the BidStatus answers
+const size_t OUTPUT_LIMIT = 1 << 20; // Bytes of unsent answers above which the requests of a client wait
+
+/**
+ * @brief Parses an unsigned number after optional spaces.
+ * @param text The text, moved past the number.
+ */
+inline uint64_t parseUnsigned(const char *&text)
+{
+    while (*text == ' ')
+    {
+        text++;
+    }
+    uint64_t value = 0;
+    for (; *text >= '0' && *text <= '9'; text++)
+    {
+        value = value * 10 + (*text - '0');
+    }
+    return value;
+}
+
+/**
+ * @brief Parses an amount of money with at most two decimals into cents, further decimals are ignored.
+ * @param text The text, moved past the amount.
+ */
+inline Cents parseCents(const char *&text)
+{
+    Cents cents = parseUnsigned(text) * 100;
+    if (*text == '.')
+    {
+        text++;
+        for (Cents scale = 10; scale > 0 && *text >= '0' && *text <= '9'; scale /= 10, text++)
+        {
+            cents += (*text - '0') * scale;
+        }
+        while (*text >= '0' && *text <= '9')
+        {
+            text++;
+        }
+    }
+    return cents;
+}
+
+/**
+ * @brief Appends a space and an unsigned number.
+ */
+inline void appendUnsigned(std::string &text, uint64_t value)
+{
+    char digits[24];
+    int length = 0;
+    do
+    {
+        digits[sizeof(digits) - ++length] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    digits[sizeof(digits) - ++length] = ' ';
+    text.append(digits + sizeof(digits) - length, length);
+}
+
+/**
+ * @brief Appends a space and an amount of money in cents with two decimals.
+ */
+inline void appendCents(std::string &text, Cents cents)
+{
+    appendUnsigned(text, cents / 100);
+    text += '.';
+    text += '0' + cents % 100 / 10;
+    text += '0' + cents % 10;
+}
+
+/**
+ * @brief Sends the pending answers of a non-blocking socket as far as the socket takes them.
+ * @param socket The socket.
+ * @param output Answers not sent yet, the sent bytes are removed and the rest waits for the socket to be writable.
+ * @return false if the connection failed
+ */
+inline bool sendPending(int socket, std::string &output)
+{
+    size_t sent = 0;
+    while (sent < output.size())
+    {
+        ssize_t written = send(socket, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (written < 0)
+        {
+            return false;
+        }
+        sent += written;
+    }
+    output.erase(0, sent);
+    return true;
+}
+
+/**
+ * @brief Poll events of a client, a client behind on its answers stops being read.
+ * @param output Answers not sent yet.
+ * @param closing Flag if the client closed its side and only waits for its answers.
+ */
+inline short clientEvents(const std::string &output, bool closing)
+{
+    short wanted = output.empty() ? 0 : POLLOUT;
+    return closing || output.size() >= OUTPUT_LIMIT ? wanted : wanted | POLLIN;
+}
+
+#endif // PROTOCOL_H
@@ -0,0 +1,54 @@
+"""
+@file auction.py
+@brief Python interface of the auction simulation
+Runs the simulation in-process and returns the results as numpy structured arrays
+that share memory with the simulator (no copy is made).
+
+@authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+"""
+
+import numpy as np
+
+import _auction
+
+AGENT, RATCHET, SNIPER, LEARNER, NONE = 0, 1, 2, 3, -1
+SOLD, NO_BIDS, RESERVE_NOT_MET, BOUGHT_NOW = 0, 1, 2, 3
+
+
+class Results:
+    """Results of a simulation run.
+
+    items -- structured array with a record per item (itemNumber, winner, bids, agents,
+             ratchets, snipers, learners, extensions, reschedules, ending, cancelled,
+             units, unitsSold, unitsWon[5], winnerId, returning, realPrice, startPrice, finalPrice,
+             endTime, revenue)
+    bids  -- structured array with a record per bid (itemNumber, bidder, bidderId, time,
+             itemTime, amount)
+    bidders -- structured array with a record per persistent bidder (id, type, items, wins,
+               bids, rating, connection), empty without a population
+    winner_stats -- number of wins of each strategy
+    surplus -- surplus (valuation - price) of the units won by each strategy
+    policy -- shading and timing weights of the learning bidders and their reward baseline,
+              empty without learners
+    """
+
+    def __init__(self, results):
+        self._results = results
+        self.items = np.asarray(results.items)
+        self.bids = np.asarray(results.bids)
+        self.bidders = np.asarray(results.bidders)
+        self.winner_stats = results.winner_stats
+        self.surplus = results.surplus
+        self.policy = results.policy
+
+
+def run(**config):
+    """Runs the simulation, the GIL is released while the model runs.
+
+    Keyword arguments: items, bidders, duration, timeout, seed, record_bids, proxy,
+    soft_close, format ('english', 'first', 'second' or 'dutch'), buy_it_now,
+    reserve, units, pricing ('uniform' or 'discriminatory'), population, learners,
+    latency, servers, service_time, queue, service ('exponential', 'deterministic'
+    or 'lognormal'), pacing
+    """
+    return Results(_auction.run(**config))
@@ -0,0 +1,484 @@
+/**
+ * @file auctionmodule.cpp
+ * @brief Python extension module (_auction) running the auction simulation in-process
+ * Results are exported through the buffer protocol, numpy views them as structured arrays without copying.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <vector>
+#include "../auction.h"
+
+// The Python object structures are initialized member by member
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+
+// PEP 3118 formats of the exported records, native alignment matches the C++ layout
+static const char ITEM_FORMAT[] = "T{i:itemNumber:i:winner:i:bids:i:agents:i:ratchets:i:snipers:i:learners:i:extensions:"
+                                  "i:reschedules:i:ending:i:cancelled:i:units:i:unitsSold:(5)i:unitsWon:i:winnerId:i:returning:"
+                                  "d:realPrice:d:startPrice:d:finalPrice:d:endTime:d:revenue:}";
+static const char BID_FORMAT[] = "T{i:itemNumber:i:bidder:Q:bidderId:d:time:d:itemTime:d:amount:}";
+static const char BIDDER_FORMAT[] = "T{i:id:i:type:i:items:i:wins:i:bids:i:rating:i:connection:}";
+
+static_assert(sizeof(ItemResult) == 20 * sizeof(int32_t) + 5 * sizeof(double), "ItemResult layout does not match ITEM_FORMAT");
+static_assert(sizeof(BidderRecord) == 7 * sizeof(int32_t), "BidderRecord layout does not match BIDDER_FORMAT");
+static_assert(offsetof(BidEvent, bidderId) == 8 && sizeof(BidEvent) == 40, "BidEvent layout does not match BID_FORMAT");
+
+/**
+ * @struct ResultsObject
+ * @brief Python object owning the results of a simulation run.
+ */
+struct ResultsObject
+{
+    PyObject_HEAD
+    AuctionResults results;
+};
+
+/**
+ * @brief Records exported by a result array.
+ */
+enum RecordKind
+{
+    ITEM_RECORDS,
+    BID_RECORDS,
+    BIDDER_RECORDS,
+};
+
+/**
+ * @struct ResultArrayObject
+ * @brief Buffer exporter of the item, bid or bidder records of a results object.
+ */
+struct ResultArrayObject
+{
+    PyObject_HEAD
+    ResultsObject *owner; // Keeps the records alive while the buffer is used
+    RecordKind kind;      // Exported records
+};
+
+static PyTypeObject ResultsType = {PyVarObject_HEAD_INIT(NULL, 0)};
+static PyTypeObject ResultArrayType = {PyVarObject_HEAD_INIT(NULL, 0)};
+
+static void Results_dealloc(ResultsObject *self)
+{
+    self->results.~AuctionResults();
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Results_array(ResultsObject *self, RecordKind kind)
+{
+    ResultArrayObject *array = PyObject_New(ResultArrayObject, &ResultArrayType);
+    if (!array)
+    {
+        return NULL;
+    }
+    Py_INCREF(self);
+    array->owner = self;
+    array->kind = kind;
+    return (PyObject *)array;
+}
+
+static PyObject *Results_items(ResultsObject *self, void *)
+{
+    return Results_array(self, ITEM_RECORDS);
+}
+
+static PyObject *Results_bids(ResultsObject *self, void *)
+{
+    return Results_array(self, BID_RECORDS);
+}
+
+static PyObject *Results_bidders(ResultsObject *self, void *)
+{
+    return Results_array(self, BIDDER_RECORDS);
+}
+
+static PyObject *Results_winnerStats(ResultsObject *self, void *)
+{
+    const int *stats = self->results.winnerStats;
+    return Py_BuildValue("{s:i,s:i,s:i,s:i,s:i}", "none", stats[0], "agent", stats[1], "ratchet", stats[2], "sniper", stats[3],
+                         "learner", stats[4]);
+}
+
+static PyObject *Results_surplus(ResultsObject *self, void *)
+{
+    const double *surplus = self->results.surplus;
+    return Py_BuildValue("{s:d,s:d,s:d,s:d}", "agent", surplus[1], "ratchet", surplus[2], "sniper", surplus[3],
+                         "learner", surplus[4]);
+}
+
+static PyObject *Results_policy(ResultsObject *self, void *)
+{
+    const std::vector<double> &policy = self->results.policy;
+    PyObject *list = PyList_New(policy.size());
+    if (!list)
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < policy.size(); i++)
+    {
+        PyList_SET_ITEM(list, i, PyFloat_FromDouble(policy[i]));
+    }
+    return list;
+}
+
+static PyGetSetDef Results_getset[] = {
+    {"items", (getter)Results_items, NULL, "Buffer of the item results", NULL},
+    {"bids", (getter)Results_bids, NULL, "Buffer of the placed bids", NULL},
+    {"bidders", (getter)Results_bidders, NULL, "Buffer of the persistent bidders", NULL},
+    {"winner_stats", (getter)Results_winnerStats, NULL, "Number of wins of each strategy", NULL},
+    {"surplus", (getter)Results_surplus, NULL, "Surplus (valuation - price) of the units won by each strategy", NULL},
+    {"policy", (getter)Results_policy, NULL, "Policy of the learning bidders after the run", NULL},
+    {NULL, NULL, NULL, NULL, NULL},
+};
+
+static void ResultArray_dealloc(ResultArrayObject *self)
+{
+    Py_DECREF(self->owner);
+    PyObject_Free(self);
+}
+
+static int ResultArray_getbuffer(ResultArrayObject *self, Py_buffer *view, int flags)
+{
+    if (flags & PyBUF_WRITABLE)
+    {
+        PyErr_SetString(PyExc_BufferError, "simulation results are read-only");
+        return -1;
+    }
+
+    AuctionResults &results = self->owner->results;
+    void *data;
+    Py_ssize_t count;
+    Py_ssize_t itemSize;
+    const char *format;
+    if (self->kind == BID_RECORDS)
+    {
+        data = results.bids.data();
+        count = results.bids.size();
+        itemSize = sizeof(BidEvent);
+        format = BID_FORMAT;
+    }
+    else if (self->kind == BIDDER_RECORDS)
+    {
+        data = results.bidders.data();
+        count = results.bidders.size();
+        itemSize = sizeof(BidderRecord);
+        format = BIDDER_FORMAT;
+    }
+    else
+    {
+        data = results.items.data();
+        count = results.items.size();
+        itemSize = sizeof(ItemResult);
+        format = ITEM_FORMAT;
+    }
+
+    // Shape and strides live in the internal field, they are released with the view
+    Py_ssize_t *layout = (Py_ssize_t *)PyMem_Malloc(2 * sizeof(Py_ssize_t));
+    if (!layout)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    layout[0] = count;
+    layout[1] = itemSize;
+
+    view->buf = data;
+    view->obj = (PyObject *)self;
+    Py_INCREF(self);
+    view->len = count * itemSize;
+    view->readonly = 1;
+    view->itemsize = itemSize;
+    view->format = (flags & PyBUF_FORMAT) ? (char *)format : NULL;
+    view->ndim = 1;
+    view->shape = &layout[0];
+    view->strides = &layout[1];
+    view->suboffsets = NULL;
+    view->internal = layout;
+    return 0;
+}
+
+static void ResultArray_releasebuffer(ResultArrayObject *, Py_buffer *view)
+{
+    PyMem_Free(view->internal);
+}
+
+static Py_ssize_t ResultArray_length(ResultArrayObject *self)
+{
+    AuctionResults &results = self->owner->results;
+    if (self->kind == BID_RECORDS)
+    {
+        return results.bids.size();
+    }
+    return self->kind == BIDDER_RECORDS ? results.bidders.size() : results.items.size();
+}
+
+static PyBufferProcs ResultArray_buffer = {(getbufferproc)ResultArray_getbuffer, (releasebufferproc)ResultArray_releasebuffer};
+static PySequenceMethods ResultArray_sequence = {(lenfunc)ResultArray_length};
+
+/**
+ * @brief Fills the simulation configuration from keyword arguments.
+ *
+ * @param kwargs Keyword arguments, may be NULL.
+ * @param config The configuration to fill.
+ *
+ * @return 0 on success, -1 with a Python exception set on failure
+ */
+static int parseConfig(PyObject *kwargs, AuctionConfig &config)
+{
+    if (!kwargs)
+    {
+        return 0;
+    }
+
+    PyObject *key;
+    PyObject *value;
+    Py_ssize_t position = 0;
+    while (PyDict_Next(kwargs, &position, &key, &value))
+    {
+        const char *name = PyUnicode_AsUTF8(key);
+        if (!name)
+        {
+            return -1;
+        }
+
+        if (strcmp(name, "items") == 0)
+        {
+            config.numberOfItems = PyLong_AsLong(value);
+        }
+        else if (strcmp(name, "bidders") == 0)
+        {
+            config.numberOfBidders = PyFloat_AsDouble(value);
+        }
+        else if (strcmp(name, "duration") == 0)
+        {
+            config.singleItemDuration = PyLong_AsLong(value);
+        }
+        else if (strcmp(name, "timeout") == 0)
+        {
+            config.auctionItemTimeout = PyFloat_AsDouble(value);
+        }
+        else if (strcmp(name, "seed") == 0)
+        {
+            config.seed = PyLong_AsLong(value);
+        }
+        else if (strcmp(name, "record_bids") == 0)
+        {
+            config.recordBids = PyObject_IsTrue(value);
+        }
+        else if (strcmp(name, "proxy") == 0)
+        {
+            config.proxyBidding = PyObject_IsTrue(value);
+        }
+        else if (strcmp(name, "soft_close") == 0)
+        {
+            config.softClose = PyFloat_AsDouble(value);
+        }
+        else if (strcmp(name, "buy_it_now") == 0)
+        {
+            config.buyItNow = PyFloat_AsDouble(value);
+        }
+        else if (strcmp(name, "reserve") == 0)
+        {
+            config.reservePrice = PyFloat_AsDouble(value);
+        }
+        else if (strcmp(name, "units") == 0)
+        {
+            config.units = PyLong_AsLong(value);
+        }
+        else if (strcmp(name, "population") == 0)
+        {
+            config.population = PyLong_AsLong(value);
+        }
+        else if (strcmp(name, "learners") == 0)
+        {
+            config.learners = PyFloat_AsDouble(value);
+        }
+        else if (strcmp(name, "latency") == 0)
+        {
+            config.latency = PyObject_IsTrue(value);
+        }
+        else if (strcmp(name, "servers") == 0)
+        {
+            config.servers = PyLong_AsLong(value);
+        }
+        else if (strcmp(name, "service_time") == 0)
+        {
+            config.serviceTime = PyFloat_AsDouble(value);
+        }
+        else if (strcmp(name, "pacing") == 0)
+        {
+            config.pacing = PyFloat_AsDouble(value);
+        }
+        else if (strcmp(name, "queue") == 0)
+        {
+            config.queueCapacity = PyLong_AsLong(value);
+        }
+        else if (strcmp(name, "service") == 0)
+        {
+            const char *service = PyUnicode_AsUTF8(value);
+            if (!service)
+            {
+                return -1;
+            }
+            if (strcmp(service, "exponential") == 0)
+            {
+                config.service = EXPONENTIAL_SERVICE;
+            }
+            else if (strcmp(service, "deterministic") == 0)
+            {
+                config.service = DETERMINISTIC_SERVICE;
+            }
+            else if (strcmp(service, "lognormal") == 0)
+            {
+                config.service = LOGNORMAL_SERVICE;
+            }
+            else
+            {
+                PyErr_Format(PyExc_ValueError, "unknown service time distribution '%s'", service);
+                return -1;
+            }
+        }
+        else if (strcmp(name, "pricing") == 0)
+        {
+            const char *pricing = PyUnicode_AsUTF8(value);
+            if (!pricing)
+            {
+                return -1;
+            }
+            if (strcmp(pricing, "uniform") == 0)
+            {
+                config.pricing = UNIFORM;
+            }
+            else if (strcmp(pricing, "discriminatory") == 0)
+            {
+                config.pricing = DISCRIMINATORY;
+            }
+            else
+            {
+                PyErr_Format(PyExc_ValueError, "unknown pricing rule '%s'", pricing);
+                return -1;
+            }
+        }
+        else if (strcmp(name, "format") == 0)
+        {
+            const char *format = PyUnicode_AsUTF8(value);
+            if (!format)
+            {
+                return -1;
+            }
+            if (strcmp(format, "english") == 0)
+            {
+                config.format = ENGLISH;
+            }
+            else if (strcmp(format, "first") == 0)
+            {
+                config.format = FIRST_PRICE;
+            }
+            else if (strcmp(format, "second") == 0)
+            {
+                config.format = SECOND_PRICE;
+            }
+            else if (strcmp(format, "dutch") == 0)
+            {
+                config.format = DUTCH;
+            }
+            else
+            {
+                PyErr_Format(PyExc_ValueError, "unknown auction format '%s'", format);
+                return -1;
+            }
+        }
+        else
+        {
+            PyErr_Format(PyExc_TypeError, "unknown simulation parameter '%s'", name);
+            return -1;
+        }
+
+        if (PyErr_Occurred())
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs a simulation with the GIL released and wraps its results.
+ */
+static PyObject *runSimulation(const AuctionConfig &config)
+{
+    ResultsObject *results = PyObject_New(ResultsObject, &ResultsType);
+    if (!results)
+    {
+        return NULL;
+    }
+    new (&results->results) AuctionResults();
+
+    // SIMLIB has a single process-wide calendar, runs from several Python threads are serialized
+    static PyThread_type_lock simulationLock = PyThread_allocate_lock();
+
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(simulationLock, WAIT_LOCK);
+    AuctionSimulator simulator(config);
+    simulator.run();
+    results->results = simulator.releaseResults();
+    PyThread_release_lock(simulationLock);
+    Py_END_ALLOW_THREADS
+
+    return (PyObject *)results;
+}
+
+static PyObject *auction_run(PyObject *, PyObject *args, PyObject *kwargs)
+{
+    if (PyTuple_Size(args) != 0)
+    {
+        PyErr_SetString(PyExc_TypeError, "run() takes only keyword arguments");
+        return NULL;
+    }
+
+    AuctionConfig config;
+    if (parseConfig(kwargs, config) < 0)
+    {
+        return NULL;
+    }
+    return runSimulation(config);
+}
+
+static PyMethodDef auction_methods[] = {
+    {"run", (PyCFunction)(void (*)(void))auction_run, METH_VARARGS | METH_KEYWORDS,
+     "run(**config) -> Results\n\nRuns the auction simulation, the GIL is released while it runs."},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyModuleDef auction_module = {
+    PyModuleDef_HEAD_INIT, "_auction", "Auction dynamics simulation", -1, auction_methods,
+    NULL, NULL, NULL, NULL};
+
+PyMODINIT_FUNC PyInit__auction(void)
+{
+    ResultsType.tp_name = "_auction.Results";
+    ResultsType.tp_basicsize = sizeof(ResultsObject);
+    ResultsType.tp_dealloc = (destructor)Results_dealloc;
+    ResultsType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ResultsType.tp_doc = "Results of a simulation run";
+    ResultsType.tp_getset = Results_getset;
+
+    ResultArrayType.tp_name = "_auction.ResultArray";
+    ResultArrayType.tp_basicsize = sizeof(ResultArrayObject);
+    ResultArrayType.tp_dealloc = (destructor)ResultArray_dealloc;
+    ResultArrayType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ResultArrayType.tp_doc = "Read-only buffer of simulation records";
+    ResultArrayType.tp_as_buffer = &ResultArray_buffer;
+    ResultArrayType.tp_as_sequence = &ResultArray_sequence;
+
+    if (PyType_Ready(&ResultsType) < 0 || PyType_Ready(&ResultArrayType) < 0)
+    {
+        return NULL;
+    }
+    return PyModule_Create(&auction_module);
+}
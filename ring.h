@@ -0,0 +1,390 @@
+/**
+ * @file ring.h
+ * @brief Shared-memory bid ingestion ring
+ * Local client processes submit bids to the live engine through a ring in POSIX shared memory and read the answers
+ * from their own response slots, so a bid costs no system call on either side. The ring is a bounded lock-free
+ * multi-producer/single-consumer queue: every slot carries a turn number telling whose turn it is (Vyukov's
+ * bounded queue), producers claim positions by an atomic increment and the engine is the only consumer. A producer
+ * that dies between claiming a position and filling it would stall the engine forever, so the engine takes back a
+ * position left unfilled for BidRing::STALL_TIMEOUT.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fcntl.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "currency.h"
+
+const size_t CACHE_LINE = 64; // Slots and counters written by different processes live on separate cache lines
+
+/**
+ * @enum RingOperation
+ * @brief Kind of a request submitted through the ring.
+ */
+enum RingOperation : uint32_t
+{
+    RING_BID, // A bid on an auction
+    RING_OPEN // Opens an auction
+};
+
+/**
+ * @struct RingRequest
+ * @brief A request of a client.
+ */
+struct RingRequest
+{
+    RingOperation operation = RING_BID;
+    uint32_t auction = 0;  // Number of the auction
+    uint32_t client = 0;   // Client answered, from BidRing::join()
+    uint64_t bidder = 0;   // Bidder of a bid
+    Cents amount = 0;      // Bid, starting price of an opened auction
+    int64_t duration = 0;  // Duration of an opened auction in nanoseconds
+    int64_t timeout = 0;   // First-bid timeout of an opened auction in nanoseconds, 0 for the duration
+    uint64_t sequence = 0; // Sequence number of the request within its client
+};
+
+/**
+ * @struct RingResponse
+ * @brief Answer to a request.
+ */
+struct RingResponse
+{
+    uint64_t sequence = 0; // Sequence number of the answered request
+    int32_t status = 0;    // BidStatus of a bid, ACCEPTED or UNKNOWN_AUCTION of an opened auction
+    Cents price = 0;       // Price of the auction after the request
+};
+
+/**
+ * @class BidRing
+ * @brief Mapping of a shared-memory ring, created by the engine and joined by its clients.
+ *
+ * @details
+ * A request at position p of the ring goes to slot p mod capacity, which is free for it when its turn is p and
+ * holds it when its turn is p + 1, the consumer passes the slot to the next lap by setting the turn to
+ * p + capacity. The answer to the request with sequence number s of a client goes to its response slot
+ * s mod RESPONSES with the turn s + 1, so a client numbers its requests from 0 and may have at most RESPONSES of
+ * them waiting for an answer. A full ring makes the producers wait, waiting yields the processor after a short spin.
+ *
+ * A producer marks the slot with the WRITING bit by a compare-and-swap of its turn before it copies the request. A
+ * claimed position whose slot still has the turn p after STALL_TIMEOUT belongs to a producer that died or stopped, the
+ * consumer passes the slot to the next lap by the same compare-and-swap and counts the position as recovered. A
+ * producer that comes back late finds the turn changed and its submit fails, the request is not answered. A producer
+ * dying in the few instructions between marking the slot and publishing it still stalls the consumer.
+ */
+class BidRing
+{
+public:
+    static const uint32_t RESPONSES = 256;          // Response slots of a client
+    static const uint64_t MAGIC = 0x42494452494e47; // Marks an initialized ring
+    static const uint64_t WRITING = 1ULL << 63;     // Turn bit of a slot being filled by its producer
+    static constexpr std::chrono::nanoseconds STALL_TIMEOUT = std::chrono::seconds(1); // Wait for a claimed position before it is taken back
+
+private:
+    struct alignas(CACHE_LINE) RequestSlot
+    {
+        std::atomic<uint64_t> turn;
+        RingRequest request;
+    };
+
+    struct alignas(CACHE_LINE) ResponseSlot
+    {
+        std::atomic<uint64_t> turn;
+        RingResponse response;
+    };
+
+    struct Header
+    {
+        uint64_t magic;
+        uint32_t capacity;                                // Request slots, a power of two
+        uint32_t clients;                                 // Response slot sets
+        alignas(CACHE_LINE) std::atomic<uint64_t> tail;   // Next position claimed by a producer
+        alignas(CACHE_LINE) uint64_t head;                // Next position read by the consumer
+        alignas(CACHE_LINE) std::atomic<uint32_t> joined; // Clients that joined the ring
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring needs address-free atomics");
+
+    std::string name;
+    Header *header = nullptr;
+    RequestSlot *requests = nullptr;
+    ResponseSlot *responses = nullptr;
+    size_t size = 0;
+    bool owner = false; // Flag if the mapping created the ring, which is removed with it
+
+    // State of the consumer, local to the engine
+    uint64_t stalled = UINT64_MAX;                   // Claimed position found unfilled, UINT64_MAX if none
+    std::chrono::steady_clock::time_point stalledAt; // When the position was first found unfilled
+    uint64_t recoveredPositions = 0;                 // Positions taken back from producers that did not fill them
+
+    static size_t bytes(uint32_t capacity, uint32_t clients)
+    {
+        return sizeof(Header) + capacity * sizeof(RequestSlot) + (size_t)clients * RESPONSES * sizeof(ResponseSlot);
+    }
+
+    bool map(int descriptor, size_t size)
+    {
+        void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        if (memory == MAP_FAILED)
+        {
+            return false;
+        }
+        this->size = size;
+        this->header = (Header *)memory;
+        this->requests = (RequestSlot *)((char *)memory + sizeof(Header));
+        return true;
+    }
+
+    /**
+     * @brief Times a claimed position that is not filled and takes it back after STALL_TIMEOUT.
+     * @param slot Slot of the position.
+     * @param position The position at the head of the ring.
+     */
+    void recover(RequestSlot &slot, uint64_t position)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (this->stalled != position)
+        {
+            this->stalled = position;
+            this->stalledAt = now;
+            return;
+        }
+        uint64_t turn = position;
+        if (now - this->stalledAt >= STALL_TIMEOUT &&
+            slot.turn.compare_exchange_strong(turn, position + this->header->capacity, std::memory_order_acq_rel))
+        {
+            this->header->head = position + 1;
+            this->recoveredPositions++;
+        }
+    }
+
+public:
+    /**
+     * @brief Waits a round, spins first and yields the processor to the other side later.
+     * @param spins Rounds waited so far, counted up.
+     */
+    static void relax(int &spins)
+    {
+        if (++spins < 64)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+
+    BidRing() = default;
+    BidRing(const BidRing &) = delete;
+    BidRing &operator=(const BidRing &) = delete;
+
+    ~BidRing()
+    {
+        if (this->header)
+        {
+            munmap(this->header, this->size);
+            if (this->owner)
+            {
+                shm_unlink(this->name.c_str());
+            }
+        }
+    }
+
+    /**
+     * @brief Creates a ring, a stale ring of the same name is replaced.
+     * @param name Name of the shared memory object, "/name".
+     * @param capacity Request slots, rounded up to a power of two.
+     * @param clients Clients that can join the ring.
+     * @return false on an error (errno is set)
+     */
+    bool create(const std::string &name, uint32_t capacity = 4096, uint32_t clients = 64)
+    {
+        uint32_t slots = 1;
+        while (slots < capacity)
+        {
+            slots *= 2;
+        }
+        shm_unlink(name.c_str());
+        int descriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (descriptor < 0)
+        {
+            return false;
+        }
+        bool mapped = ftruncate(descriptor, bytes(slots, clients)) == 0 && map(descriptor, bytes(slots, clients));
+        close(descriptor);
+        if (!mapped)
+        {
+            shm_unlink(name.c_str());
+            return false;
+        }
+        this->name = name;
+        this->owner = true;
+        this->header->capacity = slots;
+        this->header->clients = clients;
+        this->header->tail = 0;
+        this->header->head = 0;
+        this->header->joined = 0;
+        for (uint32_t i = 0; i < slots; i++)
+        {
+            this->requests[i].turn.store(i, std::memory_order_relaxed);
+        }
+        this->responses = (ResponseSlot *)(this->requests + slots);
+        for (size_t i = 0; i < (size_t)clients * RESPONSES; i++)
+        {
+            this->responses[i].turn.store(0, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        this->header->magic = MAGIC;
+        return true;
+    }
+
+    /**
+     * @brief Maps an existing ring.
+     * @param name Name of the shared memory object, "/name".
+     * @return false if there is no initialized ring of the name
+     */
+    bool open(const std::string &name)
+    {
+        int descriptor = shm_open(name.c_str(), O_RDWR, 0);
+        if (descriptor < 0)
+        {
+            return false;
+        }
+        struct stat status;
+        bool mapped = fstat(descriptor, &status) == 0 && (size_t)status.st_size >= sizeof(Header) &&
+                      map(descriptor, status.st_size);
+        close(descriptor);
+        if (!mapped)
+        {
+            return false;
+        }
+        this->name = name;
+        if (this->header->magic != MAGIC || this->size < bytes(this->header->capacity, this->header->clients))
+        {
+            munmap(this->header, this->size);
+            this->header = nullptr;
+            return false;
+        }
+        this->responses = (ResponseSlot *)(this->requests + this->header->capacity);
+        return true;
+    }
+
+    /**
+     * @brief Registers a client, its requests are answered in its own response slots.
+     * @return Number of the client, -1 if the ring is full of clients
+     */
+    int join()
+    {
+        uint32_t client = this->header->joined.fetch_add(1);
+        return client < this->header->clients ? (int)client : -1;
+    }
+
+    /**
+     * @brief Submits a request, waits while the ring is full.
+     * @return false if the engine took the position back because the producer stalled, the request is not answered
+     */
+    bool submit(const RingRequest &request)
+    {
+        uint64_t position = this->header->tail.fetch_add(1, std::memory_order_relaxed);
+        RequestSlot &slot = this->requests[position & (this->header->capacity - 1)];
+        uint64_t turn;
+        for (int spins = 0; ((turn = slot.turn.load(std::memory_order_acquire)) & ~WRITING) < position;)
+        {
+            relax(spins);
+        }
+        if (turn != position || !slot.turn.compare_exchange_strong(turn, position | WRITING, std::memory_order_acquire))
+        {
+            return false;
+        }
+        slot.request = request;
+        slot.turn.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Takes the next request, only the engine may call it.
+     * A claimed position left unfilled for STALL_TIMEOUT is taken back and skipped.
+     * @return false if the ring is empty or the next request is not filled yet
+     */
+    bool receive(RingRequest &request)
+    {
+        uint64_t position = this->header->head;
+        RequestSlot &slot = this->requests[position & (this->header->capacity - 1)];
+        uint64_t turn = slot.turn.load(std::memory_order_acquire);
+        if (turn != position + 1)
+        {
+            if (turn == position && this->header->tail.load(std::memory_order_relaxed) > position)
+            {
+                recover(slot, position);
+            }
+            return false;
+        }
+        request = slot.request;
+        slot.turn.store(position + this->header->capacity, std::memory_order_release);
+        this->header->head = position + 1;
+        return true;
+    }
+
+    /**
+     * @brief Returns the positions the consumer took back from stalled producers.
+     */
+    uint64_t recovered() const { return this->recoveredPositions; }
+
+    /**
+     * @brief Answers a request, only the engine may call it, a request of an unknown client is dropped.
+     */
+    void respond(uint32_t client, const RingResponse &response)
+    {
+        if (client >= this->header->clients)
+        {
+            return;
+        }
+        ResponseSlot &slot = this->responses[(size_t)client * RESPONSES + (response.sequence & (RESPONSES - 1))];
+        slot.response = response;
+        slot.turn.store(response.sequence + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Reads the answer to a request if it has arrived.
+     * @return false if the request was not answered yet
+     */
+    bool poll(uint32_t client, uint64_t sequence, RingResponse &response)
+    {
+        ResponseSlot &slot = this->responses[(size_t)client * RESPONSES + (sequence & (RESPONSES - 1))];
+        if (slot.turn.load(std::memory_order_acquire) != sequence + 1)
+        {
+            return false;
+        }
+        response = slot.response;
+        return true;
+    }
+
+    /**
+     * @brief Waits for the answer to a request.
+     */
+    RingResponse await(uint32_t client, uint64_t sequence)
+    {
+        RingResponse response;
+        for (int spins = 0; !poll(client, sequence, response);)
+        {
+            relax(spins);
+        }
+        return response;
+    }
+
+    bool isOpen() const { return this->header != nullptr; }
+};
+
+#endif // RING_H
@@ -0,0 +1,768 @@
+/**
+ * @file shard.cpp
+ * @brief Thread-per-core sharded live engine
+ * Every shard runs a poll loop over its connections and an eventfd, which other shards write to only when the shard
+ * sleeps in poll, so a busy shard receives its messages without a system call.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include "shard.h"
+#include "pacer.h"
+#include "protocol.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+
+const int64_t SWEEP_INTERVAL = 1000000;   // Nanoseconds between two sweeps of the ended auctions, a tick of the timer wheel
+const int IDLE_TIMEOUT = 10;              // Milliseconds an idle shard sleeps in poll at most
+const int RECEIVE_BURST = 256;            // Messages taken from a queue in a round
+const int SLOT_BITS = 24;                 // Bits of the slot in a directory entry, the owner + 1 is above them
+const uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+const uint32_t MOVING = 1u << 31;         // Directory flag of an auction on its way to the named owner
+
+/**
+ * @brief Directory entry of an auction owned by a shard.
+ */
+uint32_t entry(int shard, uint32_t slot)
+{
+    return (uint32_t)(shard + 1) << SLOT_BITS | slot;
+}
+
+/**
+ * @struct PendingAnswer
+ * @brief Place of a request in the answers of its connection.
+ */
+struct PendingAnswer
+{
+    bool ready = false;
+    ShardMessage answer;
+};
+
+/**
+ * @struct ShardConnection
+ * @brief A client of a shard.
+ */
+struct ShardConnection
+{
+    int socket = -1;
+    string input;                 // Received bytes not handled yet
+    string output;                // Answers not sent yet
+    uint64_t read = 0;            // Requests read
+    deque<PendingAnswer> pending; // Requests not answered in order yet, the first one is read - pending.size()
+    bool dirty = false;           // Flag if the connection has answers to send
+    bool closing = false;         // Flag if the client closed its side, the connection goes once it is answered
+};
+
+/**
+ * @brief Pins the calling thread to the index-th core it may run on.
+ */
+void pin(int index)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+    {
+        return;
+    }
+    int skip = index % CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed) && skip-- == 0)
+        {
+            cpu_set_t core;
+            CPU_ZERO(&core);
+            CPU_SET(cpu, &core);
+            pthread_setaffinity_np(pthread_self(), sizeof(core), &core);
+            return;
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * @struct ShardedServer::Shard
+ * @brief State of a shard, touched only by its thread except for the published fields.
+ */
+struct ShardedServer::Shard
+{
+    int index = 0;
+    MatchingEngine engine;
+    ShardStats stats;
+    int wake = -1;                                          // Eventfd waking up the shard from poll
+    alignas(CACHE_LINE) std::atomic<bool> sleeping{false};  // Published: the shard waits in poll
+    alignas(CACHE_LINE) std::atomic<int64_t> load{0};       // Published: requests executed in the last round
+    int64_t roundRequests = 0;                              // Requests executed in the current round
+    vector<uint32_t> slotAuctions;                          // Auction in every slot of the engine
+    vector<uint32_t> slotBids;                              // Bids on every slot in the current round
+    vector<uint32_t> freeSlots;                             // Slots of the auctions moved away
+    unordered_map<uint32_t, vector<ShardMessage>> held;     // Requests for auctions moving to the shard
+    vector<deque<ShardMessage>> waiting;                    // Messages to every shard not fitting its queue
+    vector<bool> notify;                                    // Shards sent a message in this round
+    unordered_map<uint32_t, ShardConnection> connections;   // Connections by their number
+    vector<pollfd> sockets;                                 // The eventfd, the listener of the first shard and the connections
+    vector<uint32_t> socketConnections;                     // Connection of every socket
+    vector<uint32_t> dirty;                                 // Connections with answers to send
+    uint32_t nextConnection = 0;                            // Number of the next connection
+    int nextShard = 0;                                      // Shard of the next accepted connection
+
+    Shard(int index, bool tiered, int64_t softClose) : index(index), engine(tiered, softClose) {}
+
+    /**
+     * @brief Takes a slot of the engine for an auction.
+     */
+    uint32_t allocate(uint32_t auction)
+    {
+        uint32_t slot = this->slotAuctions.size();
+        if (!this->freeSlots.empty())
+        {
+            slot = this->freeSlots.back();
+            this->freeSlots.pop_back();
+        }
+        else
+        {
+            this->slotAuctions.push_back(0);
+            this->slotBids.push_back(0);
+        }
+        this->slotAuctions[slot] = auction;
+        this->slotBids[slot] = 0;
+        return slot;
+    }
+
+    /**
+     * @brief Adds a connection to the poll set.
+     */
+    void add(int socket)
+    {
+        int on = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        uint32_t number = this->nextConnection++;
+        this->connections[number].socket = socket;
+        this->sockets.push_back({socket, POLLIN, 0});
+        this->socketConnections.push_back(number);
+    }
+
+    /**
+     * @brief Closes a connection, its answers still on their way are dropped when they arrive.
+     */
+    void remove(uint32_t number)
+    {
+        auto found = this->connections.find(number);
+        if (found == this->connections.end())
+        {
+            return;
+        }
+        for (size_t i = 0; i < this->sockets.size(); i++)
+        {
+            if (this->sockets[i].fd == found->second.socket)
+            {
+                this->sockets.erase(this->sockets.begin() + i);
+                this->socketConnections.erase(this->socketConnections.begin() + i);
+                break;
+            }
+        }
+        close(found->second.socket);
+        this->connections.erase(found);
+    }
+};
+
+ShardedServer::ShardedServer(const Endpoint &endpoint, const ShardConfig &config) : endpoint(endpoint), config(config)
+{
+    this->config.shards = min(max(this->config.shards, 1), MAX_SHARDS);
+    int shards = this->config.shards;
+    for (int i = 0; i < shards; i++)
+    {
+        this->shards.push_back(make_unique<Shard>(i, config.tiered, (int64_t)(config.softClose * 1e9)));
+        this->shards[i]->wake = eventfd(0, EFD_NONBLOCK);
+        this->shards[i]->waiting.resize(shards);
+        this->shards[i]->notify.resize(shards);
+    }
+    for (int i = 0; i < shards * shards; i++)
+    {
+        this->queues.push_back(make_unique<Queue>());
+    }
+
+    // The pages of the directory are mapped on first use, so its size costs nothing up front
+    void *memory = mmap(nullptr, MatchingEngine::MAX_AUCTIONS * sizeof(atomic<uint32_t>), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    this->directory = memory == MAP_FAILED ? nullptr : (atomic<uint32_t> *)memory;
+}
+
+ShardedServer::~ShardedServer()
+{
+    for (auto &shard : this->shards)
+    {
+        for (auto &connection : shard->connections)
+        {
+            close(connection.second.socket);
+        }
+        close(shard->wake);
+    }
+    if (this->directory)
+    {
+        munmap(this->directory, MatchingEngine::MAX_AUCTIONS * sizeof(atomic<uint32_t>));
+    }
+    if (this->listener >= 0)
+    {
+        close(this->listener);
+        if (this->endpoint.transport == UNIX_TRANSPORT)
+        {
+            unlink(this->endpoint.path.c_str());
+        }
+    }
+}
+
+bool ShardedServer::open()
+{
+    if (!this->directory)
+    {
+        return false;
+    }
+    this->listener = this->endpoint.listen();
+    return this->listener >= 0;
+}
+
+const ShardStats &ShardedServer::getStats(int shard) const
+{
+    return this->shards[shard]->stats;
+}
+
+void ShardedServer::send(Shard &shard, int to, const ShardMessage &message)
+{
+    shard.stats.sent++;
+    if (!shard.waiting[to].empty() || !queue(shard.index, to).push(message))
+    {
+        shard.waiting[to].push_back(message);
+    }
+    shard.notify[to] = true;
+}
+
+bool ShardedServer::flush(Shard &shard)
+{
+    bool clear = true;
+    for (int to = 0; to < this->config.shards; to++)
+    {
+        deque<ShardMessage> &waiting = shard.waiting[to];
+        while (!waiting.empty() && queue(shard.index, to).push(waiting.front()))
+        {
+            waiting.pop_front();
+        }
+        clear &= waiting.empty();
+        if (shard.notify[to])
+        {
+            // Pairs with the fence of a shard going to sleep, one of the two sees the other
+            shard.notify[to] = false;
+            atomic_thread_fence(memory_order_seq_cst);
+            if (this->shards[to]->sleeping.load(memory_order_relaxed))
+            {
+                uint64_t one = 1;
+                ssize_t written = write(this->shards[to]->wake, &one, sizeof(one));
+                (void)written;
+            }
+        }
+    }
+    return clear;
+}
+
+int ShardedServer::receive(Shard &shard)
+{
+    int handled = 0;
+    ShardMessage message;
+    for (int from = 0; from < this->config.shards; from++)
+    {
+        if (from == shard.index)
+        {
+            continue;
+        }
+        Queue &incoming = queue(from, shard.index);
+        for (int i = 0; i < RECEIVE_BURST && incoming.pop(message); i++)
+        {
+            switch (message.kind)
+            {
+            case SHARD_REQUEST:
+                execute(shard, message, Pacer::now());
+                break;
+            case SHARD_ANSWER:
+                answer(shard, message);
+                break;
+            case SHARD_MOVE:
+                adopt(shard, message);
+                break;
+            case SHARD_ADOPT:
+                shard.add(message.connection);
+                break;
+            }
+            handled++;
+        }
+    }
+    shard.stats.received += handled;
+    return handled;
+}
+
+void ShardedServer::execute(Shard &shard, ShardMessage &message, int64_t now)
+{
+    uint32_t id = message.auction;
+    uint32_t found = id < MatchingEngine::MAX_AUCTIONS ? this->directory[id].load(memory_order_acquire) : 0;
+    int owner = found ? (int)((found & ~MOVING) >> SLOT_BITS) - 1 : home(id, this->config.shards);
+    if (owner != shard.index && id < MatchingEngine::MAX_AUCTIONS)
+    {
+        shard.stats.forwarded += message.origin != shard.index;
+        send(shard, owner, message);
+        return;
+    }
+    if (found & MOVING)
+    {
+        shard.held[id].push_back(message);
+        return;
+    }
+
+    uint32_t slot = found & SLOT_MASK;
+    EngineStats &stats = shard.engine.getStats();
+    message.kind = SHARD_ANSWER;
+    message.status = UNKNOWN_AUCTION;
+    if (message.operation == SHARD_OPEN && id < MatchingEngine::MAX_AUCTIONS)
+    {
+        slot = found ? slot : shard.allocate(id);
+        AuctionState &opened = message.state;
+        if (shard.engine.open(slot, opened.price, opened.end, opened.firstBidEnd))
+        {
+            message.status = ACCEPTED;
+            this->directory[id].store(entry(shard.index, slot), memory_order_release);
+        }
+        else if (!found)
+        {
+            shard.freeSlots.push_back(slot);
+        }
+    }
+    else if (message.operation == SHARD_BID)
+    {
+        if (found)
+        {
+            message.status = shard.engine.bid(slot, message.bidder, message.state.price, now);
+            shard.slotBids[slot]++;
+        }
+        else
+        {
+            stats.rejected[UNKNOWN_AUCTION]++;
+        }
+    }
+    if (message.operation != SHARD_OPEN)
+    {
+        const AuctionState *auction = found ? shard.engine.find(slot, now) : nullptr;
+        message.state = auction ? *auction : AuctionState();
+        message.status = auction && message.operation == SHARD_GET ? ACCEPTED : message.status;
+    }
+    stats.requests++;
+    shard.stats.requests++;
+    shard.roundRequests++;
+    reply(shard, message);
+}
+
+void ShardedServer::reply(Shard &shard, const ShardMessage &answer)
+{
+    if (answer.origin == shard.index)
+    {
+        this->answer(shard, answer);
+    }
+    else
+    {
+        send(shard, answer.origin, answer);
+    }
+}
+
+void ShardedServer::answer(Shard &shard, const ShardMessage &answer)
+{
+    auto found = shard.connections.find(answer.connection);
+    if (found == shard.connections.end())
+    {
+        return;
+    }
+    ShardConnection &connection = found->second;
+    PendingAnswer &pending = connection.pending[answer.number - (connection.read - connection.pending.size())];
+    pending.ready = true;
+    pending.answer = answer;
+
+    // The answers are formatted in the order of the requests, as soon as all earlier ones are there
+    string &output = connection.output;
+    while (!connection.pending.empty() && connection.pending.front().ready)
+    {
+        const ShardMessage &ready = connection.pending.front().answer;
+        switch (ready.operation)
+        {
+        case SHARD_BID:
+            output += ready.status == ACCEPTED ? "ACK" : "REJ";
+            appendUnsigned(output, ready.sequence);
+            if (ready.status != ACCEPTED)
+            {
+                output += ' ';
+                output += BID_REASONS[ready.status];
+            }
+            appendCents(output, ready.state.price);
+            break;
+        case SHARD_OPEN:
+            output += ready.status == ACCEPTED ? "OK" : "ERR";
+            appendUnsigned(output, ready.auction);
+            break;
+        case SHARD_GET:
+            output += "STATE";
+            appendUnsigned(output, ready.auction);
+            if (ready.status == ACCEPTED)
+            {
+                appendCents(output, ready.state.price);
+                appendUnsigned(output, ready.state.leader);
+                appendUnsigned(output, ready.state.bids);
+                output += ready.state.open ? " open" : ready.state.ending == SOLD ? " sold" : " unsold";
+            }
+            else
+            {
+                output += " 0 0 0 unknown";
+            }
+            break;
+        case SHARD_INVALID:
+            output += "ERR";
+            break;
+        }
+        output += '\n';
+        shard.stats.latency.record(Pacer::now() - ready.start);
+        connection.pending.pop_front();
+    }
+    if (!connection.dirty && !output.empty())
+    {
+        connection.dirty = true;
+        shard.dirty.push_back(answer.connection);
+    }
+}
+
+void ShardedServer::request(Shard &shard, uint32_t connection, const char *line)
+{
+    ShardConnection &client = shard.connections[connection];
+    ShardMessage message;
+    message.origin = shard.index;
+    message.connection = connection;
+    message.number = client.read++;
+    message.start = Pacer::now();
+    client.pending.emplace_back();
+    shard.stats.read++;
+
+    char *next;
+    if (strncmp(line, "BID ", 4) == 0)
+    {
+        const char *field = line + 4;
+        message.operation = SHARD_BID;
+        message.auction = parseUnsigned(field);
+        message.bidder = parseUnsigned(field);
+        message.state.price = parseCents(field);
+        message.sequence = parseUnsigned(field);
+        execute(shard, message, message.start);
+        return;
+    }
+    if (strncmp(line, "OPEN ", 5) == 0)
+    {
+        message.operation = SHARD_OPEN;
+        message.auction = strtoul(line + 5, &next, 10);
+        message.state.price = toCents(strtod(next, &next));
+        double duration = strtod(next, &next);
+        double timeout = strtod(next, &next);
+        message.state.end = message.start + (int64_t)(duration * 1e9);
+        message.state.firstBidEnd = message.start + (int64_t)((timeout > 0 ? timeout : duration) * 1e9);
+        if (message.state.price > 0 && duration > 0)
+        {
+            execute(shard, message, message.start);
+            return;
+        }
+        message.status = UNKNOWN_AUCTION;
+    }
+    else if (strncmp(line, "GET ", 4) == 0 && line[4] != '/')
+    {
+        message.operation = SHARD_GET;
+        message.auction = strtoul(line + 4, &next, 10);
+        execute(shard, message, message.start);
+        return;
+    }
+    else
+    {
+        message.operation = SHARD_INVALID;
+    }
+    message.kind = SHARD_ANSWER;
+    shard.engine.getStats().requests++;
+    answer(shard, message);
+}
+
+void ShardedServer::adopt(Shard &shard, const ShardMessage &move)
+{
+    uint32_t slot = shard.allocate(move.auction);
+    shard.engine.place(slot, move.state);
+    this->directory[move.auction].store(entry(shard.index, slot), memory_order_release);
+    shard.stats.movedIn++;
+
+    auto held = shard.held.find(move.auction);
+    if (held != shard.held.end())
+    {
+        vector<ShardMessage> requests = std::move(held->second);
+        shard.held.erase(held);
+        for (ShardMessage &request : requests)
+        {
+            execute(shard, request, Pacer::now());
+        }
+    }
+}
+
+void ShardedServer::rebalance(Shard &shard, int64_t now)
+{
+    int64_t load = shard.roundRequests;
+    shard.roundRequests = 0;
+    shard.load.store(load, memory_order_relaxed);
+
+    // Cold auctions may leave, the closing ones stay on the shard, a hot closing one makes the shard move the others
+    bool hot = false;
+    vector<uint32_t> candidates;
+    int64_t closing = this->config.closing * 1e9;
+    for (uint32_t slot = 0; slot < shard.slotBids.size(); slot++)
+    {
+        const AuctionState *auction = shard.engine.find(slot, now);
+        if (!auction || !auction->open)
+        {
+            continue;
+        }
+        if (auction->end - now <= closing)
+        {
+            hot |= shard.slotBids[slot] >= (uint32_t)this->config.hotBids;
+        }
+        else if (shard.slotBids[slot] < (uint32_t)this->config.hotBids)
+        {
+            candidates.push_back(slot);
+        }
+    }
+    shard.stats.hotRounds += hot;
+
+    int shards = this->config.shards;
+    if (this->config.rebalance && hot && shards > 1)
+    {
+        vector<int64_t> loads(shards);
+        int64_t total = 0;
+        for (int i = 0; i < shards; i++)
+        {
+            loads[i] = i == shard.index ? load : this->shards[i]->load.load(memory_order_relaxed);
+            total += loads[i];
+        }
+        double mean = (double)total / shards;
+        if (load > mean * (1 + this->config.imbalance))
+        {
+            // The coldest auctions go first, they have the fewest requests in flight to forward after the move. Each
+            // goes to the least loaded shard, an idle one counts as a request so the moves spread over the shards.
+            sort(candidates.begin(), candidates.end(),
+                 [&shard](uint32_t a, uint32_t b) { return shard.slotBids[a] < shard.slotBids[b]; });
+            int moved = 0;
+            for (uint32_t slot : candidates)
+            {
+                int64_t bids = max<int64_t>(shard.slotBids[slot], 1);
+                int target = shard.index == 0 ? 1 : 0;
+                for (int i = 0; i < shards; i++)
+                {
+                    target = i != shard.index && loads[i] < loads[target] ? i : target;
+                }
+                if (moved >= this->config.moves || loads[shard.index] <= mean || loads[target] + bids >= loads[shard.index])
+                {
+                    break;
+                }
+                ShardMessage move;
+                move.kind = SHARD_MOVE;
+                move.auction = shard.slotAuctions[slot];
+                move.state = shard.engine.take(slot);
+                this->directory[move.auction].store(entry(target, 0) | MOVING, memory_order_release);
+                shard.freeSlots.push_back(slot);
+                send(shard, target, move);
+                shard.stats.movedOut++;
+                loads[target] += bids;
+                loads[shard.index] -= bids;
+                moved++;
+            }
+        }
+    }
+    fill(shard.slotBids.begin(), shard.slotBids.end(), 0);
+}
+
+void ShardedServer::run(int index)
+{
+    Shard &shard = *this->shards[index];
+    if (this->config.pin)
+    {
+        pin(index);
+    }
+    shard.sockets.push_back({shard.wake, POLLIN, 0});
+    shard.socketConnections.push_back(UINT32_MAX);
+    if (index == 0)
+    {
+        shard.sockets.push_back({this->listener, POLLIN, 0});
+        shard.socketConnections.push_back(UINT32_MAX);
+    }
+    int first = shard.sockets.size(); // First socket of a connection
+
+    int64_t start = Pacer::now();
+    int64_t sweep = start + SWEEP_INTERVAL;
+    int64_t round = start + (int64_t)(this->config.interval * 1e9);
+    bool busy = false;
+    while (!this->stopped)
+    {
+        // A shard going to sleep publishes it and looks at its queues once more, see flush()
+        int timeout = busy ? 0 : IDLE_TIMEOUT;
+        if (timeout > 0)
+        {
+            shard.sleeping.store(true, memory_order_relaxed);
+            atomic_thread_fence(memory_order_seq_cst);
+            for (int from = 0; from < this->config.shards && timeout > 0; from++)
+            {
+                timeout = from != index && !queue(from, index).empty() ? 0 : timeout;
+            }
+        }
+        int64_t before = Pacer::now();
+        int ready = poll(shard.sockets.data(), shard.sockets.size(), timeout);
+        shard.stats.idle += timeout > 0 ? Pacer::now() - before : 0;
+        shard.sleeping.store(false, memory_order_relaxed);
+        busy = false;
+
+        if (ready > 0 && shard.sockets[0].revents)
+        {
+            uint64_t wakes;
+            ssize_t drained = read(shard.wake, &wakes, sizeof(wakes));
+            (void)drained;
+        }
+        if (ready > 0 && index == 0 && shard.sockets[1].revents & POLLIN)
+        {
+            int client = accept4(this->listener, nullptr, nullptr, SOCK_NONBLOCK);
+            if (client >= 0)
+            {
+                int target = shard.nextShard++ % this->config.shards;
+                if (target == 0)
+                {
+                    shard.add(client);
+                }
+                else
+                {
+                    ShardMessage adopt;
+                    adopt.kind = SHARD_ADOPT;
+                    adopt.connection = client;
+                    send(shard, target, adopt);
+                }
+            }
+        }
+        for (size_t i = first; ready > 0 && i < shard.sockets.size(); i++)
+        {
+            uint32_t number = shard.socketConnections[i];
+            ShardConnection &connection = shard.connections[number];
+            if (!(shard.sockets[i].revents & (POLLIN | POLLHUP | POLLERR)) || connection.closing)
+            {
+                continue;
+            }
+            char data[16384];
+            ssize_t received = recv(shard.sockets[i].fd, data, sizeof(data), 0);
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                // A client closing its side still receives the answers to its last requests
+                connection.closing = true;
+                continue;
+            }
+            busy = true;
+            connection.input.append(data, received);
+
+            // Handles every complete line in place, the handled lines are dropped at once
+            size_t begin = 0;
+            size_t end;
+            while ((end = connection.input.find('\n', begin)) != string::npos)
+            {
+                connection.input[end] = '\0';
+                if (end > begin && connection.input[end - 1] == '\r')
+                {
+                    connection.input[end - 1] = '\0';
+                }
+                request(shard, number, connection.input.c_str() + begin);
+                begin = end + 1;
+            }
+            connection.input.erase(0, begin);
+        }
+
+        busy |= receive(shard) > 0;
+        busy |= !flush(shard);
+
+        for (uint32_t number : shard.dirty)
+        {
+            auto found = shard.connections.find(number);
+            if (found == shard.connections.end())
+            {
+                continue;
+            }
+            ShardConnection &connection = found->second;
+            connection.dirty = false;
+            if (!sendPending(connection.socket, connection.output))
+            {
+                shard.remove(number);
+            }
+        }
+        shard.dirty.clear();
+
+        // Answers the sockets did not take go out once they are writable
+        for (size_t i = first; i < shard.sockets.size(); i++)
+        {
+            uint32_t number = shard.socketConnections[i];
+            ShardConnection &connection = shard.connections[number];
+            bool writable = shard.sockets[i].revents & (POLLOUT | POLLHUP | POLLERR);
+            if ((writable && !sendPending(connection.socket, connection.output)) ||
+                (connection.closing && connection.pending.empty() && connection.output.empty()))
+            {
+                shard.remove(number);
+                i--;
+                continue;
+            }
+            shard.sockets[i].events = clientEvents(connection.output, connection.closing);
+        }
+
+        int64_t now = Pacer::now();
+        if (now >= sweep)
+        {
+            shard.engine.sweep(now);
+            sweep = now + SWEEP_INTERVAL;
+        }
+        if (now >= round)
+        {
+            rebalance(shard, now);
+            round = now + (int64_t)(this->config.interval * 1e9);
+        }
+    }
+    shard.stats.wall = Pacer::now() - start;
+    shard.stats.engine = shard.engine.getStats();
+}
+
+void ShardedServer::serve()
+{
+    vector<thread> threads;
+    for (int i = 1; i < this->config.shards; i++)
+    {
+        threads.emplace_back(&ShardedServer::run, this, i);
+    }
+    run(0);
+    for (thread &shard : threads)
+    {
+        shard.join();
+    }
+}
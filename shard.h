@@ -0,0 +1,295 @@
+/**
+ * @file shard.h
+ * @brief Thread-per-core sharded live engine
+ * Every shard is a thread, pinned to its own core, owning a matching engine with a part of the live auctions and a
+ * part of the client connections. An auction belongs to a shard by a hash of its number until it is moved, a request
+ * read by one shard for an auction of another shard crosses over by a single-producer/single-consumer queue
+ * between the two shards and its answer comes back the same way. Shards hosting hot closing auctions move their
+ * cold auctions to the least loaded shards, so the bidding at the close does not queue behind them.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "engine.h"
+#include "histogram.h"
+#include "loadgen.h"
+#include "ring.h"
+
+/**
+ * @class SpscQueue
+ * @brief Bounded lock-free queue of a single producer thread and a single consumer thread.
+ *
+ * @details
+ * The positions of both sides live on separate cache lines and each side keeps a copy of the position of the other
+ * one, which it rereads only when the queue looks full or empty, so a message usually costs no cache miss on them.
+ */
+template <typename T, uint32_t CAPACITY>
+class SpscQueue
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "The capacity must be a power of two");
+
+private:
+    alignas(CACHE_LINE) std::atomic<uint64_t> head{0}; // Next position read by the consumer
+    uint64_t knownTail = 0;                            // Tail as last seen by the consumer
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail{0}; // Next position written by the producer
+    uint64_t knownHead = 0;                            // Head as last seen by the producer
+    alignas(CACHE_LINE) T slots[CAPACITY];
+
+public:
+    /**
+     * @brief Appends a message, producer only.
+     * @return false if the queue is full
+     */
+    bool push(const T &message)
+    {
+        uint64_t position = this->tail.load(std::memory_order_relaxed);
+        if (position - this->knownHead == CAPACITY)
+        {
+            this->knownHead = this->head.load(std::memory_order_acquire);
+            if (position - this->knownHead == CAPACITY)
+            {
+                return false;
+            }
+        }
+        this->slots[position & (CAPACITY - 1)] = message;
+        this->tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Takes the oldest message, consumer only.
+     * @return false if the queue is empty
+     */
+    bool pop(T &message)
+    {
+        uint64_t position = this->head.load(std::memory_order_relaxed);
+        if (position == this->knownTail)
+        {
+            this->knownTail = this->tail.load(std::memory_order_acquire);
+            if (position == this->knownTail)
+            {
+                return false;
+            }
+        }
+        message = this->slots[position & (CAPACITY - 1)];
+        this->head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Checks for waiting messages, consumer only.
+     */
+    bool empty() const { return this->head.load(std::memory_order_relaxed) == this->tail.load(std::memory_order_acquire); }
+};
+
+/**
+ * @enum ShardOperation
+ * @brief Request of a client.
+ */
+enum ShardOperation : uint8_t
+{
+    SHARD_BID,    // BID auction bidder amount sequence
+    SHARD_OPEN,   // OPEN auction price duration timeout
+    SHARD_GET,    // GET auction
+    SHARD_INVALID // Any other line, answered by ERR
+};
+
+/**
+ * @enum ShardMessageKind
+ * @brief Kind of a message between two shards.
+ */
+enum ShardMessageKind : uint8_t
+{
+    SHARD_REQUEST, // A request for the auction, sent to its owner
+    SHARD_ANSWER,  // The answer to a request, sent back to the shard of the connection
+    SHARD_MOVE,    // An auction moved to the receiving shard
+    SHARD_ADOPT    // A connection accepted by the first shard, served by the receiving shard
+};
+
+/**
+ * @struct ShardMessage
+ * @brief A request, an answer or a moved auction.
+ */
+struct ShardMessage
+{
+    ShardMessageKind kind = SHARD_REQUEST;
+    ShardOperation operation = SHARD_BID;
+    uint16_t origin = 0;     // Shard of the connection
+    int32_t status = 0;      // BidStatus of the answer, ACCEPTED or UNKNOWN_AUCTION of an opened auction
+    uint32_t auction = 0;    // Number of the auction
+    uint32_t connection = 0; // Connection on the origin shard, the socket of an adopted connection
+    uint64_t number = 0;     // Number of the request within its connection
+    uint64_t bidder = 0;     // Bidder of a bid
+    uint64_t sequence = 0;   // Sequence number of a bid
+    int64_t start = 0;       // Time the request was read
+    AuctionState state;      // The bid amount and the times of an opened auction, the auction of an answer or a move
+};
+
+/**
+ * @struct ShardConfig
+ * @brief Parameters of the sharded engine.
+ */
+struct ShardConfig
+{
+    int shards = 1;          // Shards, threads pinned to the cores in turn
+    bool tiered = false;     // eBay increment table instead of 1 % of the price
+    double softClose = 0;    // A bid in the last softClose seconds extends the end to softClose seconds after it, 0 disables
+    bool pin = true;         // Flag if every shard thread is pinned to a core
+    bool rebalance = true;   // Flag if shards hosting hot closing auctions move their cold auctions away
+    double interval = 0.1;   // Seconds between two rebalancing rounds
+    double imbalance = 0.25; // Share of load above the mean of the shards that makes a shard move auctions
+    double closing = 5;      // Seconds before its end an auction counts as closing
+    int hotBids = 64;        // Bids in a rebalancing round that make an auction hot
+    int moves = 256;         // Most auctions moved by a shard in a round
+};
+
+/**
+ * @struct ShardStats
+ * @brief Counters of a shard.
+ */
+struct ShardStats
+{
+    int64_t requests = 0;     // Requests executed for the owned auctions
+    int64_t read = 0;         // Requests read from the connections of the shard
+    int64_t sent = 0;         // Messages sent to other shards
+    int64_t received = 0;     // Messages received from other shards
+    int64_t forwarded = 0;    // Requests passed on after their auction moved
+    int64_t movedOut = 0;     // Auctions moved to other shards
+    int64_t movedIn = 0;      // Auctions moved from other shards
+    int64_t hotRounds = 0;    // Rebalancing rounds with a hot closing auction on the shard
+    int64_t idle = 0;         // Nanoseconds spent waiting for work
+    int64_t wall = 0;         // Nanoseconds the shard ran
+    EngineStats engine;       // Counters of the matching engine of the shard
+    LatencyHistogram latency; // Latency of the requests read by the shard, until their answer is formatted
+};
+
+/**
+ * @class ShardedServer
+ * @brief Serves the live auctions of several shards on one endpoint, in the line protocol of EngineServer.
+ *
+ * @details
+ * The first shard accepts the connections and hands them to the shards in turn. A shard reads the requests of its
+ * connections and executes those for its own auctions at once, the others travel to their owners. The answers of a
+ * connection are written in the order of its requests, whichever shard they come from. A directory maps every
+ * auction number to its owner and its slot in the matching engine of the owner, so ownership can change at runtime:
+ * the old owner marks the auction as moving to the new owner and sends it its state, requests reaching the new
+ * owner before the state are held back and requests reaching the old owner are passed on behind the state.
+ * "GET /histogram" is not served, the counters of the shards are reported once the server stops.
+ */
+class ShardedServer
+{
+public:
+    static constexpr uint32_t QUEUE_CAPACITY = 1024; // Messages of a queue between two shards
+    static constexpr int MAX_SHARDS = 127;           // Shards the directory can name
+
+private:
+    typedef SpscQueue<ShardMessage, QUEUE_CAPACITY> Queue;
+
+    struct Shard;
+
+    Endpoint endpoint;
+    ShardConfig config;
+    int listener = -1;
+    std::atomic<bool> stopped{false};
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<std::unique_ptr<Queue>> queues; // Queue from shard i to shard j at i * shards + j
+    std::atomic<uint32_t> *directory = nullptr; // Owner and slot of every auction, 0 until it is opened
+
+    Queue &queue(int from, int to) { return *this->queues[from * this->config.shards + to]; }
+
+    /**
+     * @brief Serves the connections and the queues of a shard until stop() is called.
+     */
+    void run(int index);
+
+    /**
+     * @brief Sends a message to another shard, it waits in the shard if the queue is full.
+     */
+    void send(Shard &shard, int to, const ShardMessage &message);
+
+    /**
+     * @brief Sends the held back messages and wakes up the sleeping receivers.
+     * @return false if some messages are still held back
+     */
+    bool flush(Shard &shard);
+
+    /**
+     * @brief Handles the messages waiting in the queues to a shard.
+     * @return Handled messages
+     */
+    int receive(Shard &shard);
+
+    /**
+     * @brief Executes a request on the owner of its auction or passes it on.
+     */
+    void execute(Shard &shard, ShardMessage &message, int64_t now);
+
+    /**
+     * @brief Delivers an answer to its connection on this or another shard.
+     */
+    void reply(Shard &shard, const ShardMessage &answer);
+
+    /**
+     * @brief Writes an answer to its connection, in the order of the requests.
+     */
+    void answer(Shard &shard, const ShardMessage &answer);
+
+    /**
+     * @brief Parses a request line of a connection and executes it.
+     */
+    void request(Shard &shard, uint32_t connection, const char *line);
+
+    /**
+     * @brief Receives an auction moved from another shard and executes the requests held back for it.
+     */
+    void adopt(Shard &shard, const ShardMessage &move);
+
+    /**
+     * @brief Publishes the load of a shard over the last round and moves auctions away if it hosts hot closing ones.
+     */
+    void rebalance(Shard &shard, int64_t now);
+
+public:
+    ShardedServer(const Endpoint &endpoint, const ShardConfig &config);
+    ~ShardedServer();
+
+    /**
+     * @brief Shard owning an auction until it is moved, a hash of its number.
+     */
+    static int home(uint32_t auction, int shards)
+    {
+        return (int)(((auction * 0x9e3779b97f4a7c15ULL) >> 32) * shards >> 32);
+    }
+
+    /**
+     * @brief Starts listening on the endpoint.
+     * @return false on an error (errno is set)
+     */
+    bool open();
+
+    /**
+     * @brief Runs the shards until stop() is called, the first shard runs on the calling thread.
+     */
+    void serve();
+
+    void stop() { this->stopped = true; }
+
+    /**
+     * @brief Counters of a shard, valid once serve() returned.
+     */
+    const ShardStats &getStats(int shard) const;
+
+    int getShards() const { return this->config.shards; }
+};
+
+#endif // SHARD_H
@@ -0,0 +1,240 @@
+/**
+ * @file timer.h
+ * @brief Hierarchical timer wheel
+ * Timers of the live engine (auction ends, first-bid timeouts and their soft-close extensions) are kept in four
+ * wheels of 256 slots, each slot of a wheel spanning a full turn of the wheel below. A timer is scheduled, moved and
+ * cancelled in constant time by linking it into the slot of its deadline, the timers of an outer slot are moved to
+ * the inner wheels when the clock reaches the slot. A timer expires at the first tick after its deadline.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class TimerWheel
+ * @brief Timers identified by small numbers, with deadlines in nanoseconds.
+ *
+ * @details
+ * The timers are intrusive doubly linked lists threaded through an array indexed by the timer number, so the
+ * wheel allocates only when a higher number is scheduled. A bitmap of the occupied slots lets advance() jump over
+ * empty ticks, so an idle clock costs a few instructions per turn of the innermost wheel.
+ */
+class TimerWheel
+{
+public:
+    static constexpr int BITS = 8;               // Bits of a slot index
+    static constexpr int SLOTS = 1 << BITS;      // Slots of a wheel
+    static constexpr int LEVELS = 4;             // Wheels, together they span 2^32 ticks
+    static constexpr uint32_t NONE = UINT32_MAX; // No timer
+
+private:
+    struct Node
+    {
+        int64_t deadline = 0; // Tick the timer expires at
+        uint32_t next = NONE;
+        uint32_t previous = NONE;
+        uint32_t slot = NONE; // Slot the timer is linked into, NONE if it is not pending
+    };
+
+    int64_t tick;                                       // Nanoseconds of a tick
+    int64_t current;                                    // Tick the wheels were advanced to
+    std::vector<Node> nodes;                            // Timers by their number
+    std::array<uint32_t, LEVELS * SLOTS> heads;         // First timer of every slot
+    std::array<uint64_t, LEVELS * SLOTS / 64> occupied; // Bitmap of the non-empty slots
+    size_t pending = 0;                                 // Scheduled timers
+
+    void link(uint32_t id)
+    {
+        Node &node = this->nodes[id];
+        int64_t delta = node.deadline - this->current;
+        int level = 0;
+        int64_t position = node.deadline <= this->current ? this->current + 1 : node.deadline;
+        while (level < LEVELS - 1 && delta >= (int64_t)1 << (BITS * (level + 1)))
+        {
+            level++;
+        }
+        if (delta >= (int64_t)1 << (BITS * LEVELS))
+        {
+            // Beyond the outermost wheel the timer waits in its last slot and is placed again from there
+            position = this->current + ((int64_t)1 << (BITS * LEVELS)) - 1;
+        }
+        uint32_t slot = level * SLOTS + ((position >> (BITS * level)) & (SLOTS - 1));
+        node.slot = slot;
+        node.previous = NONE;
+        node.next = this->heads[slot];
+        if (node.next != NONE)
+        {
+            this->nodes[node.next].previous = id;
+        }
+        this->heads[slot] = id;
+        this->occupied[slot / 64] |= (uint64_t)1 << (slot % 64);
+    }
+
+    void unlink(uint32_t id)
+    {
+        Node &node = this->nodes[id];
+        if (node.previous != NONE)
+        {
+            this->nodes[node.previous].next = node.next;
+        }
+        else
+        {
+            this->heads[node.slot] = node.next;
+            if (node.next == NONE)
+            {
+                this->occupied[node.slot / 64] &= ~((uint64_t)1 << (node.slot % 64));
+            }
+        }
+        if (node.next != NONE)
+        {
+            this->nodes[node.next].previous = node.previous;
+        }
+        node.slot = NONE;
+    }
+
+    /**
+     * @brief Moves the timers of a slot of an outer wheel to the inner wheels.
+     */
+    void cascade(int level, uint32_t index)
+    {
+        uint32_t slot = level * SLOTS + index;
+        uint32_t id = this->heads[slot];
+        this->heads[slot] = NONE;
+        this->occupied[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+        while (id != NONE)
+        {
+            uint32_t next = this->nodes[id].next;
+            link(id);
+            id = next;
+        }
+    }
+
+    /**
+     * @brief First occupied slot of the innermost wheel at or after an index, SLOTS if there is none.
+     */
+    int nextOccupied(int index) const
+    {
+        for (int word = index / 64; word < SLOTS / 64; word++)
+        {
+            uint64_t bits = this->occupied[word] & (word == index / 64 ? ~(uint64_t)0 << (index % 64) : ~(uint64_t)0);
+            if (bits)
+            {
+                return word * 64 + __builtin_ctzll(bits);
+            }
+        }
+        return SLOTS;
+    }
+
+public:
+    /**
+     * @brief Creates empty wheels.
+     * @param tick Nanoseconds of a tick, the resolution of the deadlines.
+     * @param now Current time in nanoseconds.
+     */
+    explicit TimerWheel(int64_t tick = 1000000, int64_t now = 0) : tick(tick), current(now / tick)
+    {
+        this->heads.fill(NONE);
+        this->occupied.fill(0);
+    }
+
+    /**
+     * @brief Makes room for timers numbered below a bound, schedule() then does not allocate.
+     */
+    void reserve(size_t timers)
+    {
+        if (timers > this->nodes.size())
+        {
+            this->nodes.resize(timers);
+        }
+    }
+
+    /**
+     * @brief Schedules a timer, a pending timer of the number is moved.
+     * @param id Number of the timer.
+     * @param time Deadline in nanoseconds, the timer expires at the first tick at or after it.
+     */
+    void schedule(uint32_t id, int64_t time)
+    {
+        if (id >= this->nodes.size())
+        {
+            this->nodes.resize(std::max<size_t>(id + 1, this->nodes.size() * 2));
+        }
+        Node &node = this->nodes[id];
+        if (node.slot != NONE)
+        {
+            unlink(id);
+        }
+        else
+        {
+            this->pending++;
+        }
+        node.deadline = (time + this->tick - 1) / this->tick;
+        link(id);
+    }
+
+    /**
+     * @brief Cancels a timer, nothing happens if it is not pending.
+     */
+    void cancel(uint32_t id)
+    {
+        if (id < this->nodes.size() && this->nodes[id].slot != NONE)
+        {
+            unlink(id);
+            this->pending--;
+        }
+    }
+
+    bool isPending(uint32_t id) const { return id < this->nodes.size() && this->nodes[id].slot != NONE; }
+
+    /**
+     * @brief Advances the clock and expires the timers whose deadline passed.
+     * @param now Current time in nanoseconds.
+     * @param expire Called with the number of every expired timer, which may schedule timers again.
+     * @return Expired timers
+     */
+    template <typename Expire>
+    size_t advance(int64_t now, Expire expire)
+    {
+        int64_t target = now / this->tick;
+        size_t expired = 0;
+        while (this->current < target)
+        {
+            // Jumps over the empty ticks up to the next occupied slot, the next turn of the wheel or the target
+            int64_t next = this->current + 1;
+            int index = next & (SLOTS - 1);
+            if (index != 0)
+            {
+                next = std::min(next + (nextOccupied(index) - index), target);
+            }
+            this->current = next;
+            index = next & (SLOTS - 1);
+            for (int level = 1; index == 0 && level < LEVELS; level++)
+            {
+                index = (next >> (BITS * level)) & (SLOTS - 1);
+                cascade(level, index);
+            }
+
+            uint32_t slot = next & (SLOTS - 1);
+            while (this->heads[slot] != NONE)
+            {
+                uint32_t id = this->heads[slot];
+                unlink(id);
+                this->pending--;
+                expired++;
+                expire(id);
+            }
+        }
+        return expired;
+    }
+
+    size_t size() const { return this->pending; }
+};
+
+#endif // TIMER_H
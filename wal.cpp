@@ -0,0 +1,247 @@
+/**
+ * @file wal.cpp
+ * @brief Write-ahead log of the live engine
+ * The compaction writes the last state of every auction to a new file, syncs it and renames it over the log, so a
+ * crash during the compaction leaves either the old or the new log. The new file stays open for the records that follow.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#include "wal.h"
+#include "pacer.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+/**
+ * @brief CRC-32C (Castagnoli) of a buffer, by a table of the remainders of every byte.
+ */
+uint32_t crc32c(const void *data, size_t size)
+{
+    static const array<uint32_t, 256> table = []
+    {
+        array<uint32_t, 256> remainders;
+        for (uint32_t byte = 0; byte < 256; byte++)
+        {
+            uint32_t remainder = byte;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                remainder = remainder & 1 ? (remainder >> 1) ^ 0x82f63b78 : remainder >> 1;
+            }
+            remainders[byte] = remainder;
+        }
+        return remainders;
+    }();
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t crc = UINT32_MAX;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Checksum of a record, the checksum field itself is left out.
+ */
+uint32_t checksum(const WalRecord &record)
+{
+    return crc32c((const char *)&record + offsetof(WalRecord, auction), sizeof(WalRecord) - offsetof(WalRecord, auction));
+}
+
+/**
+ * @brief Syncs the directory of a file, so a renamed file survives a crash.
+ * @return false on an error (errno is set)
+ */
+bool syncDirectory(const string &path)
+{
+    size_t slash = path.rfind('/');
+    string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int descriptor = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+    bool synced = fsync(descriptor) == 0;
+    close(descriptor);
+    return synced;
+}
+
+} // namespace
+
+WriteAheadLog::~WriteAheadLog()
+{
+    // A stopped server leaves nothing unsynced, whatever the durability
+    if (this->file.isOpen() && (this->grouped > 0 || this->dirty))
+    {
+        this->file.sync();
+    }
+}
+
+bool WriteAheadLog::open(const WalConfig &config, MatchingEngine &engine)
+{
+    this->config = config;
+    timespec realtime;
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    int64_t now = Pacer::now();
+    this->offset = realtime.tv_sec * 1000000000LL + realtime.tv_nsec - now;
+
+    // The last valid record of an auction is its state, the replay stops at the first record that does not match
+    unordered_map<uint32_t, WalRecord> latest;
+    int log = ::open(config.path.c_str(), O_RDONLY | O_CREAT, 0644);
+    if (log < 0)
+    {
+        return false;
+    }
+    vector<WalRecord> records(4096);
+    size_t buffered = 0;
+    bool valid = true;
+    ssize_t received;
+    while (valid && (received = read(log, (char *)records.data() + buffered, records.size() * sizeof(WalRecord) - buffered)) != 0)
+    {
+        if (received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            close(log);
+            return false;
+        }
+        buffered += received;
+        size_t complete = buffered / sizeof(WalRecord);
+        size_t i = 0;
+        for (; i < complete; i++)
+        {
+            const WalRecord &record = records[i];
+            valid = record.type >= WAL_OPEN && record.type <= WAL_CLOSED && record.checksum == checksum(record);
+            if (!valid)
+            {
+                break;
+            }
+            latest[record.auction] = record;
+            this->stats.replayed++;
+        }
+        buffered -= i * sizeof(WalRecord);
+        memmove(records.data(), (char *)records.data() + i * sizeof(WalRecord), buffered);
+    }
+    this->stats.dropped = lseek(log, 0, SEEK_END) - this->stats.replayed * (int64_t)sizeof(WalRecord);
+    close(log);
+
+    // Every auction goes back into the engine and into the compacted log in the order of the numbers, the ones that
+    // ended meanwhile are closed with their last state
+    vector<WalRecord> kept;
+    for (const auto &[auction, record] : latest)
+    {
+        if (auction >= MatchingEngine::MAX_AUCTIONS)
+        {
+            continue;
+        }
+        AuctionState state;
+        state.price = record.price;
+        state.leader = record.leader;
+        state.bids = record.bids;
+        state.end = record.end - this->offset;
+        state.firstBidEnd = record.firstBidEnd - this->offset;
+        state.open = record.type != WAL_CLOSED && MatchingEngine::closing(state) > now;
+        state.opened = true;
+        state.ending = state.bids > 0 ? SOLD : NO_BIDS;
+        engine.place(auction, state);
+        kept.push_back(record);
+        kept.back().type = state.open ? WAL_SNAPSHOT : WAL_CLOSED;
+        kept.back().checksum = checksum(kept.back());
+        state.open ? this->stats.recovered++ : this->stats.closed++;
+    }
+    sort(kept.begin(), kept.end(), [](const WalRecord &a, const WalRecord &b) { return a.auction < b.auction; });
+
+    string compacted = config.path + ".tmp";
+    if (!this->file.open(compacted, false, config.backend) || !this->file.write(kept.data(), kept.size() * sizeof(WalRecord)) ||
+        !this->file.sync() || rename(compacted.c_str(), config.path.c_str()) != 0 || !syncDirectory(config.path))
+    {
+        int error = errno;
+        this->file.close();
+        unlink(compacted.c_str());
+        errno = error;
+        return false;
+    }
+    this->synced = now;
+    return true;
+}
+
+bool WriteAheadLog::append(WalRecordType type, uint32_t auction, const AuctionState &state, int64_t now)
+{
+    WalRecord record;
+    record.auction = auction;
+    record.type = type;
+    record.bids = state.bids;
+    record.leader = state.leader;
+    record.price = state.price;
+    record.end = state.end + this->offset;
+    record.firstBidEnd = state.firstBidEnd + this->offset;
+    record.checksum = checksum(record);
+    if (this->grouped == 0)
+    {
+        this->first = now;
+    }
+    this->grouped += sizeof(record);
+    this->stats.records++;
+    return this->file.write(&record, sizeof(record)) && (this->config.durability != WAL_SYNC || commit(now));
+}
+
+bool WriteAheadLog::sync(int64_t now)
+{
+    int64_t start = Pacer::now();
+    if (!this->file.sync())
+    {
+        return false;
+    }
+    this->dirty = false;
+    this->synced = now;
+    this->stats.syncs++;
+    this->stats.syncTime += Pacer::now() - start;
+    return true;
+}
+
+bool WriteAheadLog::commit(int64_t now)
+{
+    // The durabilities syncing before the answer write the group and sync it together
+    if (this->config.durability >= WAL_GROUP)
+    {
+        if (this->grouped == 0 && !this->dirty)
+        {
+            return true;
+        }
+        if (!sync(now))
+        {
+            return false;
+        }
+        this->stats.writes += this->grouped > 0;
+        this->grouped = 0;
+        return true;
+    }
+    if (this->grouped > 0)
+    {
+        if (!this->file.drain())
+        {
+            return false;
+        }
+        this->grouped = 0;
+        this->dirty = true;
+        this->stats.writes++;
+    }
+    bool due = this->config.durability == WAL_PERIODIC && now - this->synced >= (int64_t)(this->config.interval * 1e9);
+    return !this->dirty || !due || sync(now);
+}
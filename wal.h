@@ -0,0 +1,182 @@
+/**
+ * @file wal.h
+ * @brief Write-ahead log of the live engine
+ * Every opened auction and every accepted bid appends the new state of its auction to a log file before it is
+ * answered, so the live auctions survive a crash of the engine. The records are written and synced in groups: the
+ * records of many requests share one write and one fdatasync, and their answers are held until the group is durable.
+ * The file is written through an OutputFile (output.h), by io_uring where the kernel offers it.
+ * On start the log is replayed, the auctions still open are placed back into the matching engine, the closed ones
+ * with their winner and final price, and the log is compacted to one record per auction.
+ *
+ * @authors Marko Olešák (xolesa00), Ján Findra (xfindr01)
+ */
+
+#ifndef WAL_H
+#define WAL_H
+
+#include <cstdint>
+#include <string>
+#include "engine.h"
+#include "output.h"
+
+/**
+ * @enum WalDurability
+ * @brief What an answered request survives.
+ */
+enum WalDurability
+{
+    WAL_WRITE,    // Written to the kernel before it is answered, survives a crash of the engine but not of the machine
+    WAL_PERIODIC, // Like WAL_WRITE and synced every interval, a crash of the machine loses at most an interval
+    WAL_GROUP,    // Synced before it is answered, the records of a group share one sync
+    WAL_SYNC      // Synced by itself before it is answered
+};
+
+/**
+ * @enum WalRecordType
+ * @brief Cause of a record, the record holds the full state of its auction either way.
+ */
+enum WalRecordType : uint8_t
+{
+    WAL_OPEN = 1, // The auction was opened
+    WAL_BID,      // A bid was accepted
+    WAL_SNAPSHOT, // An open auction carried over by the compaction
+    WAL_CLOSED    // A closed auction carried over by the compaction, its final state
+};
+
+/**
+ * @struct WalRecord
+ * @brief The state of an auction after a request, times are nanoseconds of the realtime clock.
+ */
+struct WalRecord
+{
+    uint32_t checksum = 0;         // CRC-32C of the rest of the record, a torn or stale record does not match it
+    uint32_t auction = 0;          // Number of the auction
+    WalRecordType type = WAL_OPEN; // Cause of the record
+    uint8_t reserved[3] = {0};
+    int32_t bids = 0;              // Accepted bids
+    uint64_t leader = 0;           // Leading bidder, valid after the first bid
+    Cents price = 0;               // Current price
+    int64_t end = 0;               // End of the auction
+    int64_t firstBidEnd = 0;       // End of the auction without bids
+};
+
+static_assert(sizeof(WalRecord) == 48, "A record of the log has a fixed size");
+
+/**
+ * @struct WalConfig
+ * @brief Parameters of the write-ahead log.
+ */
+struct WalConfig
+{
+    std::string path;                     // Log file, created if it does not exist
+    WalDurability durability = WAL_GROUP; // What an answered request survives
+    double interval = 0.001;              // Seconds a group waits for more records, seconds between syncs of WAL_PERIODIC
+    int batch = 1024;                     // Records that close a group at once
+    OutputBackend backend = OUTPUT_AUTO;  // Way the records reach the file
+};
+
+/**
+ * @struct WalStats
+ * @brief Counters of the write-ahead log.
+ */
+struct WalStats
+{
+    int64_t records = 0;   // Appended records
+    int64_t writes = 0;    // Writes of a group of records
+    int64_t syncs = 0;     // Calls of fdatasync
+    int64_t syncTime = 0;  // Nanoseconds spent in fdatasync
+    int64_t recovered = 0; // Open auctions placed back into the engine on start
+    int64_t closed = 0;    // Closed auctions placed back into the engine on start, with their final state
+    int64_t replayed = 0;  // Valid records read on start
+    int64_t dropped = 0;   // Bytes at the end of the log dropped on start, a torn or corrupted tail
+};
+
+/**
+ * @class WriteAheadLog
+ * @brief Append-only log of the states of the live auctions, written in groups.
+ *
+ * @details
+ * A record is the whole state of its auction after the request, so the replay keeps the last record of every
+ * auction and does not need the bidding rules. The times are stored on the realtime clock and converted back to
+ * the monotonic clock of the engine, so an auction keeps its end across a restart and one that ended meanwhile is
+ * closed with its last state. Closed auctions stay in the log, a GET of them still tells the winner and the price.
+ * The replay stops at the first record whose checksum does not match.
+ *
+ * The log does not own a thread: the server appends the records of a round of its loop, asks isDue() and calls
+ * commit(), which writes the group and syncs it as the durability requires, and holds the answers while
+ * isHolding(). A group closes when it holds batch records, when its oldest record waited interval or when no
+ * request is waiting, so a lone client does not wait for the interval and a busy server fills its groups with the
+ * requests that arrive during a sync.
+ */
+class WriteAheadLog
+{
+private:
+    WalConfig config;
+    OutputFile file;
+    size_t grouped = 0; // Bytes of the records not committed yet
+    int64_t first = 0;  // Time the oldest record of the group was appended
+    int64_t synced = 0; // Time of the last sync
+    int64_t offset = 0; // Realtime minus monotonic clock in nanoseconds
+    bool dirty = false; // Flag if written records were not synced yet
+    WalStats stats;
+
+    /**
+     * @brief Syncs the written records.
+     * @return false on an error (errno is set)
+     */
+    bool sync(int64_t now);
+
+public:
+    WriteAheadLog() = default;
+    ~WriteAheadLog();
+
+    /**
+     * @brief Replays the log into an engine and compacts it, then opens it for appending.
+     * @param config The log file and the durability.
+     * @param engine Engine the open auctions are placed into.
+     * @return false on an error (errno is set)
+     */
+    bool open(const WalConfig &config, MatchingEngine &engine);
+
+    /**
+     * @brief Appends the state of an auction after a request, synced at once with WAL_SYNC.
+     * @param type Cause of the record.
+     * @param auction Number of the auction.
+     * @param state The state after the request.
+     * @param now Time of the request on the monotonic clock.
+     * @return false on an error (errno is set)
+     */
+    bool append(WalRecordType type, uint32_t auction, const AuctionState &state, int64_t now);
+
+    /**
+     * @brief Checks if commit() should be called without waiting for the server to become idle.
+     * @return true if the group is full, its oldest record waited the interval or the durability does not group the
+     *         syncs, or if a periodic sync is due
+     */
+    bool isDue(int64_t now) const
+    {
+        int64_t interval = (int64_t)(this->config.interval * 1e9);
+        if (this->grouped == 0)
+        {
+            return this->dirty && this->config.durability == WAL_PERIODIC && now - this->synced >= interval;
+        }
+        return this->config.durability < WAL_GROUP || now - this->first >= interval ||
+               (int64_t)this->grouped >= this->config.batch * (int64_t)sizeof(WalRecord);
+    }
+
+    /**
+     * @brief Checks if some records were not written yet, the answers to them and to later requests wait.
+     */
+    bool isHolding() const { return this->grouped > 0; }
+
+    /**
+     * @brief Writes the group and syncs the log as the durability requires.
+     * @return false on an error (errno is set)
+     */
+    bool commit(int64_t now);
+
+    bool isOpen() const { return this->file.isOpen(); }
+    const WalStats &getStats() const { return this->stats; }
+};
+
+#endif // WAL_H